@@ -3,6 +3,11 @@
 #include "resources.h"
 #include "json_handler.h"
 #include "util.h"
+#include "scheduler.h"
+#include "ticker.h"
+#include "linkwatch.h"
+#include "psi.h"
+#include "watch.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +17,7 @@
 #include <getopt.h>
 #include <limits.h>
 #include <errno.h>
+#include <poll.h>
 
 #include "ur-restrack.h"
 
@@ -112,24 +118,9 @@ void debug_print_thread_state(thread_state_t state, int use_colors) {
 char* sysmon_config_to_json(const SysmonConfig* config) {
     if (!config) return NULL;
 
-    cJSON* root = cJSON_CreateObject();
+    cJSON* root = config_to_json(config);
     if (!root) return NULL;
 
-    cJSON_AddStringToObject(root, "output_path", config->output_path);
-    cJSON_AddStringToObject(root, "log_path", config->log_path);
-    
-    cJSON_AddNumberToObject(root, "collection_interval", config->collection_interval);
-    
-    cJSON_AddBoolToObject(root, "verbose", config->verbose ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_cpu", config->collect_cpu ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_memory", config->collect_memory ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_load", config->collect_load ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_disk", config->collect_disk ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_network", config->collect_network ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_uptime", config->collect_uptime ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_processes", config->collect_processes ? 1 : 0);
-    cJSON_AddBoolToObject(root, "collect_swap", config->collect_swap ? 1 : 0);
-
     char* json_string = cJSON_Print(root);
     cJSON_Delete(root);
     
@@ -188,6 +179,69 @@ char *create_config_file(const char *config,size_t len) {
     return result;
 }
 
+// Link changes are published the moment the kernel reports them
+static void publish_link_event(const restrack_link_event_t *event, void *ctx) {
+    (void)ctx;
+    cJSON *event_data = link_event_to_json(event);
+    if (event_data == NULL) {
+        return;
+    }
+    add_timestamp(event_data);
+    char *event_json = cJSON_PrintUnformatted(event_data);
+    if (event_json != NULL) {
+        publish_to_custom_topic(RESTRACK_EVENTS_TOPIC, event_json);
+        free(event_json);
+    }
+    log_message(LOG_INFO, "Published link event for interface %d (%s)", event->ifindex, event->name);
+    cJSON_Delete(event_data);
+}
+
+static void on_link_notifications(int fd, short revents, void *ctx) {
+    (void)fd;
+    (void)revents;
+    (void)ctx;
+    linkwatch_process();
+}
+
+// Set when a PSI trigger fired; the runner then samples pressure at once
+static int g_pressure_pending = 0;
+
+static void on_pressure_trigger(int fd, short revents, void *ctx) {
+    if (revents & POLLPRI) {
+        psi_trigger_fired(fd);
+        g_pressure_pending = 1;
+        ticker_interrupt((SysmonTicker *)ctx);
+    }
+}
+
+// SIGUSR1, e.g. from a procd service hook: match the watch patterns again on the next collection
+static void on_rescan_signal(int sig) {
+    (void)sig;
+    watch_request_rescan();
+}
+
+// Write the sample to the output file and publish it on the status topic
+static void publish_sample(const restrack_sample_t *sample) {
+    cJSON *resource_data = sample_to_json(sample);
+    if (resource_data == NULL) {
+        log_message(LOG_ERROR, "Failed to serialize system resources");
+        return;
+    }
+    add_timestamp(resource_data);
+    int result = update_json_file(g_config.output_path, resource_data);
+    if (result != ERR_SUCCESS) {
+        log_message(LOG_ERROR, "Failed to update JSON file: %d", result);
+    } else {
+        log_message(LOG_INFO, "Successfully updated system resource data");
+    }
+    char *status_json = cJSON_Print(resource_data);
+    if (status_json != NULL) {
+        publish_to_custom_topic(RESTRACK_STATUS_TOPIC, status_json);
+        free(status_json);
+    }
+    cJSON_Delete(resource_data);
+}
+
 void* restrack_runner_func(void *arg) {
 
     SysmonArgs* args = (SysmonArgs*)arg;
@@ -237,6 +291,7 @@ void* restrack_runner_func(void *arg) {
     }
     if (interval > 0) {
         g_config.collection_interval = interval;
+        g_config.collection_interval_ms = 0;
     }
     if (verbose) {
         g_config.verbose = verbose;
@@ -247,37 +302,140 @@ void* restrack_runner_func(void *arg) {
         return 1;
     }
 
-    log_message(LOG_INFO, "System monitoring started with interval: %d seconds", g_config.collection_interval);
+    log_message(LOG_INFO, "System monitoring started with interval: %d ms",
+                g_config.collection_interval_ms > 0 ? g_config.collection_interval_ms : g_config.collection_interval * 1000);
     log_message(LOG_INFO, "Output file: %s", g_config.output_path);
 
+    if (open_json_history(g_config.output_path, g_config.history_size) != ERR_SUCCESS) {
+        log_message(LOG_WARNING, "History journal unavailable, only the latest sample will be written");
+    }
+
+
+    // One sample is reused for every tick, collectors only overwrite it
+    restrack_sample_t *sample = (restrack_sample_t *)calloc(1, sizeof(restrack_sample_t));
+    if (sample == NULL) {
+        log_message(LOG_ERROR, "Failed to allocate resource sample");
+        close_json_history();
+        return NULL;
+    }
+
+    // Every enabled collector runs on its own period and phase
+    CollectorScheduler scheduler;
+    scheduler_init(&scheduler);
+    unsigned int enabled = enabled_resource_mask(&g_config);
+    uint64_t start_ms = scheduler_now_ms();
+    uint64_t last_tick_ns = 0;
+    for (int i = 0; i < SYSMON_COLLECTOR_COUNT; i++) {
+        if (enabled & (1u << i)) {
+            scheduler_add(&scheduler, i, collector_period_ms(&g_config, (SysmonCollector)i),
+                          start_ms + g_config.schedules[i].phase_ms);
+            log_message(LOG_INFO, "Collector %s runs every %d ms", collector_name((SysmonCollector)i),
+                        collector_period_ms(&g_config, (SysmonCollector)i));
+        }
+    }
+
+    // Deadlines are absolute, so collection and write time do not add up
+    SysmonTicker ticker;
+    ticker_open(&ticker);
+
+    // Link and address changes are serviced while waiting for the next tick
+    if (g_config.link_events && !run_once && linkwatch_open(publish_link_event, NULL) == ERR_SUCCESS) {
+        ticker_watch(&ticker, linkwatch_fd(), POLLIN, on_link_notifications, NULL);
+    }
+
+    // Pressure stalls wake the runner instead of waiting for the next tick
+    g_pressure_pending = 0;
+    if ((enabled & RESTRACK_HAS_PRESSURE) && !run_once && psi_triggers_open(g_config.psi_triggers) > 0) {
+        for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+            if (psi_trigger_fd(i) >= 0) {
+                ticker_watch(&ticker, psi_trigger_fd(i), POLLPRI, on_pressure_trigger, &ticker);
+            }
+        }
+    }
+
+    if ((enabled & RESTRACK_HAS_WATCHED) && !run_once) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_rescan_signal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGUSR1, &action, NULL) != 0) {
+            log_message(LOG_WARNING, "Failed to install SIGUSR1 handler: %s", strerror(errno));
+        }
+    }
 
     while (1) {
         if (thread_should_exit(&manager, thread_id)) {
-            return NULL;
+            break;
         }
-        cJSON *resource_data = collect_all_resources(&g_config);
-        if (resource_data == NULL) {
-            log_message(LOG_ERROR, "Failed to collect system resources");
-            sleep(g_config.collection_interval);
+
+        // An extra sample with fresh pressure only; the schedule is unaffected
+        if (g_pressure_pending) {
+            g_pressure_pending = 0;
+            if (collect_resources(&g_config, sample, RESTRACK_HAS_PRESSURE) == ERR_SUCCESS) {
+                log_message(LOG_INFO, "Pressure trigger fired, publishing an extra sample");
+                publish_sample(sample);
+            }
             continue;
         }
-        add_timestamp(resource_data);
-        int result = update_json_file(g_config.output_path, resource_data);
-        if (result != ERR_SUCCESS) {
-            log_message(LOG_ERROR, "Failed to update JSON file: %d", result);
-        } else {
-            log_message(LOG_INFO, "Successfully updated system resource data");
+
+        // Sleep until the earliest collector is due
+        uint64_t now_ns = scheduler_now_ns();
+        uint64_t now_ms = now_ns / 1000000;
+        uint64_t due_ms = scheduler_next_due(&scheduler);
+        if (!run_once && due_ms > now_ms) {
+            if (due_ms == UINT64_MAX) {
+                due_ms = now_ms + (uint64_t)g_config.collection_interval * 1000;
+            }
+            ticker_wait_until(&ticker, due_ms * 1000000ULL);
+            continue;
         }
-        publish_to_custom_topic(RESTRACK_STATUS_TOPIC,cJSON_Print(resource_data));
-        cJSON_Delete(resource_data);
 
+        // Run everything that is due; the other sections keep their last value
+        uint64_t overruns = scheduler.overruns;
+        unsigned int due = 0;
+        int id;
+        while (scheduler_pop_due(&scheduler, now_ms, &id)) {
+            due |= 1u << id;
+        }
         if (run_once) {
-            break;
+            due = enabled;
+        }
+        if (scheduler.overruns != overruns) {
+            log_message(LOG_WARNING, "Collection fell behind schedule, skipped %llu collector runs",
+                        (unsigned long long)(scheduler.overruns - overruns));
+        }
+
+        // How late this tick woke up and how long it has been since the last one
+        restrack_timing_t *timing = &sample->timing;
+        double jitter_ms = due_ms <= now_ms ? (double)(now_ns - due_ms * 1000000ULL) / 1e6 : 0.0;
+        timing->interval_ms = timing->ticks > 0 ? (double)(now_ns - last_tick_ns) / 1e6 : 0.0;
+        last_tick_ns = now_ns;
+        timing->ticks++;
+        timing->overruns = scheduler.overruns;
+        timing->monotonic_ms = now_ms;
+        timing->jitter_ms = jitter_ms;
+        timing->jitter_avg_ms += (jitter_ms - timing->jitter_avg_ms) / timing->ticks;
+        if (jitter_ms > timing->jitter_max_ms) {
+            timing->jitter_max_ms = jitter_ms;
         }
-        sleep(g_config.collection_interval);
 
+        if (collect_resources(&g_config, sample, due) != ERR_SUCCESS) {
+            log_message(LOG_ERROR, "Failed to collect system resources");
+            continue;
+        }
+        publish_sample(sample);
+
+        if (run_once) {
+            break;
+        }
     }
 
+    linkwatch_cleanup();
+    ticker_close(&ticker);
+    free(sample);
+    resources_cleanup();
+    close_json_history();
     log_message(LOG_INFO, "System monitoring stopped");
 }
 
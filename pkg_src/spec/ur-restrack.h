@@ -41,6 +41,7 @@ typedef struct {
 #define RESTRACK_RESULT_TOPIC "ur-restrack-results"
 #define RESTRACK_STATUS_TOPIC  "ur-restrack-status"
 #define RESTRACK_HEARTBEAT_TOPIC "ur-restrack-heartbeat"
+#define RESTRACK_EVENTS_TOPIC "ur-restrack-events"
 #define RESTRACK_HEARTBEAT_MESSAGE "restrack_heartbeat"
 
 extern thread_manager_t manager;
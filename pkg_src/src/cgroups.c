@@ -0,0 +1,639 @@
+/**
+ * @file cgroups.c
+ * @brief Per-service resource usage from cgroup v2 interface files
+ */
+
+// d_type and DT_DIR are BSD extensions, hidden by the build's _POSIX_C_SOURCE
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "cgroups.h"
+#include "procfs.h"
+#include "util.h"
+#include <dirent.h>
+#include <sys/vfs.h>
+#include <sys/resource.h>
+
+#ifndef CGROUP2_SUPER_MAGIC
+#define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
+// Largest interface file read; io.stat has a line of about 100 bytes per device
+#define CGROUP_READ_BUF 4096
+
+// Calls between attempts to open the files of controllers that were not enabled
+#define CGROUP_REOPEN_CALLS 30
+
+// Interface files read per cgroup
+enum {
+    CGROUP_CPU_STAT,
+    CGROUP_MEMORY_CURRENT,
+    CGROUP_MEMORY_EVENTS,
+    CGROUP_IO_STAT,
+    CGROUP_FILES
+};
+
+static const char *const g_file_names[CGROUP_FILES] = {
+    "cpu.stat", "memory.current", "memory.events", "io.stat"
+};
+
+// Where the cgroup2 hierarchy may be mounted: unified layout first, then hybrid
+static const char *const g_mount_points[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+
+/**
+ * @struct CgroupPattern
+ * @brief One configured cgroup path
+ */
+typedef struct {
+    char path[SYSMON_CGROUP_PATH_LEN];   // As configured
+    char dir[SYSMON_CGROUP_PATH_LEN];    // Without "/*" and outer slashes, "" for the root cgroup, named "/"
+    int children;                // Whether the path stands for every child of dir
+    int dirfd;                   // dir, opened for listing children; -1 until needed
+    nlink_t nlink;               // Link count of dir at the last listing, 0 to list again
+    int dropped;                 // Children that could not be tracked at the last listing
+} CgroupPattern;
+
+/**
+ * @struct CgroupEntry
+ * @brief A tracked cgroup and its previous reading
+ */
+typedef struct {
+    int pattern;                 // Index of the pattern that found it
+    int seen;                    // Found by the listing in progress
+    int dirfd;
+    int fds[CGROUP_FILES];       // -1 for files of controllers that are not enabled
+    int has_prev;                // Whether prev holds a reading
+    uint64_t read_ns;            // CLOCK_MONOTONIC time of prev
+    restrack_cgroup_t prev;      // Last reading; its name is the cgroup's name
+} CgroupEntry;
+
+static int g_root_fd = -1;
+static CgroupPattern g_patterns[SYSMON_MAX_CGROUP_PATHS];
+static int g_num_patterns = 0;
+
+// Tracked cgroups, in the order they were found
+static CgroupEntry g_entries[RESTRACK_MAX_CGROUPS];
+static int g_num_entries = 0;
+
+static unsigned int g_calls = 0;
+static int g_warned_fds = 0;
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Make room for the descriptors of a full cgroup table
+ *
+ * Every cgroup holds its directory and four files open, which is more
+ * than the usual soft limit of 1024 descriptors allows for a full table.
+ */
+static void raise_fd_limit(void) {
+    rlim_t wanted = (CGROUP_FILES + 1) * RESTRACK_MAX_CGROUPS + SYSMON_MAX_CGROUP_PATHS + 256;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= wanted) {
+        return;
+    }
+
+    limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > wanted) ? wanted : limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+/**
+ * @brief Open the root of the cgroup2 hierarchy
+ * @return 1 if it was found, 0 otherwise
+ */
+static int open_root(void) {
+    for (size_t i = 0; i < sizeof(g_mount_points) / sizeof(g_mount_points[0]); i++) {
+        int fd = open(g_mount_points[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        struct statfs st;
+        if (fstatfs(fd, &st) == 0 && st.f_type == CGROUP2_SUPER_MAGIC) {
+            g_root_fd = fd;
+            raise_fd_limit();
+            return 1;
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+/**
+ * @brief Close the descriptors of a tracked cgroup
+ * @param entry Entry to close
+ */
+static void close_entry(CgroupEntry *entry) {
+    for (int i = 0; i < CGROUP_FILES; i++) {
+        if (entry->fds[i] >= 0) {
+            close(entry->fds[i]);
+            entry->fds[i] = -1;
+        }
+    }
+    if (entry->dirfd >= 0) {
+        close(entry->dirfd);
+        entry->dirfd = -1;
+    }
+}
+
+/**
+ * @brief Stop tracking a cgroup, keeping the order of the others
+ * @param index Index in g_entries
+ */
+static void remove_entry(int index) {
+    close_entry(&g_entries[index]);
+    memmove(&g_entries[index], &g_entries[index + 1], (g_num_entries - index - 1) * sizeof(g_entries[0]));
+    g_num_entries--;
+}
+
+/**
+ * @brief Close every cgroup and pattern descriptor, keeping the root
+ */
+static void release_all(void) {
+    for (int i = 0; i < g_num_entries; i++) {
+        close_entry(&g_entries[i]);
+    }
+    g_num_entries = 0;
+
+    for (int i = 0; i < g_num_patterns; i++) {
+        if (g_patterns[i].dirfd >= 0) {
+            close(g_patterns[i].dirfd);
+        }
+    }
+    g_num_patterns = 0;
+}
+
+/**
+ * @brief Take over the configured paths, starting over when they changed
+ * @param paths Configured cgroup paths
+ * @param num_paths Entries used in paths
+ */
+static void set_patterns(const char paths[][SYSMON_CGROUP_PATH_LEN], int num_paths) {
+    if (num_paths > SYSMON_MAX_CGROUP_PATHS) {
+        num_paths = SYSMON_MAX_CGROUP_PATHS;
+    }
+
+    int same = num_paths == g_num_patterns;
+    for (int i = 0; same && i < num_paths; i++) {
+        same = strcmp(paths[i], g_patterns[i].path) == 0;
+    }
+    if (same) {
+        return;
+    }
+
+    release_all();
+    for (int i = 0; i < num_paths; i++) {
+        CgroupPattern *pattern = &g_patterns[g_num_patterns++];
+        memset(pattern, 0, sizeof(*pattern));
+        pattern->dirfd = -1;
+        strncpy(pattern->path, paths[i], sizeof(pattern->path) - 1);
+
+        // "/services/*" and "services/*" both mean every child of services
+        const char *start = paths[i];
+        while (*start == '/') {
+            start++;
+        }
+        size_t len = strnlen(start, sizeof(pattern->dir) - 1);
+        if (len > 0 && start[len - 1] == '*' && (len == 1 || start[len - 2] == '/')) {
+            pattern->children = 1;
+            len--;
+        }
+        while (len > 0 && start[len - 1] == '/') {
+            len--;
+        }
+        memcpy(pattern->dir, start, len);
+        pattern->dir[len] = '\0';
+    }
+}
+
+/**
+ * @brief Open the interface files that are not open yet
+ * @param entry Tracked cgroup
+ */
+static void open_files(CgroupEntry *entry) {
+    for (int i = 0; i < CGROUP_FILES; i++) {
+        if (entry->fds[i] < 0) {
+            entry->fds[i] = openat(entry->dirfd, g_file_names[i], O_RDONLY | O_CLOEXEC);
+        }
+    }
+}
+
+/**
+ * @brief Find a tracked cgroup by name
+ * @param name Path below the cgroup2 mount
+ * @return Entry, or NULL if it is not tracked
+ */
+static CgroupEntry* find_entry(const char *name) {
+    for (int i = 0; i < g_num_entries; i++) {
+        if (strcmp(g_entries[i].prev.name, name) == 0) {
+            return &g_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start tracking a cgroup
+ * @param pattern Index of the pattern that found it
+ * @param name Path below the cgroup2 mount
+ * @param parent_fd Directory that rel is relative to
+ * @param rel Path of the cgroup directory relative to parent_fd
+ * @return 1 if tracked, 0 if it did not fit, -1 if it is not a directory or vanished
+ */
+static int add_entry(int pattern, const char *name, int parent_fd, const char *rel) {
+    if (g_num_entries >= RESTRACK_MAX_CGROUPS) {
+        return 0;
+    }
+
+    int dirfd = openat(parent_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        if (errno != EMFILE && errno != ENFILE) {
+            return -1;
+        }
+        if (!g_warned_fds) {
+            log_message(LOG_WARNING, "Out of file descriptors for cgroup %s", name);
+            g_warned_fds = 1;
+        }
+        return 0;
+    }
+
+    CgroupEntry *entry = &g_entries[g_num_entries++];
+    memset(entry, 0, sizeof(*entry));
+    entry->pattern = pattern;
+    entry->seen = 1;
+    entry->dirfd = dirfd;
+    for (int i = 0; i < CGROUP_FILES; i++) {
+        entry->fds[i] = -1;
+    }
+    strncpy(entry->prev.name, name, sizeof(entry->prev.name) - 1);
+
+    open_files(entry);
+    return 1;
+}
+
+/**
+ * @brief Track every child of a pattern ending in "*", listing dir only when it changed
+ * @param index Index of the pattern
+ */
+static void refresh_children(int index) {
+    CgroupPattern *pattern = &g_patterns[index];
+
+    if (pattern->dirfd < 0) {
+        pattern->dirfd = openat(g_root_fd, pattern->dir[0] ? pattern->dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (pattern->dirfd < 0) {
+            return;
+        }
+        pattern->nlink = 0;
+    }
+
+    // kernfs keeps a directory's link count at its subdirectories plus two
+    struct stat st;
+    if (fstat(pattern->dirfd, &st) != 0) {
+        close(pattern->dirfd);
+        pattern->dirfd = -1;
+        return;
+    }
+    if (st.st_nlink == pattern->nlink) {
+        return;
+    }
+
+    // The duplicate shares the offset of dirfd, so the listing starts from the top
+    int fd = dup(pattern->dirfd);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (dir == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    rewinddir(dir);
+
+    for (int i = 0; i < g_num_entries; i++) {
+        if (g_entries[i].pattern == index) {
+            g_entries[i].seen = 0;
+        }
+    }
+    pattern->dropped = 0;
+
+    struct dirent *child;
+    while ((child = readdir(dir)) != NULL) {
+        if ((child->d_type != DT_DIR && child->d_type != DT_UNKNOWN) ||
+            strcmp(child->d_name, ".") == 0 || strcmp(child->d_name, "..") == 0) {
+            continue;
+        }
+
+        // A truncated name could merge two cgroups, so a name that does not fit is dropped
+        char name[RESTRACK_CGROUP_NAME_LEN];
+        int name_len = pattern->dir[0]
+            ? snprintf(name, sizeof(name), "%s/%s", pattern->dir, child->d_name)
+            : snprintf(name, sizeof(name), "%s", child->d_name);
+        if (name_len < 0 || (size_t)name_len >= sizeof(name)) {
+            pattern->dropped++;
+            continue;
+        }
+
+        // A cgroup matched by an earlier pattern stays with it
+        CgroupEntry *entry = find_entry(name);
+        if (entry != NULL) {
+            entry->seen = 1;
+            continue;
+        }
+        if (add_entry(index, name, pattern->dirfd, child->d_name) == 0) {
+            pattern->dropped++;
+        }
+    }
+    closedir(dir);
+
+    for (int i = g_num_entries - 1; i >= 0; i--) {
+        if (g_entries[i].pattern == index && !g_entries[i].seen) {
+            remove_entry(i);
+        }
+    }
+    pattern->nlink = st.st_nlink;
+}
+
+/**
+ * @brief Track the single cgroup of a pattern if it exists
+ * @param index Index of the pattern
+ */
+static void refresh_single(int index) {
+    CgroupPattern *pattern = &g_patterns[index];
+    const char *name = pattern->dir[0] ? pattern->dir : "/";
+
+    if (find_entry(name) != NULL) {
+        return;
+    }
+    pattern->dropped = add_entry(index, name, g_root_fd, pattern->dir[0] ? pattern->dir : ".") == 0;
+}
+
+/**
+ * @brief Read an interface file from its start
+ * @param fd Open interface file
+ * @param buf Buffer receiving the contents, NUL terminated
+ * @param size Size of buf
+ * @return Bytes read, -1 on error
+ */
+static ssize_t read_at_start(int fd, char *buf, size_t size) {
+    ssize_t n;
+    do {
+        n = pread(fd, buf, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+/**
+ * @brief Parse "key value" lines such as cpu.stat and memory.events
+ * @param scanner Scanner over the file
+ * @param keys Keys to look for
+ * @param values Receives the value of each key found
+ * @param count Number of keys
+ */
+static void parse_flat_keyed(ProcfsScanner *scanner, const char *const *keys, uint64_t *const *values, int count) {
+    ProcfsScanner line;
+    while (procfs_next_line(scanner, &line)) {
+        const char *key;
+        size_t key_len;
+        if (!procfs_next_token(&line, 0, &key, &key_len)) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (procfs_token_equals(key, key_len, keys[i])) {
+                procfs_next_u64(&line, values[i]);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sum the per-device lines of io.stat, "8:0 rbytes=1 wbytes=2 rios=3 wios=4 ..."
+ * @param scanner Scanner over the file
+ * @param cgroup Cgroup receiving the sums
+ */
+static void parse_io_stat(ProcfsScanner *scanner, restrack_cgroup_t *cgroup) {
+    ProcfsScanner line;
+    while (procfs_next_line(scanner, &line)) {
+        const char *key;
+        size_t key_len;
+
+        // Skip the major:minor column
+        if (!procfs_next_token(&line, 0, &key, &key_len)) {
+            continue;
+        }
+
+        while (procfs_next_token(&line, '=', &key, &key_len)) {
+            uint64_t value;
+            if (line.pos >= line.end || *line.pos != '=') {
+                continue;
+            }
+            line.pos++;
+            if (!procfs_next_u64(&line, &value)) {
+                continue;
+            }
+
+            if (procfs_token_equals(key, key_len, "rbytes")) {
+                cgroup->read_bytes += value;
+            } else if (procfs_token_equals(key, key_len, "wbytes")) {
+                cgroup->write_bytes += value;
+            } else if (procfs_token_equals(key, key_len, "rios")) {
+                cgroup->read_ios += value;
+            } else if (procfs_token_equals(key, key_len, "wios")) {
+                cgroup->write_ios += value;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Read the interface files of a tracked cgroup
+ * @param entry Tracked cgroup
+ * @param cgroup Receives the counters
+ * @return 1 on success, 0 if the cgroup was removed
+ */
+static int read_entry(const CgroupEntry *entry, restrack_cgroup_t *cgroup) {
+    static const char *const cpu_keys[] = {
+        "usage_usec", "user_usec", "system_usec", "nr_throttled", "throttled_usec"
+    };
+    static const char *const event_keys[] = { "high", "max", "oom", "oom_kill" };
+    char buf[CGROUP_READ_BUF];
+
+    memset(cgroup, 0, sizeof(*cgroup));
+    memcpy(cgroup->name, entry->prev.name, sizeof(cgroup->name));
+
+    for (int i = 0; i < CGROUP_FILES; i++) {
+        if (entry->fds[i] < 0) {
+            continue;
+        }
+
+        ssize_t n = read_at_start(entry->fds[i], buf, sizeof(buf));
+        if (n < 0) {
+            // Files of a removed cgroup fail with ENODEV
+            if (errno == ENODEV || errno == ENOENT) {
+                return 0;
+            }
+            continue;
+        }
+
+        ProcfsScanner file = { buf, buf + n };
+        switch (i) {
+        case CGROUP_CPU_STAT: {
+            uint64_t *const values[] = {
+                &cgroup->usage_usec, &cgroup->user_usec, &cgroup->system_usec,
+                &cgroup->nr_throttled, &cgroup->throttled_usec
+            };
+            parse_flat_keyed(&file, cpu_keys, values, 5);
+            cgroup->has_cpu = 1;
+            break;
+        }
+        case CGROUP_MEMORY_CURRENT:
+            cgroup->has_memory = procfs_next_u64(&file, &cgroup->memory_bytes);
+            break;
+        case CGROUP_MEMORY_EVENTS: {
+            uint64_t *const values[] = {
+                &cgroup->events_high, &cgroup->events_max, &cgroup->events_oom, &cgroup->events_oom_kill
+            };
+            parse_flat_keyed(&file, event_keys, values, 4);
+            cgroup->has_memory_events = 1;
+            break;
+        }
+        case CGROUP_IO_STAT:
+            parse_io_stat(&file, cgroup);
+            cgroup->has_io = 1;
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Difference between two readings of a counter
+ * @param cur Current reading
+ * @param prev Previous reading
+ * @return cur - prev, or 0 if the counter went back
+ */
+static uint64_t counter_delta(uint64_t cur, uint64_t prev) {
+    return cur >= prev ? cur - prev : 0;
+}
+
+/**
+ * @brief Compute the rates of a cgroup against its previous reading
+ * @param cgroup Fresh reading
+ * @param prev Previous reading of the same cgroup
+ * @param elapsed_ns Time between the readings
+ */
+static void update_rates(restrack_cgroup_t *cgroup, const restrack_cgroup_t *prev, uint64_t elapsed_ns) {
+    double elapsed_usec = elapsed_ns / 1e3;
+    double elapsed_sec = elapsed_ns / 1e9;
+
+    cgroup->has_rates = 1;
+    cgroup->interval_ms = elapsed_ns / 1e6;
+
+    if (cgroup->has_cpu && prev->has_cpu) {
+        cgroup->cpu_percent = 100.0 * counter_delta(cgroup->usage_usec, prev->usage_usec) / elapsed_usec;
+        cgroup->user_percent = 100.0 * counter_delta(cgroup->user_usec, prev->user_usec) / elapsed_usec;
+        cgroup->system_percent = 100.0 * counter_delta(cgroup->system_usec, prev->system_usec) / elapsed_usec;
+        cgroup->throttled_percent = 100.0 * counter_delta(cgroup->throttled_usec, prev->throttled_usec) / elapsed_usec;
+    }
+
+    if (cgroup->has_memory_events && prev->has_memory_events) {
+        cgroup->new_high = counter_delta(cgroup->events_high, prev->events_high);
+        cgroup->new_max = counter_delta(cgroup->events_max, prev->events_max);
+        cgroup->new_oom = counter_delta(cgroup->events_oom, prev->events_oom);
+        cgroup->new_oom_kill = counter_delta(cgroup->events_oom_kill, prev->events_oom_kill);
+    }
+
+    if (cgroup->has_io && prev->has_io) {
+        cgroup->read_bytes_per_sec = counter_delta(cgroup->read_bytes, prev->read_bytes) / elapsed_sec;
+        cgroup->write_bytes_per_sec = counter_delta(cgroup->write_bytes, prev->write_bytes) / elapsed_sec;
+        cgroup->read_iops = counter_delta(cgroup->read_ios, prev->read_ios) / elapsed_sec;
+        cgroup->write_iops = counter_delta(cgroup->write_ios, prev->write_ios) / elapsed_sec;
+    }
+}
+
+/**
+ * @brief Read cpu.stat, memory.current, memory.events and io.stat of the configured cgroups
+ * @param paths cgroup paths below the cgroup2 mount; a path ending in "*" stands for every child of its directory
+ * @param num_paths Entries used in paths
+ * @param cgroups Cgroup section to fill
+ * @return ERR_SUCCESS on success, including when no cgroup2 hierarchy is mounted
+ */
+int cgroups_collect(const char paths[][SYSMON_CGROUP_PATH_LEN], int num_paths, restrack_cgroups_t *cgroups) {
+    if (cgroups == NULL || (paths == NULL && num_paths > 0)) {
+        return ERR_INVALID_PARAM;
+    }
+
+    cgroups->supported = 0;
+    cgroups->num_cgroups = 0;
+    cgroups->dropped = 0;
+
+    if (g_root_fd < 0 && !open_root()) {
+        return ERR_SUCCESS;
+    }
+    cgroups->supported = 1;
+
+    set_patterns(paths, num_paths);
+    for (int i = 0; i < g_num_patterns; i++) {
+        if (g_patterns[i].children) {
+            refresh_children(i);
+        } else {
+            refresh_single(i);
+        }
+        cgroups->dropped += g_patterns[i].dropped;
+    }
+
+    // Controllers enabled after a cgroup was found are picked up now and then
+    int reopen = ++g_calls % CGROUP_REOPEN_CALLS == 0;
+    uint64_t now_ns = monotonic_ns();
+
+    for (int i = 0; i < g_num_entries; i++) {
+        CgroupEntry *entry = &g_entries[i];
+        if (reopen) {
+            open_files(entry);
+        }
+
+        restrack_cgroup_t *cgroup = &cgroups->cgroups[cgroups->num_cgroups];
+        if (!read_entry(entry, cgroup)) {
+            // List the parent again at the next call in case it was replaced
+            g_patterns[entry->pattern].nlink = 0;
+            remove_entry(i--);
+            continue;
+        }
+
+        if (entry->has_prev && now_ns > entry->read_ns) {
+            update_rates(cgroup, &entry->prev, now_ns - entry->read_ns);
+        }
+        entry->prev = *cgroup;
+        entry->has_prev = 1;
+        entry->read_ns = now_ns;
+        cgroups->num_cgroups++;
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close every cgroup descriptor and forget the previous readings
+ */
+void cgroups_cleanup(void) {
+    release_all();
+    if (g_root_fd >= 0) {
+        close(g_root_fd);
+        g_root_fd = -1;
+    }
+    g_calls = 0;
+    g_warned_fds = 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file cgroups.h
+ * @brief Per-service resource usage from cgroup v2 interface files
+ */
+
+#ifndef CGROUPS_H
+#define CGROUPS_H
+
+#include "resources.h"
+
+/**
+ * @brief Read cpu.stat, memory.current, memory.events and io.stat of the configured cgroups
+ * @param paths cgroup paths below the cgroup2 mount; a path ending in "*" stands for every child of its directory
+ * @param num_paths Entries used in paths
+ * @param cgroups Cgroup section to fill
+ * @return ERR_SUCCESS on success, including when no cgroup2 hierarchy is
+ *         mounted (supported is then 0)
+ *
+ * The directory of every cgroup and its interface files stay open between
+ * calls, so a reading costs one pread() per file. The children behind a
+ * "*" path are listed again only when the link count of their parent
+ * changes, which kernfs keeps equal to its subdirectories plus two, or
+ * when a tracked cgroup disappears.
+ */
+int cgroups_collect(const char paths[][SYSMON_CGROUP_PATH_LEN], int num_paths, restrack_cgroups_t *cgroups);
+
+/**
+ * @brief Close every cgroup descriptor and forget the previous readings
+ */
+void cgroups_cleanup(void);
+
+#endif /* CGROUPS_H */
@@ -7,6 +7,48 @@
 #include "util.h"
 #include "json_handler.h"
 
+// Keys of the collectors under "schedules", indexed by SysmonCollector
+static const char *const g_collector_names[SYSMON_COLLECTOR_COUNT] = {
+    "cpu", "memory", "load", "disk", "network", "uptime", "processes", "swap", "pressure",
+    "cgroups", "interrupts", "connections", "protocols", "thermal", "paging", "watched"
+};
+
+// Daemons watched unless configured otherwise: DNS/DHCP, Wi-Fi authenticator, MQTT broker
+static const char *const g_default_watch_patterns[] = {
+    "dnsmasq", "hostapd", "mosquitto"
+};
+
+// Keys of the resources under "psi_triggers", indexed by SysmonPsiResource
+static const char *const g_psi_names[SYSMON_PSI_COUNT] = {
+    "cpu", "memory", "io"
+};
+
+/**
+ * @brief Get the configuration name of a collector
+ * @param collector Collector
+ * @return Name used as key under "schedules", or NULL if out of range
+ */
+const char* collector_name(SysmonCollector collector) {
+    if ((int)collector < 0 || collector >= SYSMON_COLLECTOR_COUNT) {
+        return NULL;
+    }
+    return g_collector_names[collector];
+}
+
+/**
+ * @brief Get the period a collector runs at
+ * @param config Pointer to configuration structure
+ * @param collector Collector
+ * @return Period in milliseconds
+ */
+int collector_period_ms(const SysmonConfig *config, SysmonCollector collector) {
+    int period_ms = config->schedules[collector].period_ms;
+    if (period_ms > 0) {
+        return period_ms;
+    }
+    return config->collection_interval_ms > 0 ? config->collection_interval_ms : config->collection_interval * 1000;
+}
+
 /**
  * @brief Set default configuration values
  * @param config Pointer to configuration structure
@@ -19,6 +61,8 @@ void set_default_config(SysmonConfig *config) {
     strncpy(config->output_path, DEFAULT_OUTPUT_PATH, sizeof(config->output_path) - 1);
     strncpy(config->log_path, DEFAULT_LOG_PATH, sizeof(config->log_path) - 1);
     config->collection_interval = DEFAULT_COLLECTION_INTERVAL;
+    config->collection_interval_ms = 0;
+    config->history_size = DEFAULT_HISTORY_SIZE;
     config->verbose = 0;
     
     // Enable all resource collections by default
@@ -30,34 +74,49 @@ void set_default_config(SysmonConfig *config) {
     config->collect_uptime = 1;
     config->collect_processes = 1;
     config->collect_swap = 1;
-}
+    config->collect_pressure = 1;
+    config->collect_cgroups = 1;
+    config->collect_interrupts = 1;
+    config->collect_connections = 1;
+    config->collect_protocols = 1;
+    config->collect_thermal = 1;
+    config->collect_paging = 1;
+    config->collect_watched = 1;
+    config->process_top_n = DEFAULT_PROCESS_TOP_N;
+    config->irq_top_n = DEFAULT_IRQ_TOP_N;
+    config->link_events = 1;
+    config->statvfs_timeout_ms = DEFAULT_STATVFS_TIMEOUT_MS;
 
-/**
- * @brief Load configuration from a JSON file
- * @param config_path Path to configuration file
- * @param config Pointer to configuration structure to populate
- * @return ERR_SUCCESS on success, error code on failure
- */
-int load_config(const char *config_path, SysmonConfig *config) {
-    if (config_path == NULL || config == NULL) {
-        return ERR_INVALID_PARAM;
-    }
+    // Memory and IO stalls wake the runner; CPU contention is only sampled
+    memset(config->psi_triggers, 0, sizeof(config->psi_triggers));
+    strncpy(config->psi_triggers[SYSMON_PSI_MEMORY], DEFAULT_PSI_TRIGGER, SYSMON_PSI_TRIGGER_LEN - 1);
+    strncpy(config->psi_triggers[SYSMON_PSI_IO], DEFAULT_PSI_TRIGGER, SYSMON_PSI_TRIGGER_LEN - 1);
 
-    char *json_str = read_file(config_path);
-    if (json_str == NULL) {
-        log_message(LOG_WARNING, "Could not read config file, using defaults");
-        return ERR_FILE_OPEN;
+    // procd places each service in its own cgroup below "services"
+    memset(config->cgroup_paths, 0, sizeof(config->cgroup_paths));
+    strncpy(config->cgroup_paths[0], DEFAULT_CGROUP_PATH, SYSMON_CGROUP_PATH_LEN - 1);
+    config->num_cgroup_paths = 1;
+
+    memset(config->watch_patterns, 0, sizeof(config->watch_patterns));
+    config->num_watch_patterns = (int)(sizeof(g_default_watch_patterns) / sizeof(g_default_watch_patterns[0]));
+    for (int i = 0; i < config->num_watch_patterns; i++) {
+        strncpy(config->watch_patterns[i], g_default_watch_patterns[i], SYSMON_WATCH_PATTERN_LEN - 1);
     }
 
-    cJSON *root = cJSON_Parse(json_str);
-    free(json_str);
+    // Every collector follows collection_interval unless scheduled otherwise
+    memset(config->schedules, 0, sizeof(config->schedules));
+}
 
-    if (root == NULL) {
-        log_message(LOG_ERROR, "Error parsing config JSON");
-        return ERR_JSON_PARSE;
+/**
+ * @brief Apply the configuration keys present in a JSON object
+ * @param root JSON object holding configuration keys
+ * @param config Pointer to configuration structure to update
+ */
+void config_from_json(const cJSON *root, SysmonConfig *config) {
+    if (root == NULL || config == NULL) {
+        return;
     }
 
-    // Parse configuration values
     cJSON *output_path = cJSON_GetObjectItem(root, "output_path");
     if (output_path != NULL && cJSON_IsString(output_path)) {
         strncpy(config->output_path, output_path->valuestring, sizeof(config->output_path) - 1);
@@ -69,10 +128,20 @@ int load_config(const char *config_path, SysmonConfig *config) {
     }
 
     cJSON *collection_interval = cJSON_GetObjectItem(root, "collection_interval");
-    if (collection_interval != NULL && cJSON_IsNumber(collection_interval)) {
+    if (collection_interval != NULL && cJSON_IsNumber(collection_interval) && collection_interval->valueint > 0) {
         config->collection_interval = collection_interval->valueint;
     }
 
+    cJSON *collection_interval_ms = cJSON_GetObjectItem(root, "collection_interval_ms");
+    if (collection_interval_ms != NULL && cJSON_IsNumber(collection_interval_ms) && collection_interval_ms->valueint >= 0) {
+        config->collection_interval_ms = collection_interval_ms->valueint;
+    }
+
+    cJSON *history_size = cJSON_GetObjectItem(root, "history_size");
+    if (history_size != NULL && cJSON_IsNumber(history_size) && history_size->valueint > 0) {
+        config->history_size = history_size->valueint;
+    }
+
     cJSON *verbose = cJSON_GetObjectItem(root, "verbose");
     if (verbose != NULL && cJSON_IsBool(verbose)) {
         config->verbose = cJSON_IsTrue(verbose);
@@ -119,30 +188,179 @@ int load_config(const char *config_path, SysmonConfig *config) {
         config->collect_swap = cJSON_IsTrue(collect_swap);
     }
 
-    cJSON_Delete(root);
-    return ERR_SUCCESS;
+    cJSON *collect_pressure = cJSON_GetObjectItem(root, "collect_pressure");
+    if (collect_pressure != NULL && cJSON_IsBool(collect_pressure)) {
+        config->collect_pressure = cJSON_IsTrue(collect_pressure);
+    }
+
+    cJSON *collect_cgroups = cJSON_GetObjectItem(root, "collect_cgroups");
+    if (collect_cgroups != NULL && cJSON_IsBool(collect_cgroups)) {
+        config->collect_cgroups = cJSON_IsTrue(collect_cgroups);
+    }
+
+    cJSON *collect_interrupts = cJSON_GetObjectItem(root, "collect_interrupts");
+    if (collect_interrupts != NULL && cJSON_IsBool(collect_interrupts)) {
+        config->collect_interrupts = cJSON_IsTrue(collect_interrupts);
+    }
+
+    cJSON *collect_connections = cJSON_GetObjectItem(root, "collect_connections");
+    if (collect_connections != NULL && cJSON_IsBool(collect_connections)) {
+        config->collect_connections = cJSON_IsTrue(collect_connections);
+    }
+
+    cJSON *collect_protocols = cJSON_GetObjectItem(root, "collect_protocols");
+    if (collect_protocols != NULL && cJSON_IsBool(collect_protocols)) {
+        config->collect_protocols = cJSON_IsTrue(collect_protocols);
+    }
+
+    cJSON *collect_thermal = cJSON_GetObjectItem(root, "collect_thermal");
+    if (collect_thermal != NULL && cJSON_IsBool(collect_thermal)) {
+        config->collect_thermal = cJSON_IsTrue(collect_thermal);
+    }
+
+    cJSON *collect_paging = cJSON_GetObjectItem(root, "collect_paging");
+    if (collect_paging != NULL && cJSON_IsBool(collect_paging)) {
+        config->collect_paging = cJSON_IsTrue(collect_paging);
+    }
+
+    cJSON *collect_watched = cJSON_GetObjectItem(root, "collect_watched");
+    if (collect_watched != NULL && cJSON_IsBool(collect_watched)) {
+        config->collect_watched = cJSON_IsTrue(collect_watched);
+    }
+
+    cJSON *process_top_n = cJSON_GetObjectItem(root, "process_top_n");
+    if (process_top_n != NULL && cJSON_IsNumber(process_top_n) && process_top_n->valueint >= 0) {
+        config->process_top_n = process_top_n->valueint;
+    }
+
+    cJSON *irq_top_n = cJSON_GetObjectItem(root, "irq_top_n");
+    if (irq_top_n != NULL && cJSON_IsNumber(irq_top_n) && irq_top_n->valueint >= 0) {
+        config->irq_top_n = irq_top_n->valueint;
+    }
+
+    cJSON *link_events = cJSON_GetObjectItem(root, "link_events");
+    if (link_events != NULL && cJSON_IsBool(link_events)) {
+        config->link_events = cJSON_IsTrue(link_events);
+    }
+
+    cJSON *statvfs_timeout = cJSON_GetObjectItem(root, "statvfs_timeout_ms");
+    if (statvfs_timeout != NULL && cJSON_IsNumber(statvfs_timeout) && statvfs_timeout->valueint >= 0) {
+        config->statvfs_timeout_ms = statvfs_timeout->valueint;
+    }
+
+    // PSI triggers: "psi_triggers": { "memory": "some 150000 1000000", "cpu": "" }
+    cJSON *psi_triggers = cJSON_GetObjectItem(root, "psi_triggers");
+    for (int i = 0; psi_triggers != NULL && cJSON_IsObject(psi_triggers) && i < SYSMON_PSI_COUNT; i++) {
+        cJSON *trigger = cJSON_GetObjectItem(psi_triggers, g_psi_names[i]);
+        if (trigger != NULL && cJSON_IsString(trigger)) {
+            strncpy(config->psi_triggers[i], trigger->valuestring, SYSMON_PSI_TRIGGER_LEN - 1);
+            config->psi_triggers[i][SYSMON_PSI_TRIGGER_LEN - 1] = '\0';
+        }
+    }
+
+    // cgroups: "cgroup_paths": [ "services/*", "system.slice/mosquitto.service" ]
+    cJSON *cgroup_paths = cJSON_GetObjectItem(root, "cgroup_paths");
+    if (cgroup_paths != NULL && cJSON_IsArray(cgroup_paths)) {
+        config->num_cgroup_paths = 0;
+        cJSON *path;
+        cJSON_ArrayForEach(path, cgroup_paths) {
+            if (!cJSON_IsString(path) || config->num_cgroup_paths >= SYSMON_MAX_CGROUP_PATHS) {
+                continue;
+            }
+            char *dst = config->cgroup_paths[config->num_cgroup_paths++];
+            strncpy(dst, path->valuestring, SYSMON_CGROUP_PATH_LEN - 1);
+            dst[SYSMON_CGROUP_PATH_LEN - 1] = '\0';
+        }
+    }
+
+    // Watched processes: "watch_patterns": [ "dnsmasq", "hostapd*", "*mosquitto -c *" ]
+    cJSON *watch_patterns = cJSON_GetObjectItem(root, "watch_patterns");
+    if (watch_patterns != NULL && cJSON_IsArray(watch_patterns)) {
+        config->num_watch_patterns = 0;
+        cJSON *pattern;
+        cJSON_ArrayForEach(pattern, watch_patterns) {
+            if (!cJSON_IsString(pattern) || pattern->valuestring[0] == '\0' ||
+                config->num_watch_patterns >= SYSMON_MAX_WATCH_PATTERNS) {
+                continue;
+            }
+            char *dst = config->watch_patterns[config->num_watch_patterns++];
+            strncpy(dst, pattern->valuestring, SYSMON_WATCH_PATTERN_LEN - 1);
+            dst[SYSMON_WATCH_PATTERN_LEN - 1] = '\0';
+        }
+    }
+
+    // Per-collector schedules: "schedules": { "cpu": { "period_ms": 250, "phase_ms": 0 }, ... }
+    cJSON *schedules = cJSON_GetObjectItem(root, "schedules");
+    for (int i = 0; schedules != NULL && cJSON_IsObject(schedules) && i < SYSMON_COLLECTOR_COUNT; i++) {
+        cJSON *schedule = cJSON_GetObjectItem(schedules, g_collector_names[i]);
+        if (schedule == NULL || !cJSON_IsObject(schedule)) {
+            continue;
+        }
+
+        cJSON *period_ms = cJSON_GetObjectItem(schedule, "period_ms");
+        if (period_ms != NULL && cJSON_IsNumber(period_ms) && period_ms->valueint >= 0) {
+            config->schedules[i].period_ms = period_ms->valueint;
+        }
+
+        cJSON *phase_ms = cJSON_GetObjectItem(schedule, "phase_ms");
+        if (phase_ms != NULL && cJSON_IsNumber(phase_ms) && phase_ms->valueint >= 0) {
+            config->schedules[i].phase_ms = phase_ms->valueint;
+        }
+    }
 }
 
 /**
- * @brief Save configuration to a JSON file
+ * @brief Load configuration from a JSON file
  * @param config_path Path to configuration file
- * @param config Pointer to configuration structure
+ * @param config Pointer to configuration structure to populate
  * @return ERR_SUCCESS on success, error code on failure
  */
-int save_config(const char *config_path, SysmonConfig *config) {
+int load_config(const char *config_path, SysmonConfig *config) {
     if (config_path == NULL || config == NULL) {
         return ERR_INVALID_PARAM;
     }
 
+    char *json_str = read_file(config_path);
+    if (json_str == NULL) {
+        log_message(LOG_WARNING, "Could not read config file, using defaults");
+        return ERR_FILE_OPEN;
+    }
+
+    cJSON *root = cJSON_Parse(json_str);
+    free(json_str);
+
+    if (root == NULL) {
+        log_message(LOG_ERROR, "Error parsing config JSON");
+        return ERR_JSON_PARSE;
+    }
+
+    config_from_json(root, config);
+
+    cJSON_Delete(root);
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Build a JSON object holding every configuration key
+ * @param config Pointer to configuration structure
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* config_to_json(const SysmonConfig *config) {
+    if (config == NULL) {
+        return NULL;
+    }
+
     cJSON *root = cJSON_CreateObject();
     if (root == NULL) {
-        return ERR_JSON_CREATE;
+        return NULL;
     }
 
     // Add configuration values to JSON
     cJSON_AddStringToObject(root, "output_path", config->output_path);
     cJSON_AddStringToObject(root, "log_path", config->log_path);
     cJSON_AddNumberToObject(root, "collection_interval", config->collection_interval);
+    cJSON_AddNumberToObject(root, "collection_interval_ms", config->collection_interval_ms);
+    cJSON_AddNumberToObject(root, "history_size", config->history_size);
     cJSON_AddBoolToObject(root, "verbose", config->verbose);
 
     // Add collection flags
@@ -154,6 +372,62 @@ int save_config(const char *config_path, SysmonConfig *config) {
     cJSON_AddBoolToObject(root, "collect_uptime", config->collect_uptime);
     cJSON_AddBoolToObject(root, "collect_processes", config->collect_processes);
     cJSON_AddBoolToObject(root, "collect_swap", config->collect_swap);
+    cJSON_AddBoolToObject(root, "collect_pressure", config->collect_pressure);
+    cJSON_AddBoolToObject(root, "collect_cgroups", config->collect_cgroups);
+    cJSON_AddBoolToObject(root, "collect_interrupts", config->collect_interrupts);
+    cJSON_AddBoolToObject(root, "collect_connections", config->collect_connections);
+    cJSON_AddBoolToObject(root, "collect_protocols", config->collect_protocols);
+    cJSON_AddBoolToObject(root, "collect_thermal", config->collect_thermal);
+    cJSON_AddBoolToObject(root, "collect_paging", config->collect_paging);
+    cJSON_AddBoolToObject(root, "collect_watched", config->collect_watched);
+    cJSON_AddNumberToObject(root, "process_top_n", config->process_top_n);
+    cJSON_AddNumberToObject(root, "irq_top_n", config->irq_top_n);
+    cJSON_AddBoolToObject(root, "link_events", config->link_events);
+    cJSON_AddNumberToObject(root, "statvfs_timeout_ms", config->statvfs_timeout_ms);
+
+    cJSON *psi_triggers = cJSON_AddObjectToObject(root, "psi_triggers");
+    for (int i = 0; psi_triggers != NULL && i < SYSMON_PSI_COUNT; i++) {
+        cJSON_AddStringToObject(psi_triggers, g_psi_names[i], config->psi_triggers[i]);
+    }
+
+    cJSON *cgroup_paths = cJSON_AddArrayToObject(root, "cgroup_paths");
+    for (int i = 0; cgroup_paths != NULL && i < config->num_cgroup_paths; i++) {
+        cJSON_AddItemToArray(cgroup_paths, cJSON_CreateString(config->cgroup_paths[i]));
+    }
+
+    cJSON *watch_patterns = cJSON_AddArrayToObject(root, "watch_patterns");
+    for (int i = 0; watch_patterns != NULL && i < config->num_watch_patterns; i++) {
+        cJSON_AddItemToArray(watch_patterns, cJSON_CreateString(config->watch_patterns[i]));
+    }
+
+    // Add per-collector schedules
+    cJSON *schedules = cJSON_AddObjectToObject(root, "schedules");
+    for (int i = 0; schedules != NULL && i < SYSMON_COLLECTOR_COUNT; i++) {
+        cJSON *schedule = cJSON_AddObjectToObject(schedules, g_collector_names[i]);
+        if (schedule != NULL) {
+            cJSON_AddNumberToObject(schedule, "period_ms", config->schedules[i].period_ms);
+            cJSON_AddNumberToObject(schedule, "phase_ms", config->schedules[i].phase_ms);
+        }
+    }
+
+    return root;
+}
+
+/**
+ * @brief Save configuration to a JSON file
+ * @param config_path Path to configuration file
+ * @param config Pointer to configuration structure
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int save_config(const char *config_path, SysmonConfig *config) {
+    if (config_path == NULL || config == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    cJSON *root = config_to_json(config);
+    if (root == NULL) {
+        return ERR_JSON_CREATE;
+    }
 
     // Convert JSON to string and save to file
     char *json_str = cJSON_Print(root);
@@ -181,7 +455,12 @@ void print_config(SysmonConfig *config) {
     printf("Configuration:\n");
     printf("  Output path: %s\n", config->output_path);
     printf("  Log path: %s\n", config->log_path);
-    printf("  Collection interval: %d seconds\n", config->collection_interval);
+    if (config->collection_interval_ms > 0) {
+        printf("  Collection interval: %d ms\n", config->collection_interval_ms);
+    } else {
+        printf("  Collection interval: %d seconds\n", config->collection_interval);
+    }
+    printf("  History size: %d samples\n", config->history_size);
     printf("  Verbose: %s\n", config->verbose ? "Yes" : "No");
     printf("  Collections enabled:\n");
     printf("    CPU: %s\n", config->collect_cpu ? "Yes" : "No");
@@ -192,4 +471,33 @@ void print_config(SysmonConfig *config) {
     printf("    Uptime: %s\n", config->collect_uptime ? "Yes" : "No");
     printf("    Processes: %s\n", config->collect_processes ? "Yes" : "No");
     printf("    Swap: %s\n", config->collect_swap ? "Yes" : "No");
+    printf("    Pressure: %s\n", config->collect_pressure ? "Yes" : "No");
+    printf("    Cgroups: %s\n", config->collect_cgroups ? "Yes" : "No");
+    printf("    Interrupts: %s\n", config->collect_interrupts ? "Yes" : "No");
+    printf("    Connections: %s\n", config->collect_connections ? "Yes" : "No");
+    printf("    Protocols: %s\n", config->collect_protocols ? "Yes" : "No");
+    printf("    Thermal: %s\n", config->collect_thermal ? "Yes" : "No");
+    printf("    Paging: %s\n", config->collect_paging ? "Yes" : "No");
+    printf("    Watched: %s\n", config->collect_watched ? "Yes" : "No");
+    printf("  Top processes: %d\n", config->process_top_n);
+    printf("  Top interrupt lines: %d\n", config->irq_top_n);
+    printf("  Link events: %s\n", config->link_events ? "Yes" : "No");
+    printf("  statvfs timeout: %d ms\n", config->statvfs_timeout_ms);
+    printf("  PSI triggers:\n");
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        printf("    %s: %s\n", g_psi_names[i], config->psi_triggers[i][0] ? config->psi_triggers[i] : "none");
+    }
+    printf("  Cgroup paths:\n");
+    for (int i = 0; i < config->num_cgroup_paths; i++) {
+        printf("    %s\n", config->cgroup_paths[i]);
+    }
+    printf("  Watch patterns:\n");
+    for (int i = 0; i < config->num_watch_patterns; i++) {
+        printf("    %s\n", config->watch_patterns[i]);
+    }
+    printf("  Schedules:\n");
+    for (int i = 0; i < SYSMON_COLLECTOR_COUNT; i++) {
+        printf("    %s: every %d ms, phase %d ms\n", g_collector_names[i],
+               collector_period_ms(config, (SysmonCollector)i), config->schedules[i].phase_ms);
+    }
 }
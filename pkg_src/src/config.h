@@ -14,6 +14,21 @@
  */
 void set_default_config(SysmonConfig *config);
 
+/**
+ * @brief Get the configuration name of a collector
+ * @param collector Collector
+ * @return Name used as key under "schedules", or NULL if out of range
+ */
+const char* collector_name(SysmonCollector collector);
+
+/**
+ * @brief Get the period a collector runs at
+ * @param config Pointer to configuration structure
+ * @param collector Collector
+ * @return Period in milliseconds
+ */
+int collector_period_ms(const SysmonConfig *config, SysmonCollector collector);
+
 /**
  * @brief Load configuration from a JSON file
  * @param config_path Path to configuration file
@@ -22,6 +37,20 @@ void set_default_config(SysmonConfig *config);
  */
 int load_config(const char *config_path, SysmonConfig *config);
 
+/**
+ * @brief Apply the configuration keys present in a JSON object
+ * @param root JSON object holding configuration keys
+ * @param config Pointer to configuration structure to update
+ */
+void config_from_json(const cJSON *root, SysmonConfig *config);
+
+/**
+ * @brief Build a JSON object holding every configuration key
+ * @param config Pointer to configuration structure
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* config_to_json(const SysmonConfig *config);
+
 /**
  * @brief Save configuration to a JSON file
  * @param config_path Path to configuration file
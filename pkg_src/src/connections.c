@@ -0,0 +1,360 @@
+/**
+ * @file connections.c
+ * @brief Conntrack table and TCP socket table usage
+ */
+
+#include "connections.h"
+#include "procfs.h"
+#include "util.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+
+// Receive buffer; the kernel fills each dump datagram up to this size
+#define SOCK_DIAG_RECV_BUF_SIZE 32768
+
+// Longest wait for a dump reply before giving up on this reading
+#define SOCK_DIAG_RECV_TIMEOUT_SEC 1
+
+// Every TCP state, request sockets (TCP_NEW_SYN_RECV, 12) included
+#define SOCK_DIAG_ALL_STATES 0x1fffu
+#define SOCK_DIAG_NEW_SYN_RECV 12
+
+// TCP state numbers used for the rates
+#define TCP_STATE_ESTABLISHED 1
+#define TCP_STATE_SYN_RECV 3
+#define TCP_STATE_TIME_WAIT 6
+
+static ProcfsFile g_conntrack_count = PROCFS_FILE_INIT_CAP("/proc/sys/net/netfilter/nf_conntrack_count", 32);
+static ProcfsFile g_conntrack_max = PROCFS_FILE_INIT_CAP("/proc/sys/net/netfilter/nf_conntrack_max", 32);
+static ProcfsFile g_tcp_max_tw = PROCFS_FILE_INIT_CAP("/proc/sys/net/ipv4/tcp_max_tw_buckets", 32);
+static ProcfsFile g_sockstat = PROCFS_FILE_INIT_CAP("/proc/net/sockstat", 512);
+static ProcfsFile g_sockstat6 = PROCFS_FILE_INIT_CAP("/proc/net/sockstat6", 512);
+
+static int g_diag_fd = -1;
+static int g_diag_unavailable = 0;
+static uint32_t g_diag_seq = 0;
+static char *g_diag_buf = NULL;
+
+// Previous reading, for the growth rates
+static int g_has_prev = 0;
+static uint64_t g_prev_ns = 0;
+static int g_prev_has_conntrack = 0;
+static int g_prev_has_tcp = 0;
+static uint64_t g_prev_conntrack = 0;
+static uint64_t g_prev_tcp_total = 0;
+static uint64_t g_prev_established = 0;
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Read a procfs file holding a single number
+ * @param file File to read
+ * @param value Receives the number
+ * @return 1 on success, 0 otherwise
+ */
+static int read_number(ProcfsFile *file, uint64_t *value) {
+    if (procfs_try_read(file) != ERR_SUCCESS) {
+        return 0;
+    }
+
+    ProcfsScanner scanner;
+    procfs_scan_file(&scanner, file);
+    return procfs_next_u64(&scanner, value);
+}
+
+/**
+ * @brief Open the sock_diag socket and allocate the receive buffer
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int diag_open(void) {
+    g_diag_buf = (char*)malloc(SOCK_DIAG_RECV_BUF_SIZE);
+    if (g_diag_buf == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+
+    g_diag_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (g_diag_fd < 0) {
+        log_message(LOG_WARNING, "sock_diag unavailable (%s), using /proc/net/sockstat", strerror(errno));
+        return ERR_SYS_RESOURCE;
+    }
+
+    struct timeval timeout = { SOCK_DIAG_RECV_TIMEOUT_SEC, 0 };
+    setsockopt(g_diag_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close the sock_diag socket and release the receive buffer
+ */
+static void diag_close(void) {
+    if (g_diag_fd >= 0) {
+        close(g_diag_fd);
+        g_diag_fd = -1;
+    }
+    free(g_diag_buf);
+    g_diag_buf = NULL;
+}
+
+/**
+ * @brief Ask the kernel for a dump of every TCP socket of one family
+ * @param family AF_INET or AF_INET6
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int send_dump_request(int family) {
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+    } msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.nlh.nlmsg_len = sizeof(msg);
+    msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    msg.nlh.nlmsg_seq = ++g_diag_seq;
+    msg.req.sdiag_family = family;
+    msg.req.sdiag_protocol = IPPROTO_TCP;
+    msg.req.idiag_states = SOCK_DIAG_ALL_STATES;
+
+    // No extensions are requested, so each socket costs only its inet_diag_msg
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    ssize_t sent;
+    do {
+        sent = sendto(g_diag_fd, &msg, sizeof(msg), 0, (struct sockaddr*)&kernel, sizeof(kernel));
+    } while (sent < 0 && errno == EINTR);
+
+    return sent == (ssize_t)sizeof(msg) ? ERR_SUCCESS : ERR_FILE_WRITE;
+}
+
+/**
+ * @brief Count the TCP sockets of one family by state
+ * @param family AF_INET or AF_INET6
+ * @param states Per-state counters to add to
+ * @return ERR_SUCCESS on success, ERR_SYS_RESOURCE if the kernel lacks
+ *         inet_diag for the family, other error code on failure
+ */
+static int dump_family(int family, uint64_t *states) {
+    int result = send_dump_request(family);
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
+    for (;;) {
+        ssize_t n = recv(g_diag_fd, g_diag_buf, SOCK_DIAG_RECV_BUF_SIZE, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_message(LOG_WARNING, "sock_diag dump failed: %s", strerror(errno));
+            return ERR_FILE_READ;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr*)g_diag_buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            // Leftovers of a dump that was abandoned earlier
+            if (nlh->nlmsg_seq != g_diag_seq) {
+                continue;
+            }
+
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return ERR_SUCCESS;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *err = (const struct nlmsgerr*)NLMSG_DATA(nlh);
+                return nlh->nlmsg_len >= NLMSG_LENGTH(sizeof(*err)) && err->error == -ENOENT ?
+                       ERR_SYS_RESOURCE : ERR_FILE_READ;
+            }
+            if (nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY || nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg))) {
+                continue;
+            }
+
+            const struct inet_diag_msg *diag = (const struct inet_diag_msg*)NLMSG_DATA(nlh);
+            unsigned int state = diag->idiag_state;
+
+            // Request sockets of a listener are still half-open connections
+            if (state == SOCK_DIAG_NEW_SYN_RECV) {
+                state = TCP_STATE_SYN_RECV;
+            }
+            if (state < RESTRACK_TCP_STATES) {
+                states[state]++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Count TCP sockets by state over sock_diag
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_sock_diag(restrack_connections_t *connections) {
+    if (g_diag_unavailable) {
+        return ERR_SYS_RESOURCE;
+    }
+    if (g_diag_fd < 0 && diag_open() != ERR_SUCCESS) {
+        diag_close();
+        g_diag_unavailable = 1;
+        return ERR_SYS_RESOURCE;
+    }
+
+    uint64_t states[RESTRACK_TCP_STATES] = { 0 };
+    int result = dump_family(AF_INET, states);
+    if (result == ERR_SUCCESS) {
+        // IPv6 may be compiled out or its diag module missing; IPv4 counts still hold
+        int result6 = dump_family(AF_INET6, states);
+        if (result6 != ERR_SUCCESS && result6 != ERR_SYS_RESOURCE) {
+            result = result6;
+        }
+    } else if (result == ERR_SYS_RESOURCE) {
+        log_message(LOG_WARNING, "Kernel has no TCP inet_diag, using /proc/net/sockstat");
+        diag_close();
+        g_diag_unavailable = 1;
+    }
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
+    connections->tcp_source = RESTRACK_TCP_SOURCE_SOCK_DIAG;
+    connections->has_tcp_states = 1;
+    memcpy(connections->tcp_states, states, sizeof(states));
+    connections->tcp_total = 0;
+    for (int i = 0; i < RESTRACK_TCP_STATES; i++) {
+        connections->tcp_total += states[i];
+    }
+    connections->tcp_time_wait = states[TCP_STATE_TIME_WAIT];
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Find "<key> <value>" on a sockstat line such as "TCP: inuse 4 orphan 0 tw 0"
+ * @param file sockstat file that was read
+ * @param proto Protocol label, e.g. "TCP:"
+ * @param key Key within the line
+ * @param value Receives the value
+ * @return 1 if found, 0 otherwise
+ */
+static int sockstat_value(const ProcfsFile *file, const char *proto, const char *key, uint64_t *value) {
+    ProcfsScanner scanner, line;
+    procfs_scan_file(&scanner, file);
+
+    while (procfs_next_line(&scanner, &line)) {
+        const char *token;
+        size_t len;
+        if (!procfs_next_token(&line, 0, &token, &len) || !procfs_token_equals(token, len, proto)) {
+            continue;
+        }
+        while (procfs_next_token(&line, 0, &token, &len)) {
+            if (procfs_token_equals(token, len, key)) {
+                return procfs_next_u64(&line, value);
+            }
+        }
+        return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Take the TCP totals from /proc/net/sockstat and sockstat6
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_sockstat(restrack_connections_t *connections) {
+    uint64_t inuse = 0, inuse6 = 0, tw = 0;
+    if (procfs_try_read(&g_sockstat) != ERR_SUCCESS || !sockstat_value(&g_sockstat, "TCP:", "inuse", &inuse)) {
+        return ERR_FILE_READ;
+    }
+    sockstat_value(&g_sockstat, "TCP:", "tw", &tw);
+    if (procfs_try_read(&g_sockstat6) == ERR_SUCCESS) {
+        sockstat_value(&g_sockstat6, "TCP6:", "inuse", &inuse6);
+    }
+
+    connections->tcp_source = RESTRACK_TCP_SOURCE_SOCKSTAT;
+    connections->has_tcp_states = 0;
+    memset(connections->tcp_states, 0, sizeof(connections->tcp_states));
+    connections->tcp_time_wait = tw;
+    connections->tcp_total = inuse + inuse6 + tw;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Read the conntrack counters and count TCP sockets by state
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS if either table could be read, error code otherwise
+ */
+int connections_collect(restrack_connections_t *connections) {
+    if (connections == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    uint64_t now_ns = monotonic_ns();
+    memset(connections, 0, sizeof(*connections));
+
+    // nf_conntrack may not be loaded at all on hosts that do not route
+    connections->has_conntrack = read_number(&g_conntrack_count, &connections->conntrack_count) &&
+                                 read_number(&g_conntrack_max, &connections->conntrack_max);
+    if (connections->has_conntrack && connections->conntrack_max > 0) {
+        connections->conntrack_usage_percent = 100.0 * connections->conntrack_count / connections->conntrack_max;
+    }
+
+    connections->has_tcp = read_sock_diag(connections) == ERR_SUCCESS || read_sockstat(connections) == ERR_SUCCESS;
+    if (connections->has_tcp && read_number(&g_tcp_max_tw, &connections->tcp_max_tw_buckets) &&
+        connections->tcp_max_tw_buckets > 0) {
+        connections->time_wait_usage_percent = 100.0 * connections->tcp_time_wait / connections->tcp_max_tw_buckets;
+    }
+
+    if (!connections->has_conntrack && !connections->has_tcp) {
+        g_has_prev = 0;
+        return ERR_FILE_READ;
+    }
+
+    // Rates need the same tables on both readings
+    if (g_has_prev && now_ns > g_prev_ns && g_prev_has_conntrack == connections->has_conntrack &&
+        g_prev_has_tcp == connections->has_tcp) {
+        double elapsed_sec = (now_ns - g_prev_ns) / 1e9;
+        connections->has_rates = 1;
+        connections->interval_ms = elapsed_sec * 1000.0;
+        connections->conntrack_growth_per_sec =
+            ((double)connections->conntrack_count - (double)g_prev_conntrack) / elapsed_sec;
+        connections->tcp_growth_per_sec = ((double)connections->tcp_total - (double)g_prev_tcp_total) / elapsed_sec;
+        connections->established_growth_per_sec =
+            ((double)connections->tcp_states[TCP_STATE_ESTABLISHED] - (double)g_prev_established) / elapsed_sec;
+    }
+
+    g_has_prev = 1;
+    g_prev_ns = now_ns;
+    g_prev_has_conntrack = connections->has_conntrack;
+    g_prev_has_tcp = connections->has_tcp;
+    g_prev_conntrack = connections->conntrack_count;
+    g_prev_tcp_total = connections->tcp_total;
+    g_prev_established = connections->tcp_states[TCP_STATE_ESTABLISHED];
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close the netlink socket and the procfs files
+ */
+void connections_cleanup(void) {
+    diag_close();
+    g_diag_unavailable = 0;
+    procfs_close(&g_conntrack_count);
+    procfs_close(&g_conntrack_max);
+    procfs_close(&g_tcp_max_tw);
+    procfs_close(&g_sockstat);
+    procfs_close(&g_sockstat6);
+    g_has_prev = 0;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file connections.h
+ * @brief Conntrack table and TCP socket table usage
+ */
+
+#ifndef CONNECTIONS_H
+#define CONNECTIONS_H
+
+#include "resources.h"
+
+/**
+ * @brief Read the conntrack counters and count TCP sockets by state
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS if either table could be read, error code otherwise
+ *
+ * TCP sockets are counted from a binary NETLINK_SOCK_DIAG dump of the
+ * IPv4 and IPv6 tables, which carries a fixed 72-byte record per socket
+ * instead of a text line. Kernels without inet_diag fall back to the
+ * totals of /proc/net/sockstat, which have no per-state breakdown.
+ */
+int connections_collect(restrack_connections_t *connections);
+
+/**
+ * @brief Close the netlink socket and the procfs files
+ */
+void connections_cleanup(void);
+
+#endif /* CONNECTIONS_H */
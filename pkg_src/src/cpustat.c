@@ -0,0 +1,125 @@
+/**
+ * @file cpustat.c
+ * @brief Interval CPU utilization from consecutive /proc/stat readings
+ */
+
+#include "cpustat.h"
+
+// Row of the aggregate line in the previous-counter table
+#define CPUSTAT_TOTAL_ROW RESTRACK_MAX_CPUS
+
+// Counters from the previous call, one row per CPU number plus the aggregate
+static uint64_t g_prev_ticks[RESTRACK_MAX_CPUS + 1][RESTRACK_CPU_STATES];
+static int g_primed = 0;
+
+// Call that last saw each row, 0 for never; a row missing from the previous call has no baseline
+static unsigned int g_row_seen[RESTRACK_MAX_CPUS + 1];
+static unsigned int g_calls = 0;
+
+// Context switch and interrupt totals from the previous call
+static int g_has_prev_counters = 0;
+static uint64_t g_prev_ctxt = 0;
+static uint64_t g_prev_intr = 0;
+static uint64_t g_prev_ns = 0;
+
+/**
+ * @brief Compute the interval shares of one CPU and remember its counters
+ * @param stat CPU line with fresh ticks
+ * @param row Row of the CPU in the previous-counter table
+ */
+static void update_stat(restrack_cpu_stat_t *stat, int row) {
+    uint64_t *prev = g_prev_ticks[row];
+
+    // A CPU that came online since the previous call only sets its baseline.
+    // On the very first call every row reports its shares since boot instead.
+    int primed = !g_primed || g_row_seen[row] == g_calls - 1;
+    g_row_seen[row] = g_calls;
+    stat->has_percent = primed;
+    if (!primed) {
+        memcpy(prev, stat->ticks, sizeof(stat->ticks));
+        memset(stat->percent, 0, sizeof(stat->percent));
+        stat->usage_percent = 0.0;
+        return;
+    }
+
+    uint64_t delta[RESTRACK_CPU_STATES];
+    uint64_t total = 0;
+
+    // Fixed-width, branch-free loops so the compiler can vectorize them.
+    // A counter that went backwards (hotplug, iowait accounting) counts as 0.
+    for (int i = 0; i < RESTRACK_CPU_STATES; i++) {
+        uint64_t cur = stat->ticks[i];
+        delta[i] = (cur - prev[i]) & -(uint64_t)(cur >= prev[i]);
+        prev[i] = cur;
+    }
+    for (int i = 0; i < RESTRACK_CPU_STATES; i++) {
+        total += delta[i];
+    }
+
+    double scale = total > 0 ? 100.0 / (double)total : 0.0;
+    for (int i = 0; i < RESTRACK_CPU_STATES; i++) {
+        stat->percent[i] = (double)delta[i] * scale;
+    }
+    stat->usage_percent = total > 0 ? 100.0 - stat->percent[RESTRACK_CPU_IDLE] : 0.0;
+}
+
+/**
+ * @brief Turn the context switch and interrupt totals into rates
+ * @param cpu CPU section holding fresh totals; its rates are filled
+ * @param read_ns CLOCK_MONOTONIC time the totals were read
+ */
+static void update_rates(restrack_cpu_t *cpu, uint64_t read_ns) {
+    cpu->has_rates = 0;
+    cpu->ctxt_per_sec = 0.0;
+    cpu->intr_per_sec = 0.0;
+
+    if (cpu->has_counters && g_has_prev_counters && read_ns > g_prev_ns &&
+        cpu->ctxt >= g_prev_ctxt && cpu->intr >= g_prev_intr) {
+        double elapsed_sec = (read_ns - g_prev_ns) / 1e9;
+        cpu->has_rates = 1;
+        cpu->ctxt_per_sec = (cpu->ctxt - g_prev_ctxt) / elapsed_sec;
+        cpu->intr_per_sec = (cpu->intr - g_prev_intr) / elapsed_sec;
+    }
+
+    g_has_prev_counters = cpu->has_counters;
+    g_prev_ctxt = cpu->ctxt;
+    g_prev_intr = cpu->intr;
+    g_prev_ns = read_ns;
+}
+
+/**
+ * @brief Turn the cumulative counters of a CPU section into interval shares
+ * @param cpu CPU section holding freshly read ticks; its percentages are filled
+ * @param read_ns CLOCK_MONOTONIC time the counters were read
+ */
+void cpustat_update(restrack_cpu_t *cpu, uint64_t read_ns) {
+    if (cpu == NULL) {
+        return;
+    }
+
+    g_calls++;
+    cpu->interval = g_primed;
+    update_stat(&cpu->total, CPUSTAT_TOTAL_ROW);
+
+    for (int i = 0; i < cpu->num_cpus; i++) {
+        restrack_cpu_stat_t *stat = &cpu->cpus[i];
+        if (stat->id < 0 || stat->id >= RESTRACK_MAX_CPUS) {
+            continue;
+        }
+        update_stat(stat, stat->id);
+    }
+
+    update_rates(cpu, read_ns);
+    g_primed = 1;
+}
+
+/**
+ * @brief Forget the remembered counters
+ */
+void cpustat_reset(void) {
+    memset(g_prev_ticks, 0, sizeof(g_prev_ticks));
+    memset(g_row_seen, 0, sizeof(g_row_seen));
+    g_calls = 0;
+    g_primed = 0;
+    g_has_prev_counters = 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file cpustat.h
+ * @brief Interval CPU utilization from consecutive /proc/stat readings
+ */
+
+#ifndef CPUSTAT_H
+#define CPUSTAT_H
+
+#include "resources.h"
+
+/**
+ * @brief Turn the cumulative counters of a CPU section into interval shares
+ * @param cpu CPU section holding freshly read ticks; its percentages are filled
+ * @param read_ns CLOCK_MONOTONIC time the counters were read
+ *
+ * The counters of every CPU and of the aggregate are remembered until the
+ * next call, keyed by CPU number, so CPUs going offline and back do not
+ * shift the other rows. The first call reports shares since boot. A CPU
+ * missing from the previous call, e.g. one just brought online, gets no
+ * shares on this call and has_percent cleared; its counters become the
+ * baseline for the next one. The context switch and interrupt totals
+ * become per-second rates from the second call on.
+ */
+void cpustat_update(restrack_cpu_t *cpu, uint64_t read_ns);
+
+/**
+ * @brief Forget the remembered counters
+ */
+void cpustat_reset(void);
+
+#endif /* CPUSTAT_H */
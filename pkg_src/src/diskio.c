@@ -0,0 +1,221 @@
+/**
+ * @file diskio.c
+ * @brief Interval disk IO rates from consecutive /proc/diskstats readings
+ */
+
+#include "diskio.h"
+
+// Counters kept per device, in this order
+enum {
+    DISKIO_READS,
+    DISKIO_WRITES,
+    DISKIO_READ_SECTORS,
+    DISKIO_WRITTEN_SECTORS,
+    DISKIO_READ_MS,
+    DISKIO_WRITE_MS,
+    DISKIO_IO_MS,
+    DISKIO_WEIGHTED_IO_MS,
+    DISKIO_COUNTERS
+};
+
+/**
+ * @struct DiskEntry
+ * @brief Counters of one device from the previous call
+ */
+typedef struct {
+    unsigned int major;
+    unsigned int minor;
+    char device[RESTRACK_NAME_LEN];
+    unsigned int sector_size;
+    uint64_t counters[DISKIO_COUNTERS];
+} DiskEntry;
+
+// Devices seen by the previous call, and the table being built
+static DiskEntry g_entries[RESTRACK_MAX_DISKS];
+static int g_num_entries = 0;
+static DiskEntry g_new_entries[RESTRACK_MAX_DISKS];
+static int g_num_new_entries = 0;
+static uint64_t g_prev_ns = 0;
+
+/**
+ * @brief Read a small unsigned integer from a sysfs file
+ * @param path File path
+ * @param value Receives the value
+ * @return 1 on success, 0 otherwise
+ */
+static int read_sysfs_uint(const char *path, unsigned int *value) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    char buf[16];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+
+    unsigned long v = strtoul(buf, NULL, 10);
+    if (v == 0 || v > 65536) {
+        return 0;
+    }
+    *value = (unsigned int)v;
+    return 1;
+}
+
+/**
+ * @brief Read the logical block size of a device from sysfs
+ * @param major Device major number
+ * @param minor Device minor number
+ * @return Size in bytes, 0 when unknown
+ */
+static unsigned int read_sector_size(unsigned int major, unsigned int minor) {
+    char path[96];
+    unsigned int size;
+
+    // Whole disks have a queue directory, partitions use their parent's
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/hw_sector_size", major, minor);
+    if (read_sysfs_uint(path, &size)) {
+        return size;
+    }
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/hw_sector_size", major, minor);
+    if (read_sysfs_uint(path, &size)) {
+        return size;
+    }
+    return 0;
+}
+
+/**
+ * @brief Difference between two readings of a counter
+ * @param cur Current reading
+ * @param prev Previous reading
+ * @param delta Receives the difference
+ * @return 1 on success, 0 if the counter was reset
+ *
+ * Kernels with a 32-bit unsigned long wrap the counters at 2^32. A value
+ * that went back is taken as such a wrap when both readings fit in 32
+ * bits and the result is plausible, and as a reset otherwise.
+ */
+static int counter_delta(uint64_t cur, uint64_t prev, uint64_t *delta) {
+    if (cur >= prev) {
+        *delta = cur - prev;
+        return 1;
+    }
+    if (prev <= UINT32_MAX) {
+        uint64_t wrapped = cur + (UINT64_C(1) << 32) - prev;
+        if (wrapped < (UINT64_C(1) << 31)) {
+            *delta = wrapped;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compute the rates of one device against its previous counters
+ * @param io Device with fresh counters
+ * @param prev Counters of the same device from the previous call
+ * @param elapsed_ms Time since the previous call
+ */
+static void update_rates(restrack_disk_io_t *io, const DiskEntry *prev, double elapsed_ms) {
+    const uint64_t cur[DISKIO_COUNTERS] = {
+        io->reads, io->writes, io->read_sectors, io->written_sectors,
+        io->read_ms, io->write_ms, io->io_ms, io->weighted_io_ms
+    };
+    uint64_t delta[DISKIO_COUNTERS];
+
+    for (int i = 0; i < DISKIO_COUNTERS; i++) {
+        if (!counter_delta(cur[i], prev->counters[i], &delta[i])) {
+            return;
+        }
+    }
+
+    double per_sec = 1000.0 / elapsed_ms;
+    uint64_t ios = delta[DISKIO_READS] + delta[DISKIO_WRITES];
+
+    io->has_rates = 1;
+    io->interval_ms = elapsed_ms;
+    io->read_iops = delta[DISKIO_READS] * per_sec;
+    io->write_iops = delta[DISKIO_WRITES] * per_sec;
+    io->read_kb_per_sec = delta[DISKIO_READ_SECTORS] / 2.0 * per_sec;
+    io->write_kb_per_sec = delta[DISKIO_WRITTEN_SECTORS] / 2.0 * per_sec;
+
+    // io_ms can run slightly ahead of the wall clock between readings
+    io->util_percent = 100.0 * delta[DISKIO_IO_MS] / elapsed_ms;
+    if (io->util_percent > 100.0) {
+        io->util_percent = 100.0;
+    }
+    io->avg_queue_depth = delta[DISKIO_WEIGHTED_IO_MS] / elapsed_ms;
+
+    io->await_ms = ios > 0 ? (double)(delta[DISKIO_READ_MS] + delta[DISKIO_WRITE_MS]) / ios : 0.0;
+    io->read_await_ms = delta[DISKIO_READS] > 0 ? (double)delta[DISKIO_READ_MS] / delta[DISKIO_READS] : 0.0;
+    io->write_await_ms = delta[DISKIO_WRITES] > 0 ? (double)delta[DISKIO_WRITE_MS] / delta[DISKIO_WRITES] : 0.0;
+}
+
+/**
+ * @brief Turn the cumulative counters of a disk section into interval rates
+ * @param disk Disk section holding freshly read counters; its rates are filled
+ */
+void diskio_update(restrack_disk_t *disk) {
+    if (disk == NULL) {
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    double elapsed_ms = g_prev_ns > 0 ? (double)(now_ns - g_prev_ns) / 1e6 : 0.0;
+    g_prev_ns = now_ns;
+
+    g_num_new_entries = 0;
+    for (int i = 0; i < disk->num_devices; i++) {
+        restrack_disk_io_t *io = &disk->io_stats[i];
+        io->has_rates = 0;
+
+        // A device replaced under the same numbers starts over
+        const DiskEntry *prev = NULL;
+        for (int j = 0; j < g_num_entries; j++) {
+            if (g_entries[j].major == io->major && g_entries[j].minor == io->minor &&
+                strcmp(g_entries[j].device, io->device) == 0) {
+                prev = &g_entries[j];
+                break;
+            }
+        }
+
+        io->sector_size = prev != NULL ? prev->sector_size : read_sector_size(io->major, io->minor);
+        if (prev != NULL && elapsed_ms > 0.0) {
+            update_rates(io, prev, elapsed_ms);
+        }
+
+        if (g_num_new_entries < RESTRACK_MAX_DISKS) {
+            DiskEntry *entry = &g_new_entries[g_num_new_entries++];
+            entry->major = io->major;
+            entry->minor = io->minor;
+            memcpy(entry->device, io->device, sizeof(entry->device));
+            entry->sector_size = io->sector_size;
+            entry->counters[DISKIO_READS] = io->reads;
+            entry->counters[DISKIO_WRITES] = io->writes;
+            entry->counters[DISKIO_READ_SECTORS] = io->read_sectors;
+            entry->counters[DISKIO_WRITTEN_SECTORS] = io->written_sectors;
+            entry->counters[DISKIO_READ_MS] = io->read_ms;
+            entry->counters[DISKIO_WRITE_MS] = io->write_ms;
+            entry->counters[DISKIO_IO_MS] = io->io_ms;
+            entry->counters[DISKIO_WEIGHTED_IO_MS] = io->weighted_io_ms;
+        }
+    }
+
+    // Devices that disappeared are forgotten
+    memcpy(g_entries, g_new_entries, g_num_new_entries * sizeof(DiskEntry));
+    g_num_entries = g_num_new_entries;
+}
+
+/**
+ * @brief Forget the remembered counters
+ */
+void diskio_reset(void) {
+    g_num_entries = 0;
+    g_num_new_entries = 0;
+    g_prev_ns = 0;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file diskio.h
+ * @brief Interval disk IO rates from consecutive /proc/diskstats readings
+ */
+
+#ifndef DISKIO_H
+#define DISKIO_H
+
+#include "resources.h"
+
+/**
+ * @brief Turn the cumulative counters of a disk section into interval rates
+ * @param disk Disk section holding freshly read counters; its rates are filled
+ *
+ * The counters of every device are remembered until the next call, keyed
+ * by major:minor. A device that is new, was replaced by another one under
+ * the same numbers, or whose counters went back reports no rates until
+ * its next reading. 32-bit counters of 32-bit kernels wrap safely.
+ */
+void diskio_update(restrack_disk_t *disk);
+
+/**
+ * @brief Forget the remembered counters
+ */
+void diskio_reset(void);
+
+#endif /* DISKIO_H */
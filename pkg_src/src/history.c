@@ -0,0 +1,81 @@
+/**
+ * @file history.c
+ * @brief Fixed-capacity in-memory ring of serialized history samples
+ */
+
+#include "history.h"
+
+/**
+ * @brief Allocate the slots of a history ring
+ * @param history Ring to initialise
+ * @param capacity Maximum number of samples kept
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int history_init(SysmonHistory *history, size_t capacity) {
+    if (history == NULL || capacity == 0) {
+        return ERR_INVALID_PARAM;
+    }
+
+    memset(history, 0, sizeof(*history));
+    history->slots = (HistoryRecord*)calloc(capacity, sizeof(HistoryRecord));
+    if (history->slots == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+    history->capacity = capacity;
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Add a sample, evicting the oldest one when the ring is full
+ * @param history Initialised ring
+ * @param record Heap-allocated serialized sample; ownership moves to the ring
+ * @param len Length of the sample in bytes
+ */
+void history_push(SysmonHistory *history, char *record, size_t len) {
+    if (history == NULL || history->slots == NULL) {
+        free(record);
+        return;
+    }
+
+    HistoryRecord *slot = &history->slots[history->head];
+    free(slot->data);
+    slot->data = record;
+    slot->len = len;
+
+    history->head = (history->head + 1) % history->capacity;
+    if (history->count < history->capacity) {
+        history->count++;
+    }
+}
+
+/**
+ * @brief Get a sample by age
+ * @param history Initialised ring
+ * @param index 0 for the oldest sample, count - 1 for the newest
+ * @return Pointer to the record or NULL if index is out of range
+ */
+const HistoryRecord* history_get(const SysmonHistory *history, size_t index) {
+    if (history == NULL || index >= history->count) {
+        return NULL;
+    }
+
+    size_t oldest = (history->head + history->capacity - history->count) % history->capacity;
+    return &history->slots[(oldest + index) % history->capacity];
+}
+
+/**
+ * @brief Release every sample and the slot array
+ * @param history Ring to free
+ */
+void history_free(SysmonHistory *history) {
+    if (history == NULL || history->slots == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < history->capacity; i++) {
+        free(history->slots[i].data);
+    }
+    free(history->slots);
+    memset(history, 0, sizeof(*history));
+}
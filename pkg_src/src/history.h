@@ -0,0 +1,66 @@
+/**
+ * @file history.h
+ * @brief Fixed-capacity in-memory ring of serialized history samples
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "sysmon.h"
+
+/**
+ * @struct HistoryRecord
+ * @brief One serialized sample held by the history ring
+ */
+typedef struct {
+    char *data;                  // Serialized sample, owned by the ring
+    size_t len;                  // Length of the sample in bytes
+} HistoryRecord;
+
+/**
+ * @struct SysmonHistory
+ * @brief Ring buffer of the newest samples
+ *
+ * The slot array is allocated once. Pushing stores the record pointer in
+ * the next slot and releases whatever that slot held, so adding a sample
+ * costs the same no matter how full the ring is. The ring does no locking
+ * of its own; the owner serializes access.
+ */
+typedef struct {
+    HistoryRecord *slots;        // Preallocated slot array
+    size_t capacity;             // Number of slots
+    size_t head;                 // Slot written by the next push
+    size_t count;                // Number of occupied slots
+} SysmonHistory;
+
+/**
+ * @brief Allocate the slots of a history ring
+ * @param history Ring to initialise
+ * @param capacity Maximum number of samples kept
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int history_init(SysmonHistory *history, size_t capacity);
+
+/**
+ * @brief Add a sample, evicting the oldest one when the ring is full
+ * @param history Initialised ring
+ * @param record Heap-allocated serialized sample; ownership moves to the ring
+ * @param len Length of the sample in bytes
+ */
+void history_push(SysmonHistory *history, char *record, size_t len);
+
+/**
+ * @brief Get a sample by age
+ * @param history Initialised ring
+ * @param index 0 for the oldest sample, count - 1 for the newest
+ * @return Pointer to the record or NULL if index is out of range
+ */
+const HistoryRecord* history_get(const SysmonHistory *history, size_t index);
+
+/**
+ * @brief Release every sample and the slot array
+ * @param history Ring to free
+ */
+void history_free(SysmonHistory *history);
+
+#endif /* HISTORY_H */
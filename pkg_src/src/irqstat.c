@@ -0,0 +1,634 @@
+/**
+ * @file irqstat.c
+ * @brief Softirq, interrupt and packet backlog rates from per-CPU counter matrices
+ */
+
+#include "irqstat.h"
+#include "procfs.h"
+#include "util.h"
+
+// Characters kept of a row label, e.g. "NET_RX" or "123"
+#define IRQSTAT_LABEL_LEN 16
+
+// Columns of /proc/net/softnet_stat kept per CPU
+enum {
+    SOFTNET_PROCESSED,
+    SOFTNET_DROPPED,
+    SOFTNET_TIME_SQUEEZE,
+    SOFTNET_COLS
+};
+
+// softnet_stat column holding the CPU number since Linux 5.10, and the most columns read
+#define SOFTNET_CPU_COLUMN 12
+#define SOFTNET_MAX_COLUMNS 16
+
+/**
+ * @struct RowLabel
+ * @brief Label of a matrix row, the text before the colon
+ */
+typedef struct {
+    char text[IRQSTAT_LABEL_LEN];
+} RowLabel;
+
+/**
+ * @struct CounterMatrix
+ * @brief Per-CPU counters of one file and the reading before them
+ *
+ * The kernel prints these counters as 32-bit values, so they are kept as
+ * uint32_t and their differences, taken in 32-bit arithmetic, stay right
+ * across a wrap. All rows share one flat array, so the difference of a
+ * whole file is one branch-free loop that the compiler vectorizes.
+ */
+typedef struct {
+    int rows;                    // Rows of the current reading
+    int cols;                    // CPUs, i.e. counters per row
+    size_t cell_cap;             // Cells allocated in cur, prev and delta
+    size_t row_cap;              // Rows allocated in labels and prev_labels
+    uint32_t *cur;
+    uint32_t *prev;
+    uint32_t *delta;             // cur minus the matching rows of prev
+    RowLabel *labels;
+    RowLabel *prev_labels;
+    int prev_rows;
+    int col_ids[RESTRACK_MAX_CPUS]; // CPU number of each column
+    int complete;                // Whether cur holds a full reading
+    int has_delta;               // Whether delta is valid
+    uint64_t read_ns;            // CLOCK_MONOTONIC time of cur
+    uint64_t elapsed_ns;         // Time covered by delta
+} CounterMatrix;
+
+/**
+ * @struct DescSpan
+ * @brief Description of a /proc/interrupts line, inside the file buffer
+ */
+typedef struct {
+    const char *text;
+    size_t len;
+} DescSpan;
+
+static ProcfsFile g_proc_softirqs = PROCFS_FILE_INIT("/proc/softirqs");
+static ProcfsFile g_proc_interrupts = PROCFS_FILE_INIT("/proc/interrupts");
+static ProcfsFile g_proc_softnet = PROCFS_FILE_INIT("/proc/net/softnet_stat");
+
+static CounterMatrix g_softirqs;
+static CounterMatrix g_interrupts;
+static CounterMatrix g_softnet;
+
+// Descriptions of the rows of g_interrupts, valid until the next read
+static DescSpan *g_irq_desc = NULL;
+static size_t g_irq_desc_cap = 0;
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Turn aligned previous counters into differences
+ * @param delta Previous counters, replaced by cur minus them
+ * @param cur Current counters
+ * @param n Number of counters
+ *
+ * Unsigned 32-bit subtraction wraps exactly like the kernel's counters
+ * and needs no branch, so this loop compiles to SIMD subtractions.
+ */
+static void subtract_counters(uint32_t *restrict delta, const uint32_t *restrict cur, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        delta[i] = cur[i] - delta[i];
+    }
+}
+
+/**
+ * @brief Sum a row of counters
+ * @param row First counter
+ * @param cols Number of counters
+ * @return Sum
+ */
+static uint64_t row_sum(const uint32_t *row, int cols) {
+    uint64_t sum = 0;
+    for (int c = 0; c < cols; c++) {
+        sum += row[c];
+    }
+    return sum;
+}
+
+/**
+ * @brief Make room for a number of rows
+ * @param m Matrix
+ * @param rows Rows needed
+ * @return 1 on success, 0 if memory ran out
+ */
+static int matrix_reserve(CounterMatrix *m, int rows) {
+    size_t cells = (size_t)rows * (m->cols > 0 ? m->cols : 1);
+
+    if (cells > m->cell_cap) {
+        size_t cap = m->cell_cap ? m->cell_cap : 256;
+        while (cap < cells) {
+            cap *= 2;
+        }
+        uint32_t *buffers[3] = { m->cur, m->prev, m->delta };
+        for (int i = 0; i < 3; i++) {
+            uint32_t *grown = (uint32_t*)realloc(buffers[i], cap * sizeof(uint32_t));
+            if (grown == NULL) {
+                m->cur = buffers[0];
+                m->prev = buffers[1];
+                m->delta = buffers[2];
+                return 0;
+            }
+            buffers[i] = grown;
+        }
+        m->cur = buffers[0];
+        m->prev = buffers[1];
+        m->delta = buffers[2];
+        m->cell_cap = cap;
+    }
+
+    if ((size_t)rows > m->row_cap) {
+        size_t cap = m->row_cap ? m->row_cap : 32;
+        while (cap < (size_t)rows) {
+            cap *= 2;
+        }
+        RowLabel *labels = (RowLabel*)realloc(m->labels, cap * sizeof(RowLabel));
+        if (labels == NULL) {
+            return 0;
+        }
+        m->labels = labels;
+        RowLabel *prev_labels = (RowLabel*)realloc(m->prev_labels, cap * sizeof(RowLabel));
+        if (prev_labels == NULL) {
+            return 0;
+        }
+        m->prev_labels = prev_labels;
+        m->row_cap = cap;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Keep the last reading as the previous one and start a new one
+ * @param m Matrix
+ * @param col_ids CPU number of each column, or NULL when columns are not CPUs
+ * @param cols Number of columns
+ * @param now_ns Time of the new reading
+ *
+ * A change in the columns, such as a CPU going offline, drops the
+ * previous reading since its counters no longer line up.
+ */
+static void matrix_begin(CounterMatrix *m, const int *col_ids, int cols, uint64_t now_ns) {
+    int same_cols = m->complete && cols == m->cols &&
+                    (col_ids == NULL || memcmp(col_ids, m->col_ids, cols * sizeof(int)) == 0);
+
+    uint32_t *cells = m->prev;
+    m->prev = m->cur;
+    m->cur = cells;
+    RowLabel *labels = m->prev_labels;
+    m->prev_labels = m->labels;
+    m->labels = labels;
+
+    m->prev_rows = same_cols ? m->rows : 0;
+    m->has_delta = same_cols;
+    m->elapsed_ns = same_cols && now_ns > m->read_ns ? now_ns - m->read_ns : 0;
+    m->read_ns = now_ns;
+    m->complete = 0;
+    m->rows = 0;
+    m->cols = cols;
+    if (col_ids != NULL) {
+        memcpy(m->col_ids, col_ids, cols * sizeof(int));
+    }
+}
+
+/**
+ * @brief Append a zeroed row
+ * @param m Matrix
+ * @param label Start of the row label
+ * @param len Length of the label
+ * @return Counters of the row, or NULL if memory ran out
+ */
+static uint32_t* matrix_add_row(CounterMatrix *m, const char *label, size_t len) {
+    if (!matrix_reserve(m, m->rows + 1)) {
+        return NULL;
+    }
+
+    uint32_t *row = m->cur + (size_t)m->rows * m->cols;
+    memset(row, 0, m->cols * sizeof(uint32_t));
+    procfs_copy_token(m->labels[m->rows].text, IRQSTAT_LABEL_LEN, label, len);
+    m->rows++;
+    return row;
+}
+
+/**
+ * @brief Complete a reading and compute its differences
+ * @param m Matrix
+ *
+ * When the rows are those of the previous reading, which is the usual
+ * case, the previous counters are copied as a whole. Otherwise each row
+ * is matched by label; new rows get a zero difference.
+ */
+static void matrix_finish(CounterMatrix *m) {
+    m->complete = 1;
+    if (!m->has_delta || m->elapsed_ns == 0) {
+        m->has_delta = 0;
+        return;
+    }
+
+    size_t cells = (size_t)m->rows * m->cols;
+    if (m->prev_rows == m->rows && memcmp(m->labels, m->prev_labels, m->rows * sizeof(RowLabel)) == 0) {
+        memcpy(m->delta, m->prev, cells * sizeof(uint32_t));
+    } else {
+        for (int r = 0; r < m->rows; r++) {
+            const uint32_t *base = m->cur + (size_t)r * m->cols;
+
+            // Rows mostly keep their place, so start looking at the same index
+            for (int i = 0; i < m->prev_rows; i++) {
+                int p = (r + i) % m->prev_rows;
+                if (strcmp(m->labels[r].text, m->prev_labels[p].text) == 0) {
+                    base = m->prev + (size_t)p * m->cols;
+                    break;
+                }
+            }
+            memcpy(m->delta + (size_t)r * m->cols, base, m->cols * sizeof(uint32_t));
+        }
+    }
+
+    subtract_counters(m->delta, m->cur, cells);
+}
+
+/**
+ * @brief Parse a "CPU0 CPU1 ..." header line
+ * @param line Scanner over the header
+ * @param col_ids Receives the CPU number of each column
+ * @param dropped Receives the columns beyond RESTRACK_MAX_CPUS
+ * @return Number of columns kept
+ */
+static int parse_cpu_header(ProcfsScanner *line, int *col_ids, int *dropped) {
+    const char *token;
+    size_t len;
+    int cols = 0;
+
+    *dropped = 0;
+    while (procfs_next_token(line, 0, &token, &len)) {
+        ProcfsScanner digits = { token + 3, token + len };
+        uint64_t cpu;
+        if (len <= 3 || strncmp(token, "CPU", 3) != 0 || !procfs_next_u64(&digits, &cpu)) {
+            continue;
+        }
+        if (cols >= RESTRACK_MAX_CPUS) {
+            (*dropped)++;
+            continue;
+        }
+        col_ids[cols++] = (int)cpu;
+    }
+    return cols;
+}
+
+/**
+ * @brief Read a file laid out as a CPU header and "label: count count ..." rows
+ * @param file /proc/softirqs or /proc/interrupts
+ * @param m Matrix receiving the rows
+ * @param now_ns Time of the reading
+ * @param with_desc Whether to keep the text after the counters of each row in g_irq_desc
+ * @param dropped Receives the CPUs beyond RESTRACK_MAX_CPUS
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_cpu_table(ProcfsFile *file, CounterMatrix *m, uint64_t now_ns, int with_desc, int *dropped) {
+    int result = procfs_read(file);
+    if (result != ERR_SUCCESS) {
+        m->complete = 0;
+        return result;
+    }
+
+    ProcfsScanner scanner, line;
+    procfs_scan_file(&scanner, file);
+    if (!procfs_next_line(&scanner, &line)) {
+        m->complete = 0;
+        return ERR_FILE_READ;
+    }
+
+    int col_ids[RESTRACK_MAX_CPUS];
+    int cols = parse_cpu_header(&line, col_ids, dropped);
+    matrix_begin(m, col_ids, cols, now_ns);
+
+    while (procfs_next_line(&scanner, &line)) {
+        const char *label;
+        size_t label_len;
+        if (!procfs_next_token(&line, ':', &label, &label_len) || line.pos >= line.end || *line.pos != ':') {
+            continue;
+        }
+        line.pos++;
+
+        uint32_t *row = matrix_add_row(m, label, label_len);
+        if (row == NULL) {
+            m->complete = 0;
+            return ERR_MEMORY_ALLOC;
+        }
+
+        // Lines such as "ERR:" carry a single count
+        uint64_t value;
+        for (int c = 0; c < cols && procfs_next_u64(&line, &value); c++) {
+            row[c] = (uint32_t)value;
+        }
+
+        if (with_desc) {
+            if ((size_t)m->rows > g_irq_desc_cap) {
+                size_t cap = m->row_cap;
+                DescSpan *grown = (DescSpan*)realloc(g_irq_desc, cap * sizeof(DescSpan));
+                if (grown == NULL) {
+                    m->complete = 0;
+                    return ERR_MEMORY_ALLOC;
+                }
+                g_irq_desc = grown;
+                g_irq_desc_cap = cap;
+            }
+
+            procfs_skip_space(&line);
+            const char *end = line.end;
+            while (end > line.pos && (end[-1] == ' ' || end[-1] == '\t')) {
+                end--;
+            }
+            g_irq_desc[m->rows - 1].text = line.pos;
+            g_irq_desc[m->rows - 1].len = end - line.pos;
+        }
+    }
+
+    matrix_finish(m);
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Parse the next hexadecimal number
+ * @param scanner Scanner to advance
+ * @param value Receives the value
+ * @return 1 if a number was parsed, 0 otherwise
+ */
+static int next_hex(ProcfsScanner *scanner, uint64_t *value) {
+    procfs_skip_space(scanner);
+
+    const char *p = scanner->pos;
+    uint64_t v = 0;
+    while (p < scanner->end && isxdigit((unsigned char)*p)) {
+        v = v * 16 + (uint64_t)(isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10));
+        p++;
+    }
+    if (p == scanner->pos) {
+        return 0;
+    }
+
+    scanner->pos = p;
+    *value = v;
+    return 1;
+}
+
+/**
+ * @brief Read /proc/net/softnet_stat, one row of hexadecimal counters per online CPU
+ * @param now_ns Time of the reading
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_softnet(uint64_t now_ns) {
+    int result = procfs_try_read(&g_proc_softnet);
+    if (result != ERR_SUCCESS) {
+        g_softnet.complete = 0;
+        return result;
+    }
+
+    matrix_begin(&g_softnet, NULL, SOFTNET_COLS, now_ns);
+
+    ProcfsScanner scanner, line;
+    procfs_scan_file(&scanner, &g_proc_softnet);
+    for (int index = 0; procfs_next_line(&scanner, &line); index++) {
+        uint64_t v[SOFTNET_MAX_COLUMNS];
+        int n = 0;
+        while (n < SOFTNET_MAX_COLUMNS && next_hex(&line, &v[n])) {
+            n++;
+        }
+        if (n < SOFTNET_COLS) {
+            continue;
+        }
+
+        // Offline CPUs have no row; older kernels do not say which CPU a row is
+        char label[IRQSTAT_LABEL_LEN];
+        int len = snprintf(label, sizeof(label), "%d", n > SOFTNET_CPU_COLUMN ? (int)v[SOFTNET_CPU_COLUMN] : index);
+
+        uint32_t *row = matrix_add_row(&g_softnet, label, len);
+        if (row == NULL) {
+            g_softnet.complete = 0;
+            return ERR_MEMORY_ALLOC;
+        }
+        row[SOFTNET_PROCESSED] = (uint32_t)v[0];
+        row[SOFTNET_DROPPED] = (uint32_t)v[1];
+        row[SOFTNET_TIME_SQUEEZE] = (uint32_t)v[2];
+    }
+
+    matrix_finish(&g_softnet);
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Find a row by label
+ * @param m Matrix
+ * @param label Label to look for
+ * @return Row index, -1 if absent
+ */
+static int find_row(const CounterMatrix *m, const char *label) {
+    for (int r = 0; r < m->rows; r++) {
+        if (strcmp(m->labels[r].text, label) == 0) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Fill the per-CPU entries from the softirq and softnet matrices
+ * @param interrupts Interrupt section
+ */
+static void fill_cpus(restrack_interrupts_t *interrupts) {
+    // The CPU columns come from /proc/softirqs, or /proc/interrupts without it
+    const CounterMatrix *columns = interrupts->has_softirqs ? &g_softirqs : &g_interrupts;
+    if (!interrupts->has_softirqs && !interrupts->has_interrupts) {
+        return;
+    }
+
+    interrupts->num_cpus = columns->cols;
+    for (int c = 0; c < columns->cols; c++) {
+        memset(&interrupts->cpus[c], 0, sizeof(interrupts->cpus[c]));
+        interrupts->cpus[c].cpu = columns->col_ids[c];
+    }
+    if (!interrupts->has_rates) {
+        return;
+    }
+
+    if (interrupts->has_softirqs) {
+        double elapsed_sec = g_softirqs.elapsed_ns / 1e9;
+        int net_rx = find_row(&g_softirqs, "NET_RX");
+        int net_tx = find_row(&g_softirqs, "NET_TX");
+        for (int c = 0; c < g_softirqs.cols; c++) {
+            if (net_rx >= 0) {
+                interrupts->cpus[c].net_rx_per_sec = g_softirqs.delta[(size_t)net_rx * g_softirqs.cols + c] / elapsed_sec;
+            }
+            if (net_tx >= 0) {
+                interrupts->cpus[c].net_tx_per_sec = g_softirqs.delta[(size_t)net_tx * g_softirqs.cols + c] / elapsed_sec;
+            }
+        }
+    }
+
+    if (interrupts->has_softnet) {
+        double elapsed_sec = g_softnet.elapsed_ns / 1e9;
+        for (int r = 0; r < g_softnet.rows; r++) {
+            int cpu = atoi(g_softnet.labels[r].text);
+            for (int c = 0; c < interrupts->num_cpus; c++) {
+                restrack_irq_cpu_t *entry = &interrupts->cpus[c];
+                if (entry->cpu != cpu) {
+                    continue;
+                }
+                const uint32_t *delta = g_softnet.delta + (size_t)r * SOFTNET_COLS;
+                entry->has_softnet = 1;
+                entry->processed_per_sec = delta[SOFTNET_PROCESSED] / elapsed_sec;
+                entry->dropped_per_sec = delta[SOFTNET_DROPPED] / elapsed_sec;
+                entry->time_squeeze_per_sec = delta[SOFTNET_TIME_SQUEEZE] / elapsed_sec;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rank the interrupt lines by rate
+ * @param top_n Number of lines to keep
+ * @param interrupts Interrupt section
+ */
+static void fill_top_irqs(int top_n, restrack_interrupts_t *interrupts) {
+    const CounterMatrix *m = &g_interrupts;
+    double elapsed_sec = m->elapsed_ns / 1e9;
+    uint64_t all = 0;
+    int count = 0;
+
+    if (top_n > RESTRACK_MAX_TOP) {
+        top_n = RESTRACK_MAX_TOP;
+    }
+
+    for (int r = 0; r < m->rows; r++) {
+        const uint32_t *delta = m->delta + (size_t)r * m->cols;
+        uint64_t sum = row_sum(delta, m->cols);
+        all += sum;
+        if (sum == 0 || top_n <= 0) {
+            continue;
+        }
+
+        double per_sec = sum / elapsed_sec;
+        if (count == top_n && per_sec <= interrupts->top_irqs[count - 1].per_sec) {
+            continue;
+        }
+
+        // Insert into the sorted list, pushing out the slowest line when full
+        int pos = count < top_n ? count++ : count - 1;
+        while (pos > 0 && interrupts->top_irqs[pos - 1].per_sec < per_sec) {
+            interrupts->top_irqs[pos] = interrupts->top_irqs[pos - 1];
+            pos--;
+        }
+
+        int top_col = 0;
+        for (int c = 1; c < m->cols; c++) {
+            if (delta[c] > delta[top_col]) {
+                top_col = c;
+            }
+        }
+
+        restrack_irq_t *irq = &interrupts->top_irqs[pos];
+        memcpy(irq->irq, m->labels[r].text, sizeof(irq->irq));
+        procfs_copy_token(irq->desc, sizeof(irq->desc), g_irq_desc[r].text, g_irq_desc[r].len);
+        irq->per_sec = per_sec;
+        irq->top_cpu = m->cols > 0 ? m->col_ids[top_col] : -1;
+        irq->top_cpu_percent = m->cols > 0 ? 100.0 * delta[top_col] / sum : 0.0;
+    }
+
+    interrupts->num_top_irqs = count;
+    interrupts->irqs_per_sec = all / elapsed_sec;
+}
+
+/**
+ * @brief Read /proc/softirqs, /proc/interrupts and /proc/net/softnet_stat
+ * @param top_n Number of interrupt lines to rank by rate, 0 to skip
+ * @param interrupts Interrupt section to fill
+ * @return ERR_SUCCESS if at least one of the files was read, error code otherwise
+ */
+int irqstat_collect(int top_n, restrack_interrupts_t *interrupts) {
+    if (interrupts == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    uint64_t now_ns = monotonic_ns();
+    int softirq_dropped = 0, irq_dropped = 0;
+
+    interrupts->has_softirqs = read_cpu_table(&g_proc_softirqs, &g_softirqs, now_ns, 0, &softirq_dropped) == ERR_SUCCESS;
+    interrupts->has_interrupts = read_cpu_table(&g_proc_interrupts, &g_interrupts, now_ns, 1, &irq_dropped) == ERR_SUCCESS;
+    interrupts->has_softnet = read_softnet(now_ns) == ERR_SUCCESS;
+
+    if (!interrupts->has_softirqs && !interrupts->has_interrupts && !interrupts->has_softnet) {
+        return ERR_FILE_READ;
+    }
+
+    interrupts->has_rates = (!interrupts->has_softirqs || g_softirqs.has_delta) &&
+                            (!interrupts->has_interrupts || g_interrupts.has_delta) &&
+                            (!interrupts->has_softnet || g_softnet.has_delta);
+    interrupts->interval_ms = 0.0;
+    interrupts->num_softirqs = 0;
+    interrupts->num_cpus = 0;
+    interrupts->dropped = interrupts->has_softirqs ? softirq_dropped : irq_dropped;
+    interrupts->num_irqs = interrupts->has_interrupts ? g_interrupts.rows : 0;
+    interrupts->irqs_per_sec = 0.0;
+    interrupts->num_top_irqs = 0;
+
+    if (interrupts->has_rates) {
+        const CounterMatrix *any = interrupts->has_softirqs ? &g_softirqs :
+                                   interrupts->has_interrupts ? &g_interrupts : &g_softnet;
+        interrupts->interval_ms = any->elapsed_ns / 1e6;
+    }
+
+    for (int r = 0; interrupts->has_softirqs && r < g_softirqs.rows && r < RESTRACK_MAX_SOFTIRQS; r++) {
+        restrack_softirq_t *softirq = &interrupts->softirqs[interrupts->num_softirqs++];
+        memcpy(softirq->name, g_softirqs.labels[r].text, sizeof(softirq->name));
+        softirq->total = row_sum(g_softirqs.cur + (size_t)r * g_softirqs.cols, g_softirqs.cols);
+        softirq->per_sec = interrupts->has_rates ?
+            row_sum(g_softirqs.delta + (size_t)r * g_softirqs.cols, g_softirqs.cols) / (g_softirqs.elapsed_ns / 1e9) : 0.0;
+    }
+
+    fill_cpus(interrupts);
+    if (interrupts->has_rates && interrupts->has_interrupts) {
+        fill_top_irqs(top_n, interrupts);
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Release the buffers of a matrix
+ * @param m Matrix
+ */
+static void matrix_free(CounterMatrix *m) {
+    free(m->cur);
+    free(m->prev);
+    free(m->delta);
+    free(m->labels);
+    free(m->prev_labels);
+    memset(m, 0, sizeof(*m));
+}
+
+/**
+ * @brief Close the files and release the counter matrices
+ */
+void irqstat_cleanup(void) {
+    procfs_close(&g_proc_softirqs);
+    procfs_close(&g_proc_interrupts);
+    procfs_close(&g_proc_softnet);
+    matrix_free(&g_softirqs);
+    matrix_free(&g_interrupts);
+    matrix_free(&g_softnet);
+    free(g_irq_desc);
+    g_irq_desc = NULL;
+    g_irq_desc_cap = 0;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file irqstat.h
+ * @brief Softirq, interrupt and packet backlog rates from per-CPU counter matrices
+ */
+
+#ifndef IRQSTAT_H
+#define IRQSTAT_H
+
+#include "resources.h"
+
+/**
+ * @brief Read /proc/softirqs, /proc/interrupts and /proc/net/softnet_stat
+ * @param top_n Number of interrupt lines to rank by rate, 0 to skip
+ * @param interrupts Interrupt section to fill
+ * @return ERR_SUCCESS if at least one of the files was read, error code otherwise
+ *
+ * Each file is kept as a matrix of 32-bit counters with one row per line
+ * and one column per CPU, next to the matrix of the previous call. Rows
+ * are matched by label, so lines that come and go (an IRQ registered by a
+ * driver, a CPU going offline in softnet_stat) do not shift the others.
+ * Rates need two readings under the same set of online CPUs.
+ */
+int irqstat_collect(int top_n, restrack_interrupts_t *interrupts);
+
+/**
+ * @brief Close the files and release the counter matrices
+ */
+void irqstat_cleanup(void);
+
+#endif /* IRQSTAT_H */
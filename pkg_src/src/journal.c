@@ -0,0 +1,376 @@
+/**
+ * @file journal.c
+ * @brief Append-only record journal for system monitoring history
+ */
+
+#include "journal.h"
+#include "util.h"
+#include <sys/uio.h>
+
+/**
+ * @brief Read a byte range of a file into a buffer
+ * @param fd Descriptor to read from
+ * @param buffer Destination buffer
+ * @param len Number of bytes to read
+ * @param offset File offset to start from
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_range(int fd, char *buffer, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, buffer + done, len - done, offset + done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERR_FILE_READ;
+        }
+        if (n == 0) {
+            return ERR_FILE_READ;
+        }
+        done += n;
+    }
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Write a whole buffer to a descriptor
+ * @param fd Descriptor to write to
+ * @param buffer Data to write
+ * @param len Number of bytes to write
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int write_all(int fd, const char *buffer, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buffer, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERR_FILE_WRITE;
+        }
+        buffer += n;
+        len -= n;
+    }
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Rewrite the journal from the in-memory history ring
+ * @param journal Journal to compact
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * The ring is copied under the lock, then written out without it, so
+ * appends keep going while the new file is produced. Records appended in
+ * the meantime are carried over under the lock right before the new file
+ * replaces the old one.
+ */
+static int compact_journal(SysmonJournal *journal) {
+    pthread_mutex_lock(&journal->lock);
+    size_t total = 0;
+    for (size_t i = 0; i < journal->history.count; i++) {
+        total += history_get(&journal->history, i)->len + 1;
+    }
+
+    char *data = (char*)malloc(total ? total : 1);
+    if (data == NULL) {
+        pthread_mutex_unlock(&journal->lock);
+        return ERR_MEMORY_ALLOC;
+    }
+
+    char *p = data;
+    for (size_t i = 0; i < journal->history.count; i++) {
+        const HistoryRecord *record = history_get(&journal->history, i);
+        memcpy(p, record->data, record->len);
+        p += record->len;
+        *p++ = '\n';
+    }
+    size_t kept = journal->history.count;
+    size_t end = journal->bytes;
+    size_t records_seen = journal->records;
+    pthread_mutex_unlock(&journal->lock);
+
+    char tmp_path[sizeof(journal->path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal->path);
+    int dst = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0) {
+        log_message(LOG_ERROR, "Failed to create %s: %s", tmp_path, strerror(errno));
+        free(data);
+        return ERR_FILE_OPEN;
+    }
+
+    int result = write_all(dst, data, total);
+    free(data);
+
+    pthread_mutex_lock(&journal->lock);
+
+    // Carry over whatever was appended while the ring was being written
+    size_t extra = journal->bytes - end;
+    if (result == ERR_SUCCESS && extra > 0) {
+        int src = open(journal->path, O_RDONLY);
+        char chunk[4096];
+        size_t copied = 0;
+        if (src < 0) {
+            result = ERR_FILE_OPEN;
+        }
+        while (result == ERR_SUCCESS && copied < extra) {
+            size_t n = extra - copied < sizeof(chunk) ? extra - copied : sizeof(chunk);
+            result = read_range(src, chunk, n, end + copied);
+            if (result == ERR_SUCCESS) {
+                result = write_all(dst, chunk, n);
+            }
+            copied += n;
+        }
+        if (src >= 0) {
+            close(src);
+        }
+    }
+
+    if (result == ERR_SUCCESS && fsync(dst) != 0) {
+        result = ERR_FILE_WRITE;
+    }
+    close(dst);
+
+    int new_fd = -1;
+    if (result == ERR_SUCCESS && rename(tmp_path, journal->path) == 0) {
+        new_fd = open(journal->path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    }
+
+    if (new_fd < 0) {
+        log_message(LOG_ERROR, "Failed to compact journal %s", journal->path);
+        unlink(tmp_path);
+        pthread_mutex_unlock(&journal->lock);
+        return result == ERR_SUCCESS ? ERR_FILE_WRITE : result;
+    }
+
+    close(journal->fd);
+    journal->fd = new_fd;
+    journal->damaged = 0;
+    journal->records = kept + (journal->records - records_seen);
+    journal->bytes = total + extra;
+    pthread_mutex_unlock(&journal->lock);
+
+    log_message(LOG_DEBUG, "Compacted journal %s to %zu records", journal->path, journal->records);
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Compaction thread body
+ * @param arg Journal to compact
+ * @return Always NULL
+ */
+static void* compactor_func(void *arg) {
+    SysmonJournal *journal = (SysmonJournal*)arg;
+
+    pthread_mutex_lock(&journal->lock);
+    while (!journal->stop) {
+        if (!journal->compact_requested) {
+            pthread_cond_wait(&journal->cond, &journal->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&journal->lock);
+
+        compact_journal(journal);
+
+        pthread_mutex_lock(&journal->lock);
+        journal->compact_requested = 0;
+    }
+    pthread_mutex_unlock(&journal->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Load the records left over from a previous run into the ring
+ * @param journal Journal whose file was just opened
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int load_journal(SysmonJournal *journal) {
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) {
+        return ERR_FILE_READ;
+    }
+    if (st.st_size == 0) {
+        return ERR_SUCCESS;
+    }
+
+    char *data = (char*)malloc(st.st_size);
+    if (data == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+    if (read_range(journal->fd, data, st.st_size, 0) != ERR_SUCCESS) {
+        free(data);
+        return ERR_FILE_READ;
+    }
+
+    char *line = data;
+    char *end = data + st.st_size;
+    char *nl;
+    while (line < end && (nl = memchr(line, '\n', end - line)) != NULL) {
+        size_t len = nl - line;
+        char *record = (char*)malloc(len + 1);
+        if (record != NULL) {
+            memcpy(record, line, len);
+            record[len] = '\0';
+            history_push(&journal->history, record, len);
+        }
+        journal->records++;
+        line = nl + 1;
+    }
+
+    // Drop a record cut short by a crash so the next append starts a new line
+    journal->bytes = line - data;
+    if (journal->bytes < (size_t)st.st_size && ftruncate(journal->fd, journal->bytes) != 0) {
+        log_message(LOG_WARNING, "Failed to trim partial record from %s", journal->path);
+        journal->bytes = st.st_size;
+    }
+
+    free(data);
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Open (or create) a journal and start its compaction thread
+ * @param journal Journal to initialise
+ * @param path Path to the journal file
+ * @param capacity Number of newest records kept in memory and by compaction
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int journal_open(SysmonJournal *journal, const char *path, size_t capacity) {
+    if (journal == NULL || path == NULL || capacity == 0) {
+        return ERR_INVALID_PARAM;
+    }
+
+    memset(journal, 0, sizeof(*journal));
+    strncpy(journal->path, path, sizeof(journal->path) - 1);
+    journal->fd = -1;
+
+    int result = history_init(&journal->history, capacity);
+    if (result != ERR_SUCCESS) {
+        log_message(LOG_ERROR, "Failed to allocate history for %zu samples", capacity);
+        return result;
+    }
+
+    journal->fd = open(journal->path, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (journal->fd < 0) {
+        log_message(LOG_ERROR, "Failed to open journal %s: %s", journal->path, strerror(errno));
+        history_free(&journal->history);
+        return ERR_FILE_OPEN;
+    }
+
+    // The only time the file is read back
+    if (load_journal(journal) != ERR_SUCCESS) {
+        log_message(LOG_WARNING, "Failed to load history from %s", journal->path);
+    }
+
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->cond, NULL);
+    journal->compact_requested = journal->records >= 2 * capacity;
+
+    if (pthread_create(&journal->compactor, NULL, compactor_func, journal) == 0) {
+        journal->thread_started = 1;
+    } else {
+        log_message(LOG_WARNING, "Failed to start journal compaction thread, history will not be trimmed");
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Append one record to the journal and its history ring
+ * @param journal Open journal
+ * @param record Heap-allocated record without trailing newline; ownership
+ *               moves to the history ring even when the write fails
+ * @param len Length of the record in bytes
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * A record cut short by a failed write is truncated away. If that fails
+ * too, records only go to the ring until compaction has rewritten the file.
+ */
+int journal_append(SysmonJournal *journal, char *record, size_t len) {
+    if (journal == NULL || record == NULL) {
+        free(record);
+        return ERR_INVALID_PARAM;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = record;
+    iov[0].iov_len = len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->fd < 0) {
+        pthread_mutex_unlock(&journal->lock);
+        free(record);
+        return ERR_FILE_OPEN;
+    }
+
+    // A partial record is still at the end of the file; the ring holds this
+    // record and compaction writes it out with the rest
+    if (journal->damaged) {
+        history_push(&journal->history, record, len);
+        if (!journal->compact_requested) {
+            journal->compact_requested = 1;
+            pthread_cond_signal(&journal->cond);
+        }
+        pthread_mutex_unlock(&journal->lock);
+        return ERR_SUCCESS;
+    }
+
+    ssize_t written;
+    do {
+        written = writev(journal->fd, iov, 2);
+    } while (written < 0 && errno == EINTR);
+
+    history_push(&journal->history, record, len);
+
+    if (written != (ssize_t)(len + 1)) {
+        log_message(LOG_ERROR, "Failed to append to journal %s: %s", journal->path,
+                    written < 0 ? strerror(errno) : "short write");
+        // Cut the partial record off so the next append starts a new line
+        if (written > 0 && ftruncate(journal->fd, journal->bytes) != 0) {
+            log_message(LOG_WARNING, "Failed to trim partial record from %s, rewriting it", journal->path);
+            journal->damaged = 1;
+            journal->compact_requested = 1;
+            pthread_cond_signal(&journal->cond);
+        }
+        pthread_mutex_unlock(&journal->lock);
+        return ERR_FILE_WRITE;
+    }
+
+    journal->records++;
+    journal->bytes += written;
+    if (journal->records >= 2 * journal->history.capacity && !journal->compact_requested) {
+        journal->compact_requested = 1;
+        pthread_cond_signal(&journal->cond);
+    }
+    pthread_mutex_unlock(&journal->lock);
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Stop the compaction thread and close the journal
+ * @param journal Journal to close
+ */
+void journal_close(SysmonJournal *journal) {
+    if (journal == NULL || journal->fd < 0) {
+        return;
+    }
+
+    if (journal->thread_started) {
+        pthread_mutex_lock(&journal->lock);
+        journal->stop = 1;
+        pthread_cond_signal(&journal->cond);
+        pthread_mutex_unlock(&journal->lock);
+        pthread_join(journal->compactor, NULL);
+        journal->thread_started = 0;
+    }
+
+    close(journal->fd);
+    journal->fd = -1;
+    history_free(&journal->history);
+    pthread_mutex_destroy(&journal->lock);
+    pthread_cond_destroy(&journal->cond);
+}
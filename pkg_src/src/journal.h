@@ -0,0 +1,64 @@
+/**
+ * @file journal.h
+ * @brief Append-only record journal for system monitoring history
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "sysmon.h"
+#include "history.h"
+#include <pthread.h>
+
+/**
+ * @struct SysmonJournal
+ * @brief Newline-delimited JSON journal with background compaction
+ *
+ * The journal is the persisted view of an in-memory history ring. Each
+ * record is appended as one line and pushed into the ring, so the per-tick
+ * cost does not depend on how much history is kept. Once the file holds
+ * twice the ring capacity, a background thread rewrites it from the ring;
+ * the file is only read once, when the journal is opened.
+ */
+typedef struct {
+    char path[272];              // Path to the journal file
+    int fd;                      // Append descriptor, -1 when closed
+    size_t records;              // Records currently in the file
+    size_t bytes;                // Current size of the file in bytes
+    SysmonHistory history;       // Newest records, source for compaction
+
+    pthread_t compactor;         // Background compaction thread
+    pthread_mutex_t lock;        // Protects fd, records, bytes and history
+    pthread_cond_t cond;         // Wakes the compaction thread
+    int compact_requested;       // Set when the file outgrew its limit
+    int damaged;                 // Set while a partial record ends the file
+    int stop;                    // Set to terminate the compaction thread
+    int thread_started;          // Whether the compaction thread runs
+} SysmonJournal;
+
+/**
+ * @brief Open (or create) a journal and start its compaction thread
+ * @param journal Journal to initialise
+ * @param path Path to the journal file
+ * @param capacity Number of newest records kept in memory and by compaction
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int journal_open(SysmonJournal *journal, const char *path, size_t capacity);
+
+/**
+ * @brief Append one record to the journal and its history ring
+ * @param journal Open journal
+ * @param record Heap-allocated record without trailing newline; ownership
+ *               moves to the history ring even when the write fails
+ * @param len Length of the record in bytes
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int journal_append(SysmonJournal *journal, char *record, size_t len);
+
+/**
+ * @brief Stop the compaction thread and close the journal
+ * @param journal Journal to close
+ */
+void journal_close(SysmonJournal *journal);
+
+#endif /* JOURNAL_H */
@@ -5,119 +5,1138 @@
 
 #include "json_handler.h"
 #include "util.h"
+#include "journal.h"
+#include <sys/socket.h>
+#include <linux/if.h>
+
+// History journal backing the output file, opened on first use
+static SysmonJournal g_journal;
+static int g_journal_ready = 0;
+static size_t g_history_size = DEFAULT_HISTORY_SIZE;
+
+/**
+ * @brief Make sure the journal that belongs to a data file is open
+ * @param file_path Path to the JSON data file
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int ensure_journal(const char *file_path) {
+    char path[sizeof(g_journal.path)];
+    snprintf(path, sizeof(path), "%s%s", file_path, HISTORY_JOURNAL_SUFFIX);
+
+    if (g_journal_ready) {
+        if (strcmp(g_journal.path, path) == 0 && g_journal.history.capacity == g_history_size) {
+            return ERR_SUCCESS;
+        }
+        journal_close(&g_journal);
+        g_journal_ready = 0;
+    }
+
+    int result = journal_open(&g_journal, path, g_history_size);
+    if (result == ERR_SUCCESS) {
+        g_journal_ready = 1;
+    }
+    return result;
+}
 
 /**
  * @brief Update a JSON file with new data
  * @param file_path Path to the JSON file
  * @param new_data JSON object with new data
  * @return ERR_SUCCESS on success, error code on failure
+ *
+ * The file only holds the latest sample and is replaced atomically. History
+ * lives in an in-memory ring persisted as one line per sample in
+ * "<file_path>.journal", so the cost of a tick does not grow with the
+ * amount of history kept and nothing is read back.
  */
 int update_json_file(const char *file_path, cJSON *new_data) {
     if (file_path == NULL || new_data == NULL) {
         return ERR_INVALID_PARAM;
     }
 
-    cJSON *root = NULL;
-    char *json_str = NULL;
-    int result = ERR_SUCCESS;
+    char *record = cJSON_PrintUnformatted(new_data);
+    if (record == NULL) {
+        log_message(LOG_ERROR, "Failed to convert JSON to string");
+        return ERR_JSON_CREATE;
+    }
+    size_t len = strlen(record);
+
+    // Keep the latest snapshot current even if the journal is unavailable
+    int snapshot_result = write_file_atomic(file_path, record, len);
 
-    // Try to read existing file
-    json_str = read_file(file_path);
-    if (json_str != NULL) {
-        root = cJSON_Parse(json_str);
-        free(json_str);
-        
-        if (root == NULL) {
-            log_message(LOG_WARNING, "Failed to parse existing JSON file %s, creating new one", file_path);
+    // The record moves into the history ring, no copy is made
+    int result = ensure_journal(file_path);
+    if (result == ERR_SUCCESS) {
+        result = journal_append(&g_journal, record, len);
+    } else {
+        free(record);
+    }
+
+    return result != ERR_SUCCESS ? result : snapshot_result;
+}
+
+/**
+ * @brief Serialize one CPU line of a sample
+ * @param stat CPU line
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* cpu_stat_to_json(const restrack_cpu_stat_t *stat) {
+    static const char *const state_names[RESTRACK_CPU_STATES] = {
+        "user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal"
+    };
+
+    cJSON *cpu_obj = cJSON_CreateObject();
+    if (cpu_obj == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(cpu_obj, "name", stat->name);
+    for (int i = 0; i < RESTRACK_CPU_STATES; i++) {
+        cJSON_AddNumberToObject(cpu_obj, state_names[i], stat->ticks[i]);
+    }
+    cJSON_AddNumberToObject(cpu_obj, "guest", stat->guest);
+    cJSON_AddNumberToObject(cpu_obj, "guest_nice", stat->guest_nice);
+    if (!stat->has_percent) {
+        return cpu_obj;
+    }
+    cJSON_AddNumberToObject(cpu_obj, "usage_percent", stat->usage_percent);
+
+    cJSON *percent = cJSON_AddObjectToObject(cpu_obj, "percent");
+    for (int i = 0; percent != NULL && i < RESTRACK_CPU_STATES; i++) {
+        cJSON_AddNumberToObject(percent, state_names[i], stat->percent[i]);
+    }
+
+    return cpu_obj;
+}
+
+/**
+ * @brief Serialize the CPU section of a sample
+ * @param cpu CPU section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* cpu_to_json(const restrack_cpu_t *cpu) {
+    cJSON *cpu_data = cJSON_CreateObject();
+    if (cpu_data == NULL) {
+        return NULL;
+    }
+
+    if (cpu->cpu_count > 0) {
+        cJSON_AddNumberToObject(cpu_data, "cpu_count", cpu->cpu_count);
+    }
+    cJSON_AddBoolToObject(cpu_data, "interval", cpu->interval);
+    if (cpu->has_counters) {
+        cJSON_AddNumberToObject(cpu_data, "ctxt", cpu->ctxt);
+        cJSON_AddNumberToObject(cpu_data, "intr", cpu->intr);
+        cJSON_AddNumberToObject(cpu_data, "boot_time", cpu->boot_time);
+    }
+    if (cpu->has_rates) {
+        cJSON_AddNumberToObject(cpu_data, "ctxt_per_sec", cpu->ctxt_per_sec);
+        cJSON_AddNumberToObject(cpu_data, "intr_per_sec", cpu->intr_per_sec);
+    }
+
+    cJSON *total = cpu_stat_to_json(&cpu->total);
+    if (total != NULL) {
+        cJSON_AddItemToObject(cpu_data, "total", total);
+    }
+
+    cJSON *cpus_array = cJSON_AddArrayToObject(cpu_data, "cpus");
+    for (int i = 0; cpus_array != NULL && i < cpu->num_cpus; i++) {
+        cJSON *cpu_obj = cpu_stat_to_json(&cpu->cpus[i]);
+        if (cpu_obj != NULL) {
+            cJSON_AddItemToArray(cpus_array, cpu_obj);
         }
     }
 
-    // If no existing data or failed to parse, create new object
-    if (root == NULL) {
-        root = cJSON_CreateObject();
-        if (root == NULL) {
-            log_message(LOG_ERROR, "Failed to create new JSON object");
-            return ERR_JSON_CREATE;
+    return cpu_data;
+}
+
+/**
+ * @brief Serialize a total/used/free section of a sample
+ * @param total_mb Total size in MB
+ * @param used_mb Used size in MB
+ * @param free_mb Free size in MB
+ * @param usage_percent Used share of the total
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* usage_to_json(uint64_t total_mb, uint64_t used_mb, uint64_t free_mb, double usage_percent) {
+    cJSON *usage = cJSON_CreateObject();
+    if (usage == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(usage, "total_mb", total_mb);
+    cJSON_AddNumberToObject(usage, "used_mb", used_mb);
+    cJSON_AddNumberToObject(usage, "free_mb", free_mb);
+    if (total_mb > 0) {
+        cJSON_AddNumberToObject(usage, "usage_percent", usage_percent);
+    }
+
+    return usage;
+}
+
+/**
+ * @brief Serialize the memory section of a sample
+ * @param memory Memory section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* memory_to_json(const restrack_memory_t *memory) {
+    cJSON *memory_data = usage_to_json(memory->total_mb, memory->used_mb, memory->free_mb, memory->usage_percent);
+    if (memory_data == NULL || !memory->has_meminfo) {
+        return memory_data;
+    }
+
+    cJSON_AddNumberToObject(memory_data, "available_mb", memory->available_mb);
+    if (memory->available_estimated) {
+        cJSON_AddBoolToObject(memory_data, "available_estimated", 1);
+    }
+    cJSON_AddNumberToObject(memory_data, "buffers_mb", memory->buffers_mb);
+    cJSON_AddNumberToObject(memory_data, "cached_mb", memory->cached_mb);
+    cJSON_AddNumberToObject(memory_data, "shmem_mb", memory->shmem_mb);
+    cJSON_AddNumberToObject(memory_data, "slab_mb", memory->slab_mb);
+    cJSON_AddNumberToObject(memory_data, "sreclaimable_mb", memory->sreclaimable_mb);
+
+    return memory_data;
+}
+
+/**
+ * @brief Serialize the system load section of a sample
+ * @param load Load section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* load_to_json(const restrack_load_t *load) {
+    cJSON *load_data = cJSON_CreateObject();
+    if (load_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(load_data, "load1", load->load1);
+    cJSON_AddNumberToObject(load_data, "load5", load->load5);
+    cJSON_AddNumberToObject(load_data, "load15", load->load15);
+    cJSON_AddNumberToObject(load_data, "running_processes", load->running_processes);
+
+    return load_data;
+}
+
+/**
+ * @brief Serialize the disk section of a sample
+ * @param disk Disk section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* disk_to_json(const restrack_disk_t *disk) {
+    cJSON *disk_data = cJSON_CreateObject();
+    if (disk_data == NULL) {
+        return NULL;
+    }
+
+    if (disk->has_io_stats) {
+        cJSON *io_stats = cJSON_AddArrayToObject(disk_data, "io_stats");
+        for (int i = 0; io_stats != NULL && i < disk->num_devices; i++) {
+            const restrack_disk_io_t *io = &disk->io_stats[i];
+            cJSON *dev = cJSON_CreateObject();
+            if (dev == NULL) {
+                continue;
+            }
+
+            cJSON_AddStringToObject(dev, "device", io->device);
+            cJSON_AddNumberToObject(dev, "major", io->major);
+            cJSON_AddNumberToObject(dev, "minor", io->minor);
+            if (io->sector_size > 0) {
+                cJSON_AddNumberToObject(dev, "sector_size", io->sector_size);
+            }
+            cJSON_AddNumberToObject(dev, "reads", io->reads);
+            cJSON_AddNumberToObject(dev, "writes", io->writes);
+            cJSON_AddNumberToObject(dev, "read_sectors", io->read_sectors);
+            cJSON_AddNumberToObject(dev, "written_sectors", io->written_sectors);
+            cJSON_AddNumberToObject(dev, "read_kb", io->read_kb);
+            cJSON_AddNumberToObject(dev, "written_kb", io->written_kb);
+            cJSON_AddNumberToObject(dev, "in_flight", io->in_flight);
+            if (io->has_rates) {
+                cJSON_AddNumberToObject(dev, "interval_ms", io->interval_ms);
+                cJSON_AddNumberToObject(dev, "read_iops", io->read_iops);
+                cJSON_AddNumberToObject(dev, "write_iops", io->write_iops);
+                cJSON_AddNumberToObject(dev, "read_kb_per_sec", io->read_kb_per_sec);
+                cJSON_AddNumberToObject(dev, "write_kb_per_sec", io->write_kb_per_sec);
+                cJSON_AddNumberToObject(dev, "util_percent", io->util_percent);
+                cJSON_AddNumberToObject(dev, "avg_queue_depth", io->avg_queue_depth);
+                cJSON_AddNumberToObject(dev, "await_ms", io->await_ms);
+                cJSON_AddNumberToObject(dev, "read_await_ms", io->read_await_ms);
+                cJSON_AddNumberToObject(dev, "write_await_ms", io->write_await_ms);
+            }
+            cJSON_AddItemToArray(io_stats, dev);
         }
-        
-        // Add current data to the root
-        if (merge_json_objects(root, new_data) != ERR_SUCCESS) {
-            log_message(LOG_ERROR, "Failed to merge data into new root object");
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
+    }
+
+    cJSON *filesystems = cJSON_AddArrayToObject(disk_data, "filesystems");
+    for (int i = 0; filesystems != NULL && i < disk->num_filesystems; i++) {
+        const restrack_filesystem_t *fs = &disk->filesystems[i];
+        cJSON *fs_obj = cJSON_CreateObject();
+        if (fs_obj == NULL) {
+            continue;
         }
-        
-        // Add history array
-        cJSON *history = cJSON_CreateArray();
-        if (history == NULL) {
-            log_message(LOG_ERROR, "Failed to create history array");
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
+
+        cJSON_AddStringToObject(fs_obj, "mount_point", fs->mount_point);
+        cJSON_AddStringToObject(fs_obj, "fstype", fs->fstype);
+        cJSON_AddStringToObject(fs_obj, "device", fs->device);
+        cJSON_AddBoolToObject(fs_obj, "readonly", fs->readonly);
+        cJSON_AddBoolToObject(fs_obj, "responding", fs->responding);
+        cJSON_AddNumberToObject(fs_obj, "total_mb", fs->total_mb);
+        cJSON_AddNumberToObject(fs_obj, "used_mb", fs->used_mb);
+        cJSON_AddNumberToObject(fs_obj, "free_mb", fs->free_mb);
+        cJSON_AddNumberToObject(fs_obj, "available_mb", fs->available_mb);
+        if (fs->total_mb > 0) {
+            cJSON_AddNumberToObject(fs_obj, "usage_percent", fs->usage_percent);
         }
-        
-        // Add current data as first history entry
-        cJSON *first_entry = cJSON_Duplicate(new_data, 1);
-        if (first_entry == NULL) {
-            log_message(LOG_ERROR, "Failed to duplicate data for history");
-            cJSON_Delete(history);
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
+        if (fs->inodes_total > 0) {
+            cJSON_AddNumberToObject(fs_obj, "inodes_total", fs->inodes_total);
+            cJSON_AddNumberToObject(fs_obj, "inodes_used", fs->inodes_used);
+            cJSON_AddNumberToObject(fs_obj, "inodes_free", fs->inodes_free);
+            cJSON_AddNumberToObject(fs_obj, "inode_usage_percent", fs->inode_usage_percent);
         }
-        
-        cJSON_AddItemToArray(history, first_entry);
-        cJSON_AddItemToObject(root, "history", history);
+        cJSON_AddItemToArray(filesystems, fs_obj);
+    }
+
+    return disk_data;
+}
+
+/**
+ * @brief Serialize one traffic direction of an interface
+ * @param dir Direction counters
+ * @param rate Direction rates, or NULL when there are none
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* iface_dir_to_json(const restrack_iface_dir_t *dir, const restrack_iface_rate_t *rate) {
+    cJSON *obj = cJSON_CreateObject();
+    if (obj == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(obj, "bytes", dir->bytes);
+    cJSON_AddNumberToObject(obj, "packets", dir->packets);
+    cJSON_AddNumberToObject(obj, "errors", dir->errors);
+    cJSON_AddNumberToObject(obj, "dropped", dir->dropped);
+    if (rate != NULL) {
+        cJSON_AddNumberToObject(obj, "bits_per_sec", rate->bits_per_sec);
+        cJSON_AddNumberToObject(obj, "packets_per_sec", rate->packets_per_sec);
+        cJSON_AddNumberToObject(obj, "errors_per_sec", rate->errors_per_sec);
+        cJSON_AddNumberToObject(obj, "dropped_per_sec", rate->dropped_per_sec);
+    }
+
+    return obj;
+}
+
+/**
+ * @brief Get the RFC 2863 name of an IF_OPER_* state
+ * @param operstate IF_OPER_* value
+ * @return State name
+ */
+static const char* operstate_name(unsigned char operstate) {
+    static const char *const names[] = {
+        "unknown", "notpresent", "down", "lowerlayerdown", "testing", "dormant", "up"
+    };
+    return operstate < sizeof(names) / sizeof(names[0]) ? names[operstate] : "unknown";
+}
+
+/**
+ * @brief Serialize the network section of a sample
+ * @param network Network section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* network_to_json(const restrack_network_t *network) {
+    cJSON *network_data = cJSON_CreateObject();
+    if (network_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(network_data, "source",
+                            network->source == RESTRACK_NET_SOURCE_NETLINK ? "netlink" : "procfs");
+    cJSON *interfaces = cJSON_AddArrayToObject(network_data, "interfaces");
+    for (int i = 0; interfaces != NULL && i < network->num_interfaces; i++) {
+        const restrack_iface_t *iface = &network->interfaces[i];
+        cJSON *iface_obj = cJSON_CreateObject();
+        if (iface_obj == NULL) {
+            continue;
+        }
+
+        cJSON_AddStringToObject(iface_obj, "interface", iface->name);
+        if (iface->has_link_info) {
+            cJSON_AddNumberToObject(iface_obj, "ifindex", iface->ifindex);
+            cJSON_AddStringToObject(iface_obj, "operstate", operstate_name(iface->operstate));
+            cJSON_AddBoolToObject(iface_obj, "up", (iface->flags & IFF_UP) != 0);
+            cJSON_AddNumberToObject(iface_obj, "mtu", iface->mtu);
+            cJSON_AddNumberToObject(iface_obj, "speed_mbps", iface->speed_mbps);
+        }
+        cJSON_AddNumberToObject(iface_obj, "multicast", iface->multicast);
+        cJSON_AddNumberToObject(iface_obj, "collisions", iface->collisions);
+        if (iface->has_rates) {
+            cJSON_AddNumberToObject(iface_obj, "interval_ms", iface->interval_ms);
+        }
+        cJSON *rx = iface_dir_to_json(&iface->rx, iface->has_rates ? &iface->rx_rate : NULL);
+        if (rx != NULL) {
+            cJSON_AddItemToObject(iface_obj, "receive", rx);
+        }
+        cJSON *tx = iface_dir_to_json(&iface->tx, iface->has_rates ? &iface->tx_rate : NULL);
+        if (tx != NULL) {
+            cJSON_AddItemToObject(iface_obj, "transmit", tx);
+        }
+        cJSON_AddItemToArray(interfaces, iface_obj);
+    }
+
+    return network_data;
+}
+
+/**
+ * @brief Serialize the uptime section of a sample
+ * @param uptime Uptime section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* uptime_to_json(const restrack_uptime_t *uptime) {
+    cJSON *uptime_data = cJSON_CreateObject();
+    if (uptime_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(uptime_data, "total_seconds", uptime->total_seconds);
+    cJSON_AddNumberToObject(uptime_data, "days", uptime->days);
+    cJSON_AddNumberToObject(uptime_data, "hours", uptime->hours);
+    cJSON_AddNumberToObject(uptime_data, "minutes", uptime->minutes);
+    cJSON_AddNumberToObject(uptime_data, "seconds", uptime->seconds);
+
+    // Format human-readable uptime
+    char uptime_str[64];
+    if (uptime->days > 0) {
+        snprintf(uptime_str, sizeof(uptime_str), "%u days %u hours %u minutes", uptime->days, uptime->hours, uptime->minutes);
+    } else if (uptime->hours > 0) {
+        snprintf(uptime_str, sizeof(uptime_str), "%u hours %u minutes", uptime->hours, uptime->minutes);
     } else {
-        // Update current data
-        if (merge_json_objects(root, new_data) != ERR_SUCCESS) {
-            log_message(LOG_ERROR, "Failed to merge data into existing root object");
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
+        snprintf(uptime_str, sizeof(uptime_str), "%u minutes %u seconds", uptime->minutes, uptime->seconds);
+    }
+    cJSON_AddStringToObject(uptime_data, "uptime", uptime_str);
+
+    return uptime_data;
+}
+
+/**
+ * @brief Add a serialized section to the sample object
+ * @param root Sample object
+ * @param key Key of the section
+ * @param section Serialized section, may be NULL
+ */
+static void add_section(cJSON *root, const char *key, cJSON *section) {
+    if (section != NULL) {
+        cJSON_AddItemToObject(root, key, section);
+    } else {
+        log_message(LOG_WARNING, "Failed to serialize %s", key);
+    }
+}
+
+/**
+ * @brief Serialize the usage of one process
+ * @param proc Process
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* proc_to_json(const restrack_proc_t *proc) {
+    cJSON *proc_obj = cJSON_CreateObject();
+    if (proc_obj == NULL) {
+        return NULL;
+    }
+
+    char state[2] = { proc->state, '\0' };
+    cJSON_AddNumberToObject(proc_obj, "pid", proc->pid);
+    cJSON_AddStringToObject(proc_obj, "name", proc->name);
+    cJSON_AddStringToObject(proc_obj, "state", state);
+    cJSON_AddNumberToObject(proc_obj, "threads", proc->threads);
+    cJSON_AddNumberToObject(proc_obj, "cpu_percent", proc->cpu_percent);
+    cJSON_AddNumberToObject(proc_obj, "rss_kb", proc->rss_kb);
+    if (proc->has_io) {
+        cJSON_AddNumberToObject(proc_obj, "read_bytes", proc->read_bytes);
+        cJSON_AddNumberToObject(proc_obj, "write_bytes", proc->write_bytes);
+        cJSON_AddNumberToObject(proc_obj, "read_bytes_per_sec", proc->read_bytes_per_sec);
+        cJSON_AddNumberToObject(proc_obj, "write_bytes_per_sec", proc->write_bytes_per_sec);
+    }
+
+    return proc_obj;
+}
+
+/**
+ * @brief Serialize a ranking of processes
+ * @param procs Processes, best first
+ * @param count Number of processes
+ * @return cJSON array or NULL on failure
+ */
+static cJSON* proc_list_to_json(const restrack_proc_t *procs, int count) {
+    cJSON *list = cJSON_CreateArray();
+    if (list == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        cJSON *proc_obj = proc_to_json(&procs[i]);
+        if (proc_obj != NULL) {
+            cJSON_AddItemToArray(list, proc_obj);
         }
-        
-        // Add to history
-        cJSON *history = cJSON_GetObjectItem(root, "history");
-        if (history == NULL || !cJSON_IsArray(history)) {
-            log_message(LOG_WARNING, "No valid history array found, creating new one");
-            
-            history = cJSON_CreateArray();
-            if (history == NULL) {
-                log_message(LOG_ERROR, "Failed to create history array");
-                cJSON_Delete(root);
-                return ERR_JSON_CREATE;
-            }
-            
-            cJSON_AddItemToObject(root, "history", history);
+    }
+
+    return list;
+}
+
+/**
+ * @brief Serialize the process section of a sample
+ * @param processes Process section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* processes_to_json(const restrack_process_t *processes) {
+    cJSON *process_data = cJSON_CreateObject();
+    if (process_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(process_data, "count", processes->count);
+    if (processes->has_stat) {
+        cJSON_AddNumberToObject(process_data, "running", processes->running);
+        cJSON_AddNumberToObject(process_data, "blocked", processes->blocked);
+        cJSON_AddNumberToObject(process_data, "forks", processes->forks);
+    }
+    if (processes->has_fork_rate) {
+        cJSON_AddNumberToObject(process_data, "forks_per_sec", processes->forks_per_sec);
+    }
+    if (processes->num_top_cpu > 0) {
+        add_section(process_data, "top_cpu", proc_list_to_json(processes->top_cpu, processes->num_top_cpu));
+    }
+    if (processes->num_top_memory > 0) {
+        add_section(process_data, "top_memory", proc_list_to_json(processes->top_memory, processes->num_top_memory));
+    }
+
+    return process_data;
+}
+
+/**
+ * @brief Serialize one line of a pressure file
+ * @param psi Line values
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* psi_line_to_json(const restrack_psi_line_t *psi) {
+    cJSON *obj = cJSON_CreateObject();
+    if (obj == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(obj, "avg10", psi->avg10);
+    cJSON_AddNumberToObject(obj, "avg60", psi->avg60);
+    cJSON_AddNumberToObject(obj, "avg300", psi->avg300);
+    cJSON_AddNumberToObject(obj, "total_us", psi->total_us);
+
+    return obj;
+}
+
+/**
+ * @brief Serialize the pressure section of a sample
+ * @param pressure Pressure section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* pressure_to_json(const restrack_pressure_t *pressure) {
+    static const char *const names[SYSMON_PSI_COUNT] = { "cpu", "memory", "io" };
+
+    cJSON *pressure_data = cJSON_CreateObject();
+    if (pressure_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddBoolToObject(pressure_data, "supported", pressure->supported);
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        const restrack_psi_t *psi = &pressure->resources[i];
+        if (!(pressure->available & (1u << i))) {
+            continue;
         }
-        
-        // Add new entry to history (limited to 100 entries)
-        if (cJSON_GetArraySize(history) >= 100) {
-            // Remove oldest entry
-            cJSON_DeleteItemFromArray(history, 0);
+
+        cJSON *resource = cJSON_AddObjectToObject(pressure_data, names[i]);
+        if (resource == NULL) {
+            continue;
         }
-        
-        cJSON *new_entry = cJSON_Duplicate(new_data, 1);
-        if (new_entry == NULL) {
-            log_message(LOG_ERROR, "Failed to duplicate data for history");
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
+        add_section(resource, "some", psi_line_to_json(&psi->some));
+        if (psi->has_full) {
+            add_section(resource, "full", psi_line_to_json(&psi->full));
         }
-        
-        cJSON_AddItemToArray(history, new_entry);
     }
 
-    // Convert to string and save
-    json_str = cJSON_Print(root);
-    if (json_str == NULL) {
-        log_message(LOG_ERROR, "Failed to convert JSON to string");
-        cJSON_Delete(root);
-        return ERR_JSON_CREATE;
+    cJSON *triggered = cJSON_AddArrayToObject(pressure_data, "triggered");
+    for (int i = 0; triggered != NULL && i < SYSMON_PSI_COUNT; i++) {
+        if (pressure->triggered & (1u << i)) {
+            cJSON_AddItemToArray(triggered, cJSON_CreateString(names[i]));
+        }
     }
-    
-    result = write_file(file_path, json_str);
-    free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
+
+    return pressure_data;
+}
+
+/**
+ * @brief Serialize the per-cgroup section
+ * @param cgroups Cgroup section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* cgroups_to_json(const restrack_cgroups_t *cgroups) {
+    cJSON *cgroups_data = cJSON_CreateObject();
+    if (cgroups_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddBoolToObject(cgroups_data, "supported", cgroups->supported);
+    cJSON_AddNumberToObject(cgroups_data, "dropped", cgroups->dropped);
+
+    cJSON *list = cJSON_AddArrayToObject(cgroups_data, "cgroups");
+    for (int i = 0; list != NULL && i < cgroups->num_cgroups; i++) {
+        const restrack_cgroup_t *cg = &cgroups->cgroups[i];
+        cJSON *obj = cJSON_CreateObject();
+        if (obj == NULL) {
+            continue;
+        }
+
+        cJSON_AddStringToObject(obj, "name", cg->name);
+        if (cg->has_rates) {
+            cJSON_AddNumberToObject(obj, "interval_ms", cg->interval_ms);
+        }
+
+        if (cg->has_cpu) {
+            cJSON *cpu = cJSON_AddObjectToObject(obj, "cpu");
+            if (cpu != NULL) {
+                cJSON_AddNumberToObject(cpu, "usage_usec", cg->usage_usec);
+                cJSON_AddNumberToObject(cpu, "user_usec", cg->user_usec);
+                cJSON_AddNumberToObject(cpu, "system_usec", cg->system_usec);
+                cJSON_AddNumberToObject(cpu, "nr_throttled", cg->nr_throttled);
+                cJSON_AddNumberToObject(cpu, "throttled_usec", cg->throttled_usec);
+                if (cg->has_rates) {
+                    cJSON_AddNumberToObject(cpu, "usage_percent", cg->cpu_percent);
+                    cJSON_AddNumberToObject(cpu, "user_percent", cg->user_percent);
+                    cJSON_AddNumberToObject(cpu, "system_percent", cg->system_percent);
+                    cJSON_AddNumberToObject(cpu, "throttled_percent", cg->throttled_percent);
+                }
+            }
+        }
+
+        if (cg->has_memory || cg->has_memory_events) {
+            cJSON *memory = cJSON_AddObjectToObject(obj, "memory");
+            if (memory != NULL && cg->has_memory) {
+                cJSON_AddNumberToObject(memory, "current_bytes", cg->memory_bytes);
+            }
+            cJSON *events = cg->has_memory_events && memory != NULL ? cJSON_AddObjectToObject(memory, "events") : NULL;
+            if (events != NULL) {
+                cJSON_AddNumberToObject(events, "high", cg->events_high);
+                cJSON_AddNumberToObject(events, "max", cg->events_max);
+                cJSON_AddNumberToObject(events, "oom", cg->events_oom);
+                cJSON_AddNumberToObject(events, "oom_kill", cg->events_oom_kill);
+                if (cg->has_rates) {
+                    cJSON_AddNumberToObject(events, "new_high", cg->new_high);
+                    cJSON_AddNumberToObject(events, "new_max", cg->new_max);
+                    cJSON_AddNumberToObject(events, "new_oom", cg->new_oom);
+                    cJSON_AddNumberToObject(events, "new_oom_kill", cg->new_oom_kill);
+                }
+            }
+        }
+
+        if (cg->has_io) {
+            cJSON *io = cJSON_AddObjectToObject(obj, "io");
+            if (io != NULL) {
+                cJSON_AddNumberToObject(io, "read_bytes", cg->read_bytes);
+                cJSON_AddNumberToObject(io, "write_bytes", cg->write_bytes);
+                cJSON_AddNumberToObject(io, "read_ios", cg->read_ios);
+                cJSON_AddNumberToObject(io, "write_ios", cg->write_ios);
+                if (cg->has_rates) {
+                    cJSON_AddNumberToObject(io, "read_bytes_per_sec", cg->read_bytes_per_sec);
+                    cJSON_AddNumberToObject(io, "write_bytes_per_sec", cg->write_bytes_per_sec);
+                    cJSON_AddNumberToObject(io, "read_iops", cg->read_iops);
+                    cJSON_AddNumberToObject(io, "write_iops", cg->write_iops);
+                }
+            }
+        }
+
+        cJSON_AddItemToArray(list, obj);
+    }
+
+    return cgroups_data;
+}
+
+/**
+ * @brief Serialize the softirq, interrupt and packet backlog section
+ * @param interrupts Interrupt section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* interrupts_to_json(const restrack_interrupts_t *interrupts) {
+    cJSON *irq_data = cJSON_CreateObject();
+    if (irq_data == NULL) {
+        return NULL;
+    }
+
+    if (interrupts->has_rates) {
+        cJSON_AddNumberToObject(irq_data, "interval_ms", interrupts->interval_ms);
+    }
+
+    if (interrupts->has_softirqs) {
+        cJSON *softirqs = cJSON_AddArrayToObject(irq_data, "softirqs");
+        for (int i = 0; softirqs != NULL && i < interrupts->num_softirqs; i++) {
+            const restrack_softirq_t *softirq = &interrupts->softirqs[i];
+            cJSON *obj = cJSON_CreateObject();
+            if (obj == NULL) {
+                continue;
+            }
+            cJSON_AddStringToObject(obj, "name", softirq->name);
+            cJSON_AddNumberToObject(obj, "total", softirq->total);
+            if (interrupts->has_rates) {
+                cJSON_AddNumberToObject(obj, "per_sec", softirq->per_sec);
+            }
+            cJSON_AddItemToArray(softirqs, obj);
+        }
+    }
+
+    if (interrupts->has_rates) {
+        cJSON *cpus = cJSON_AddArrayToObject(irq_data, "cpus");
+        for (int i = 0; cpus != NULL && i < interrupts->num_cpus; i++) {
+            const restrack_irq_cpu_t *cpu = &interrupts->cpus[i];
+            cJSON *obj = cJSON_CreateObject();
+            if (obj == NULL) {
+                continue;
+            }
+            cJSON_AddNumberToObject(obj, "cpu", cpu->cpu);
+            if (interrupts->has_softirqs) {
+                cJSON_AddNumberToObject(obj, "net_rx_per_sec", cpu->net_rx_per_sec);
+                cJSON_AddNumberToObject(obj, "net_tx_per_sec", cpu->net_tx_per_sec);
+            }
+            if (cpu->has_softnet) {
+                cJSON_AddNumberToObject(obj, "processed_per_sec", cpu->processed_per_sec);
+                cJSON_AddNumberToObject(obj, "dropped_per_sec", cpu->dropped_per_sec);
+                cJSON_AddNumberToObject(obj, "time_squeeze_per_sec", cpu->time_squeeze_per_sec);
+            }
+            cJSON_AddItemToArray(cpus, obj);
+        }
+    }
+
+    if (interrupts->has_interrupts) {
+        cJSON_AddNumberToObject(irq_data, "num_irqs", interrupts->num_irqs);
+    }
+    if (interrupts->has_rates && interrupts->has_interrupts) {
+        cJSON_AddNumberToObject(irq_data, "irqs_per_sec", interrupts->irqs_per_sec);
+
+        cJSON *top = cJSON_AddArrayToObject(irq_data, "top_irqs");
+        for (int i = 0; top != NULL && i < interrupts->num_top_irqs; i++) {
+            const restrack_irq_t *irq = &interrupts->top_irqs[i];
+            cJSON *obj = cJSON_CreateObject();
+            if (obj == NULL) {
+                continue;
+            }
+            cJSON_AddStringToObject(obj, "irq", irq->irq);
+            cJSON_AddStringToObject(obj, "desc", irq->desc);
+            cJSON_AddNumberToObject(obj, "per_sec", irq->per_sec);
+            cJSON_AddNumberToObject(obj, "top_cpu", irq->top_cpu);
+            cJSON_AddNumberToObject(obj, "top_cpu_percent", irq->top_cpu_percent);
+            cJSON_AddItemToArray(top, obj);
+        }
+    }
+
+    return irq_data;
+}
+
+// TCP state names, indexed by the kernel's state numbers
+static const char *const g_tcp_state_names[RESTRACK_TCP_STATES] = {
+    NULL, "established", "syn_sent", "syn_recv", "fin_wait1", "fin_wait2",
+    "time_wait", "close", "close_wait", "last_ack", "listen", "closing"
+};
+
+/**
+ * @brief Serialize the conntrack and TCP socket table section
+ * @param connections Connection section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* connections_to_json(const restrack_connections_t *connections) {
+    cJSON *conn_data = cJSON_CreateObject();
+    if (conn_data == NULL) {
+        return NULL;
+    }
+
+    if (connections->has_rates) {
+        cJSON_AddNumberToObject(conn_data, "interval_ms", connections->interval_ms);
+    }
+
+    if (connections->has_conntrack) {
+        cJSON *conntrack = cJSON_AddObjectToObject(conn_data, "conntrack");
+        if (conntrack != NULL) {
+            cJSON_AddNumberToObject(conntrack, "count", connections->conntrack_count);
+            cJSON_AddNumberToObject(conntrack, "max", connections->conntrack_max);
+            cJSON_AddNumberToObject(conntrack, "usage_percent", connections->conntrack_usage_percent);
+            if (connections->has_rates) {
+                cJSON_AddNumberToObject(conntrack, "growth_per_sec", connections->conntrack_growth_per_sec);
+            }
+        }
+    }
+
+    if (connections->has_tcp) {
+        cJSON *tcp = cJSON_AddObjectToObject(conn_data, "tcp");
+        if (tcp != NULL) {
+            cJSON_AddStringToObject(tcp, "source",
+                connections->tcp_source == RESTRACK_TCP_SOURCE_SOCK_DIAG ? "sock_diag" : "sockstat");
+            cJSON_AddNumberToObject(tcp, "total", connections->tcp_total);
+            if (connections->has_tcp_states) {
+                cJSON *states = cJSON_AddObjectToObject(tcp, "states");
+                for (int i = 1; states != NULL && i < RESTRACK_TCP_STATES; i++) {
+                    cJSON_AddNumberToObject(states, g_tcp_state_names[i], connections->tcp_states[i]);
+                }
+            }
+            cJSON_AddNumberToObject(tcp, "time_wait", connections->tcp_time_wait);
+            if (connections->tcp_max_tw_buckets > 0) {
+                cJSON_AddNumberToObject(tcp, "max_tw_buckets", connections->tcp_max_tw_buckets);
+                cJSON_AddNumberToObject(tcp, "time_wait_usage_percent", connections->time_wait_usage_percent);
+            }
+            if (connections->has_rates) {
+                cJSON_AddNumberToObject(tcp, "growth_per_sec", connections->tcp_growth_per_sec);
+                if (connections->has_tcp_states) {
+                    cJSON_AddNumberToObject(tcp, "established_growth_per_sec",
+                                            connections->established_growth_per_sec);
+                }
+            }
+        }
+    }
+
+    return conn_data;
+}
+
+/**
+ * @brief Serialize the IP, TCP and UDP counter section
+ * @param protocols Protocol section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* protocols_to_json(const restrack_protocols_t *protocols) {
+    cJSON *proto_data = cJSON_CreateObject();
+    if (proto_data == NULL) {
+        return NULL;
+    }
+
+    if (protocols->has_rates) {
+        cJSON_AddNumberToObject(proto_data, "interval_ms", protocols->interval_ms);
+    }
+
+    cJSON *tcp = cJSON_AddObjectToObject(proto_data, "tcp");
+    if (tcp != NULL) {
+        if (protocols->has_snmp) {
+            cJSON_AddNumberToObject(tcp, "retrans_segs", protocols->tcp_retrans_segs);
+        }
+        if (protocols->has_netstat) {
+            cJSON_AddNumberToObject(tcp, "listen_overflows", protocols->tcp_listen_overflows);
+            cJSON_AddNumberToObject(tcp, "listen_drops", protocols->tcp_listen_drops);
+        }
+        if (protocols->has_rates && protocols->has_snmp) {
+            cJSON_AddNumberToObject(tcp, "out_segs_per_sec", protocols->tcp_out_segs_per_sec);
+            cJSON_AddNumberToObject(tcp, "retrans_segs_per_sec", protocols->tcp_retrans_segs_per_sec);
+            cJSON_AddNumberToObject(tcp, "retrans_percent", protocols->tcp_retrans_percent);
+            cJSON_AddNumberToObject(tcp, "in_errs_per_sec", protocols->tcp_in_errs_per_sec);
+        }
+        if (protocols->has_rates && protocols->has_netstat) {
+            cJSON_AddNumberToObject(tcp, "listen_overflows_per_sec", protocols->tcp_listen_overflows_per_sec);
+            cJSON_AddNumberToObject(tcp, "listen_drops_per_sec", protocols->tcp_listen_drops_per_sec);
+        }
+    }
+
+    if (protocols->has_snmp) {
+        cJSON *udp = cJSON_AddObjectToObject(proto_data, "udp");
+        if (udp != NULL) {
+            cJSON_AddNumberToObject(udp, "rcvbuf_errors", protocols->udp_rcvbuf_errors);
+            if (protocols->has_rates) {
+                cJSON_AddNumberToObject(udp, "in_datagrams_per_sec", protocols->udp_in_datagrams_per_sec);
+                cJSON_AddNumberToObject(udp, "in_errors_per_sec", protocols->udp_in_errors_per_sec);
+                cJSON_AddNumberToObject(udp, "rcvbuf_errors_per_sec", protocols->udp_rcvbuf_errors_per_sec);
+            }
+        }
+
+        cJSON *ip = cJSON_AddObjectToObject(proto_data, "ip");
+        if (ip != NULL) {
+            cJSON_AddNumberToObject(ip, "reasm_fails", protocols->ip_reasm_fails);
+            if (protocols->has_rates) {
+                cJSON_AddNumberToObject(ip, "reasm_reqds_per_sec", protocols->ip_reasm_reqds_per_sec);
+                cJSON_AddNumberToObject(ip, "reasm_fails_per_sec", protocols->ip_reasm_fails_per_sec);
+            }
+        }
+    }
+
+    return proto_data;
+}
+
+/**
+ * @brief Serialize the thermal and CPU frequency section
+ * @param thermal Thermal section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* thermal_to_json(const restrack_thermal_t *thermal) {
+    cJSON *thermal_data = cJSON_CreateObject();
+    if (thermal_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddBoolToObject(thermal_data, "supported", thermal->supported);
+    if (thermal->has_max_temp) {
+        cJSON_AddNumberToObject(thermal_data, "max_temp_c", thermal->max_temp_c);
+    }
+    cJSON_AddBoolToObject(thermal_data, "throttled", thermal->throttled);
+
+    cJSON *zones = cJSON_AddArrayToObject(thermal_data, "zones");
+    for (int i = 0; zones != NULL && i < thermal->num_zones; i++) {
+        const restrack_thermal_zone_t *zone = &thermal->zones[i];
+        cJSON *obj = cJSON_CreateObject();
+        if (obj == NULL) {
+            continue;
+        }
+        cJSON_AddStringToObject(obj, "name", zone->name);
+        cJSON_AddNumberToObject(obj, "zone", zone->zone);
+        cJSON_AddNumberToObject(obj, "temp_c", zone->temp_c);
+        cJSON_AddItemToArray(zones, obj);
+    }
+
+    cJSON *cooling = cJSON_AddArrayToObject(thermal_data, "cooling_devices");
+    for (int i = 0; cooling != NULL && i < thermal->num_cooling; i++) {
+        const restrack_cooling_device_t *device = &thermal->cooling[i];
+        cJSON *obj = cJSON_CreateObject();
+        if (obj == NULL) {
+            continue;
+        }
+        cJSON_AddStringToObject(obj, "name", device->name);
+        cJSON_AddNumberToObject(obj, "device", device->device);
+        cJSON_AddNumberToObject(obj, "cur_state", device->cur_state);
+        cJSON_AddNumberToObject(obj, "max_state", device->max_state);
+        cJSON_AddItemToArray(cooling, obj);
+    }
+
+    cJSON *cpus = cJSON_AddArrayToObject(thermal_data, "cpus");
+    for (int i = 0; cpus != NULL && i < thermal->num_cpus; i++) {
+        const restrack_cpu_freq_t *freq = &thermal->cpus[i];
+        cJSON *obj = cJSON_CreateObject();
+        if (obj == NULL) {
+            continue;
+        }
+        cJSON_AddNumberToObject(obj, "cpu", freq->cpu);
+        cJSON_AddNumberToObject(obj, "cur_mhz", freq->cur_khz / 1000.0);
+        if (freq->max_khz > 0) {
+            cJSON_AddNumberToObject(obj, "max_mhz", freq->max_khz / 1000.0);
+            cJSON_AddNumberToObject(obj, "freq_percent", freq->freq_percent);
+        }
+        if (freq->has_usage) {
+            cJSON_AddNumberToObject(obj, "scaled_usage_percent", freq->scaled_usage_percent);
+        }
+        cJSON_AddItemToArray(cpus, obj);
+    }
+
+    return thermal_data;
+}
+
+/**
+ * @brief Serialize the paging, fault and OOM section
+ * @param paging Paging section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* paging_to_json(const restrack_paging_t *paging) {
+    cJSON *paging_data = cJSON_CreateObject();
+    if (paging_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(paging_data, "pswpin", paging->pswpin);
+    cJSON_AddNumberToObject(paging_data, "pswpout", paging->pswpout);
+    cJSON_AddNumberToObject(paging_data, "pgmajfault", paging->pgmajfault);
+    cJSON_AddNumberToObject(paging_data, "allocstall", paging->allocstall);
+    if (paging->has_oom_kill) {
+        cJSON_AddNumberToObject(paging_data, "oom_kill", paging->oom_kill);
+    }
+
+    if (paging->has_rates) {
+        cJSON_AddNumberToObject(paging_data, "interval_ms", paging->interval_ms);
+        cJSON_AddNumberToObject(paging_data, "pswpin_per_sec", paging->pswpin_per_sec);
+        cJSON_AddNumberToObject(paging_data, "pswpout_per_sec", paging->pswpout_per_sec);
+        cJSON_AddNumberToObject(paging_data, "pgmajfault_per_sec", paging->pgmajfault_per_sec);
+        cJSON_AddNumberToObject(paging_data, "allocstall_per_sec", paging->allocstall_per_sec);
+        if (paging->has_oom_kill) {
+            cJSON_AddNumberToObject(paging_data, "oom_kill_per_sec", paging->oom_kill_per_sec);
+        }
+    }
+
+    if (paging->num_zram > 0) {
+        cJSON_AddNumberToObject(paging_data, "zram_compression_ratio", paging->zram_compression_ratio);
+
+        cJSON *zram = cJSON_AddArrayToObject(paging_data, "zram");
+        for (int i = 0; zram != NULL && i < paging->num_zram; i++) {
+            const restrack_zram_t *device = &paging->zram[i];
+            cJSON *obj = cJSON_CreateObject();
+            if (obj == NULL) {
+                continue;
+            }
+            cJSON_AddStringToObject(obj, "name", device->name);
+            cJSON_AddNumberToObject(obj, "orig_data_bytes", device->orig_data_bytes);
+            cJSON_AddNumberToObject(obj, "compr_data_bytes", device->compr_data_bytes);
+            cJSON_AddNumberToObject(obj, "mem_used_bytes", device->mem_used_bytes);
+            cJSON_AddNumberToObject(obj, "compression_ratio", device->compression_ratio);
+            cJSON_AddItemToArray(zram, obj);
+        }
+    }
+
+    return paging_data;
+}
+
+/**
+ * @brief Serialize the watched process section
+ * @param watched Watched process section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* watched_to_json(const restrack_watched_t *watched) {
+    cJSON *watched_data = cJSON_CreateObject();
+    if (watched_data == NULL) {
+        return NULL;
+    }
+
+    cJSON *procs = cJSON_AddArrayToObject(watched_data, "processes");
+    for (int i = 0; procs != NULL && i < watched->num_procs; i++) {
+        const restrack_watched_proc_t *watched_proc = &watched->procs[i];
+        cJSON *obj = proc_to_json(&watched_proc->proc);
+        if (obj == NULL) {
+            continue;
+        }
+        cJSON_AddStringToObject(obj, "pattern", watched_proc->pattern);
+        cJSON_AddNumberToObject(obj, "vm_kb", watched_proc->vm_kb);
+        cJSON_AddNumberToObject(obj, "shared_kb", watched_proc->shared_kb);
+        cJSON_AddNumberToObject(obj, "start_time", watched_proc->start_time);
+        cJSON_AddItemToArray(procs, obj);
+    }
+    if (watched->dropped > 0) {
+        cJSON_AddNumberToObject(watched_data, "dropped", watched->dropped);
+    }
+
+    cJSON *missing = cJSON_AddArrayToObject(watched_data, "missing");
+    for (int i = 0; missing != NULL && i < watched->num_missing; i++) {
+        cJSON_AddItemToArray(missing, cJSON_CreateString(watched->missing[i]));
+    }
+    cJSON_AddNumberToObject(watched_data, "scans", watched->scans);
+
+    return watched_data;
+}
+
+/**
+ * @brief Serialize the scheduling statistics of a sample
+ * @param timing Timing section
+ * @return cJSON object or NULL on failure
+ */
+static cJSON* timing_to_json(const restrack_timing_t *timing) {
+    cJSON *timing_data = cJSON_CreateObject();
+    if (timing_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddNumberToObject(timing_data, "ticks", timing->ticks);
+    cJSON_AddNumberToObject(timing_data, "overruns", timing->overruns);
+    cJSON_AddNumberToObject(timing_data, "monotonic_ms", timing->monotonic_ms);
+    cJSON_AddNumberToObject(timing_data, "interval_ms", timing->interval_ms);
+    cJSON_AddNumberToObject(timing_data, "jitter_ms", timing->jitter_ms);
+    cJSON_AddNumberToObject(timing_data, "jitter_avg_ms", timing->jitter_avg_ms);
+    cJSON_AddNumberToObject(timing_data, "jitter_max_ms", timing->jitter_max_ms);
+
+    return timing_data;
+}
+
+/**
+ * @brief Serialize a collected sample into a JSON object
+ * @param sample Sample filled by collect_all_resources()
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* sample_to_json(const restrack_sample_t *sample) {
+    if (sample == NULL) {
+        return NULL;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        log_message(LOG_ERROR, "Failed to create JSON object");
+        return NULL;
+    }
+
+    if (sample->valid & RESTRACK_HAS_CPU) {
+        add_section(root, "cpu_usage", cpu_to_json(&sample->cpu));
+    }
+    if (sample->valid & RESTRACK_HAS_MEMORY) {
+        add_section(root, "memory_usage", memory_to_json(&sample->memory));
+    }
+    if (sample->valid & RESTRACK_HAS_LOAD) {
+        add_section(root, "system_load", load_to_json(&sample->load));
+    }
+    if (sample->valid & RESTRACK_HAS_DISK) {
+        add_section(root, "disk_usage", disk_to_json(&sample->disk));
+    }
+    if (sample->valid & RESTRACK_HAS_NETWORK) {
+        add_section(root, "network_stats", network_to_json(&sample->network));
+    }
+    if (sample->valid & RESTRACK_HAS_UPTIME) {
+        add_section(root, "system_uptime", uptime_to_json(&sample->uptime));
+    }
+    if (sample->valid & RESTRACK_HAS_PROCESSES) {
+        add_section(root, "process_info", processes_to_json(&sample->processes));
+    }
+    if (sample->valid & RESTRACK_HAS_SWAP) {
+        const restrack_swap_t *sw = &sample->swap;
+        add_section(root, "swap_usage", usage_to_json(sw->total_mb, sw->used_mb, sw->free_mb, sw->usage_percent));
+    }
+    if (sample->valid & RESTRACK_HAS_PRESSURE) {
+        add_section(root, "pressure", pressure_to_json(&sample->pressure));
+    }
+    if (sample->valid & RESTRACK_HAS_CGROUPS) {
+        add_section(root, "cgroups", cgroups_to_json(&sample->cgroups));
+    }
+    if (sample->valid & RESTRACK_HAS_INTERRUPTS) {
+        add_section(root, "interrupts", interrupts_to_json(&sample->interrupts));
+    }
+    if (sample->valid & RESTRACK_HAS_CONNECTIONS) {
+        add_section(root, "connections", connections_to_json(&sample->connections));
+    }
+    if (sample->valid & RESTRACK_HAS_PROTOCOLS) {
+        add_section(root, "protocols", protocols_to_json(&sample->protocols));
+    }
+    if (sample->valid & RESTRACK_HAS_THERMAL) {
+        add_section(root, "thermal", thermal_to_json(&sample->thermal));
+    }
+    if (sample->valid & RESTRACK_HAS_PAGING) {
+        add_section(root, "paging", paging_to_json(&sample->paging));
+    }
+    if (sample->valid & RESTRACK_HAS_WATCHED) {
+        add_section(root, "watched", watched_to_json(&sample->watched));
+    }
+    if (sample->timing.ticks > 0) {
+        add_section(root, "timing", timing_to_json(&sample->timing));
+    }
+
+    return root;
+}
+
+/**
+ * @brief Serialize a link or address change
+ * @param event Event reported by the link watcher
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* link_event_to_json(const restrack_link_event_t *event) {
+    static const char *const names[] = {
+        "link_added", "link_removed", "link_up", "link_down", "address_added", "address_removed"
+    };
+
+    if (event == NULL || (unsigned int)event->type >= sizeof(names) / sizeof(names[0])) {
+        return NULL;
+    }
+
+    cJSON *event_data = cJSON_CreateObject();
+    if (event_data == NULL) {
+        return NULL;
+    }
+
+    cJSON_AddStringToObject(event_data, "event", names[event->type]);
+    cJSON_AddStringToObject(event_data, "interface", event->name);
+    cJSON_AddNumberToObject(event_data, "ifindex", event->ifindex);
+    cJSON_AddStringToObject(event_data, "operstate", operstate_name(event->operstate));
+    cJSON_AddBoolToObject(event_data, "up", event->up);
+    cJSON_AddNumberToObject(event_data, "flags", event->flags);
+    if (event->type == RESTRACK_ADDR_ADDED || event->type == RESTRACK_ADDR_REMOVED) {
+        cJSON_AddStringToObject(event_data, "family", event->family == AF_INET6 ? "ipv6" : "ipv4");
+        cJSON_AddStringToObject(event_data, "address", event->address);
+        cJSON_AddNumberToObject(event_data, "prefixlen", event->prefixlen);
+    }
+
+    return event_data;
 }
 
 /**
@@ -175,69 +1194,41 @@ int create_history_entry(const char *file_path, cJSON *new_data) {
         return ERR_INVALID_PARAM;
     }
 
-    cJSON *root = NULL;
-    char *json_str = NULL;
-    int result = ERR_SUCCESS;
-
-    // Try to read existing file
-    json_str = read_file(file_path);
-    if (json_str == NULL) {
-        log_message(LOG_WARNING, "Failed to read file %s, creating new one", file_path);
-        root = cJSON_CreateObject();
-    } else {
-        root = cJSON_Parse(json_str);
-        free(json_str);
-        
-        if (root == NULL) {
-            log_message(LOG_WARNING, "Failed to parse existing JSON file %s, creating new one", file_path);
-            root = cJSON_CreateObject();
-        }
+    int result = ensure_journal(file_path);
+    if (result != ERR_SUCCESS) {
+        return result;
     }
 
-    if (root == NULL) {
-        log_message(LOG_ERROR, "Failed to create JSON object");
+    char *record = cJSON_PrintUnformatted(new_data);
+    if (record == NULL) {
+        log_message(LOG_ERROR, "Failed to convert JSON to string");
         return ERR_JSON_CREATE;
     }
 
-    // Get or create history array
-    cJSON *history = cJSON_GetObjectItem(root, "history");
-    if (history == NULL || !cJSON_IsArray(history)) {
-        history = cJSON_CreateArray();
-        if (history == NULL) {
-            log_message(LOG_ERROR, "Failed to create history array");
-            cJSON_Delete(root);
-            return ERR_JSON_CREATE;
-        }
-        
-        cJSON_AddItemToObject(root, "history", history);
-    }
+    return journal_append(&g_journal, record, strlen(record));
+}
 
-    // Add new entry to history (limited to 100 entries)
-    if (cJSON_GetArraySize(history) >= 100) {
-        // Remove oldest entry
-        cJSON_DeleteItemFromArray(history, 0);
-    }
-    
-    cJSON *new_entry = cJSON_Duplicate(new_data, 1);
-    if (new_entry == NULL) {
-        log_message(LOG_ERROR, "Failed to duplicate data for history");
-        cJSON_Delete(root);
-        return ERR_JSON_CREATE;
+/**
+ * @brief Open the history journal of a data file with a given depth
+ * @param file_path Path to the JSON file
+ * @param history_size Number of samples kept in memory and in the journal
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int open_json_history(const char *file_path, size_t history_size) {
+    if (file_path == NULL || history_size == 0) {
+        return ERR_INVALID_PARAM;
     }
-    
-    cJSON_AddItemToArray(history, new_entry);
 
-    // Convert to string and save
-    json_str = cJSON_Print(root);
-    if (json_str == NULL) {
-        log_message(LOG_ERROR, "Failed to convert JSON to string");
-        cJSON_Delete(root);
-        return ERR_JSON_CREATE;
+    g_history_size = history_size;
+    return ensure_journal(file_path);
+}
+
+/**
+ * @brief Close the history journal opened by update_json_file()
+ */
+void close_json_history(void) {
+    if (g_journal_ready) {
+        journal_close(&g_journal);
+        g_journal_ready = 0;
     }
-    
-    result = write_file(file_path, json_str);
-    free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
 }
@@ -8,6 +8,10 @@
 
 #include "cJSON.h"
 #include "sysmon.h"
+#include "resources.h"
+
+// Suffix appended to the output path to name the history journal
+#define HISTORY_JOURNAL_SUFFIX ".journal"
 
 /**
  * @brief Update a JSON file with new data
@@ -17,6 +21,20 @@
  */
 int update_json_file(const char *file_path, cJSON *new_data);
 
+/**
+ * @brief Serialize a collected sample into a JSON object
+ * @param sample Sample filled by collect_all_resources()
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* sample_to_json(const restrack_sample_t *sample);
+
+/**
+ * @brief Serialize a link or address change
+ * @param event Event reported by the link watcher
+ * @return cJSON object (caller must delete) or NULL on failure
+ */
+cJSON* link_event_to_json(const restrack_link_event_t *event);
+
 /**
  * @brief Merge two JSON objects
  * @param target Target JSON object
@@ -33,4 +51,17 @@ int merge_json_objects(cJSON *target, cJSON *source);
  */
 int create_history_entry(const char *file_path, cJSON *new_data);
 
+/**
+ * @brief Open the history journal of a data file with a given depth
+ * @param file_path Path to the JSON file
+ * @param history_size Number of samples kept in memory and in the journal
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int open_json_history(const char *file_path, size_t history_size);
+
+/**
+ * @brief Close the history journal opened by update_json_file()
+ */
+void close_json_history(void);
+
 #endif /* JSON_HANDLER_H */
@@ -0,0 +1,496 @@
+/**
+ * @file linkwatch.c
+ * @brief Event-driven link and address tracking over rtnetlink multicast
+ */
+
+#include "linkwatch.h"
+#include "procfs.h"
+#include "util.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_addr.h>
+
+// Receive buffer; one datagram never exceeds a page-sized dump batch
+#define LINKWATCH_RECV_BUF_SIZE 32768
+
+// Socket buffer requested so bursts of notifications are not dropped
+#define LINKWATCH_SOCKET_BUF_SIZE (256 * 1024)
+
+/**
+ * @struct LinkState
+ * @brief Last known state of one interface
+ */
+typedef struct {
+    int ifindex;
+    char name[RESTRACK_NAME_LEN];
+    unsigned int flags;
+    unsigned char operstate;
+} LinkState;
+
+/**
+ * @struct LinkTable
+ * @brief Interfaces known at one point in time
+ */
+typedef struct {
+    int count;
+    LinkState links[RESTRACK_MAX_INTERFACES];
+} LinkTable;
+
+static int g_watch_fd = -1;
+static char *g_watch_buf = NULL;
+static uint32_t g_watch_seq = 0;
+static uint32_t g_watch_port = 0;       // Netlink port id the kernel assigned us
+static LinkEventHandler g_handler = NULL;
+static void *g_handler_ctx = NULL;
+
+// Current table, and the one a dump in progress is building
+static LinkTable g_links;
+static LinkTable g_dump_links;
+static int g_dumping = 0;
+static int g_resync_pending = 0;        // Notifications were lost during a dump
+static int g_initial = 1;               // No events until the first dump is done
+
+/**
+ * @brief Decide whether a link can pass traffic
+ * @param flags IFF_* flags
+ * @param operstate IF_OPER_* value
+ * @return 1 if the link is up, 0 otherwise
+ */
+static int link_is_up(unsigned int flags, unsigned char operstate) {
+    if (!(flags & IFF_UP)) {
+        return 0;
+    }
+    // Loopback and tunnels report no operstate but do signal carrier
+    return operstate == IF_OPER_UP || (operstate == IF_OPER_UNKNOWN && (flags & IFF_LOWER_UP));
+}
+
+/**
+ * @brief Find an interface in a table
+ * @param table Table to search
+ * @param ifindex Interface index
+ * @return Entry or NULL when absent
+ */
+static LinkState* find_link(LinkTable *table, int ifindex) {
+    for (int i = 0; i < table->count; i++) {
+        if (table->links[i].ifindex == ifindex) {
+            return &table->links[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Remove an interface from a table
+ * @param table Table to update
+ * @param ifindex Interface index
+ */
+static void remove_link(LinkTable *table, int ifindex) {
+    LinkState *link = find_link(table, ifindex);
+    if (link != NULL) {
+        *link = table->links[--table->count];
+    }
+}
+
+/**
+ * @brief Insert or overwrite an interface in a table
+ * @param table Table to update
+ * @param state New state of the interface
+ */
+static void store_link(LinkTable *table, const LinkState *state) {
+    LinkState *link = find_link(table, state->ifindex);
+    if (link == NULL) {
+        if (table->count >= RESTRACK_MAX_INTERFACES) {
+            return;
+        }
+        link = &table->links[table->count++];
+    }
+    *link = *state;
+}
+
+/**
+ * @brief Pass a link event to the handler
+ * @param type Kind of event
+ * @param link Interface it concerns
+ */
+static void emit_link_event(restrack_link_event_type_t type, const LinkState *link) {
+    if (g_handler == NULL || g_initial) {
+        return;
+    }
+
+    restrack_link_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    memcpy(event.name, link->name, sizeof(event.name));
+    event.ifindex = link->ifindex;
+    event.flags = link->flags;
+    event.operstate = link->operstate;
+    event.up = link_is_up(link->flags, link->operstate);
+    g_handler(&event, g_handler_ctx);
+}
+
+/**
+ * @brief Report how an interface changed between two states
+ * @param old_state Previous state, NULL if the interface is new
+ * @param new_state Current state
+ */
+static void emit_link_change(const LinkState *old_state, const LinkState *new_state) {
+    if (old_state == NULL) {
+        emit_link_event(RESTRACK_LINK_ADDED, new_state);
+        return;
+    }
+
+    int was_up = link_is_up(old_state->flags, old_state->operstate);
+    int is_up = link_is_up(new_state->flags, new_state->operstate);
+    if (was_up != is_up) {
+        emit_link_event(is_up ? RESTRACK_LINK_UP : RESTRACK_LINK_DOWN, new_state);
+    }
+}
+
+/**
+ * @brief Ask the kernel for a dump of every link
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int start_dump(void) {
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++g_watch_seq;
+    req.ifm.ifi_family = AF_UNSPEC;
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    ssize_t sent;
+    do {
+        sent = sendto(g_watch_fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel));
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent != (ssize_t)req.nlh.nlmsg_len) {
+        log_message(LOG_WARNING, "Failed to request link dump: %s", strerror(errno));
+        return ERR_FILE_WRITE;
+    }
+
+    g_dump_links.count = 0;
+    g_dumping = 1;
+    g_resync_pending = 0;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Replace the table with a completed dump, reporting the differences
+ */
+static void finish_dump(void) {
+    for (int i = 0; i < g_dump_links.count; i++) {
+        const LinkState *link = &g_dump_links.links[i];
+        emit_link_change(find_link(&g_links, link->ifindex), link);
+    }
+    for (int i = 0; i < g_links.count; i++) {
+        if (find_link(&g_dump_links, g_links.links[i].ifindex) == NULL) {
+            emit_link_event(RESTRACK_LINK_REMOVED, &g_links.links[i]);
+        }
+    }
+
+    g_links = g_dump_links;
+    g_dumping = 0;
+    g_initial = 0;
+
+    if (g_resync_pending) {
+        start_dump();
+    }
+}
+
+/**
+ * @brief Decode the interface state carried by a link message
+ * @param nlh RTM_NEWLINK or RTM_DELLINK message
+ * @param state State to fill
+ * @return 1 if the message named an interface, 0 otherwise
+ */
+static int parse_link_state(struct nlmsghdr *nlh, LinkState *state) {
+    struct ifinfomsg *ifm = (struct ifinfomsg*)NLMSG_DATA(nlh);
+    int len = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(sizeof(*ifm));
+    if (len < 0) {
+        return 0;
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->ifindex = ifm->ifi_index;
+    state->flags = ifm->ifi_flags;
+
+    int have_name = 0;
+    for (struct rtattr *rta = IFLA_RTA(ifm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            procfs_copy_token(state->name, sizeof(state->name), (const char*)RTA_DATA(rta),
+                              strnlen((const char*)RTA_DATA(rta), RTA_PAYLOAD(rta)));
+            have_name = 1;
+        } else if (rta->rta_type == IFLA_OPERSTATE && RTA_PAYLOAD(rta) >= 1) {
+            state->operstate = *(const unsigned char*)RTA_DATA(rta);
+        }
+    }
+    return have_name;
+}
+
+/**
+ * @brief Apply a link notification to the tables and report it
+ * @param nlh RTM_NEWLINK or RTM_DELLINK message
+ */
+static void handle_link_message(struct nlmsghdr *nlh) {
+    LinkState state;
+    if (!parse_link_state(nlh, &state)) {
+        return;
+    }
+
+    LinkState *known = find_link(&g_links, state.ifindex);
+
+    if (nlh->nlmsg_type == RTM_DELLINK) {
+        if (known != NULL) {
+            emit_link_event(RESTRACK_LINK_REMOVED, &state);
+            remove_link(&g_links, state.ifindex);
+        }
+        if (g_dumping) {
+            remove_link(&g_dump_links, state.ifindex);
+        }
+        return;
+    }
+
+    emit_link_change(known, &state);
+    store_link(&g_links, &state);
+
+    // Keep a dump in progress from ending with a state older than this one
+    if (g_dumping && find_link(&g_dump_links, state.ifindex) != NULL) {
+        store_link(&g_dump_links, &state);
+    }
+}
+
+/**
+ * @brief Report an address notification
+ * @param nlh RTM_NEWADDR or RTM_DELADDR message
+ */
+static void handle_addr_message(struct nlmsghdr *nlh) {
+    if (g_handler == NULL || g_initial) {
+        return;
+    }
+
+    struct ifaddrmsg *ifa = (struct ifaddrmsg*)NLMSG_DATA(nlh);
+    int len = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(sizeof(*ifa));
+    if (len < 0 || (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)) {
+        return;
+    }
+
+    unsigned int addr_flags = ifa->ifa_flags;
+    const void *local = NULL, *address = NULL;
+    for (struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFA_LOCAL) {
+            local = RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_ADDRESS) {
+            address = RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_FLAGS && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+            uint32_t flags;
+            memcpy(&flags, RTA_DATA(rta), sizeof(flags));
+            addr_flags = flags;
+        }
+    }
+    // IPv6 addresses are announced again once duplicate detection passes
+    if (nlh->nlmsg_type == RTM_NEWADDR && (addr_flags & IFA_F_TENTATIVE)) {
+        return;
+    }
+
+    // On point-to-point links IFA_ADDRESS is the peer, IFA_LOCAL our end
+    const void *ours = local != NULL ? local : address;
+    if (ours == NULL) {
+        return;
+    }
+
+    restrack_link_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = nlh->nlmsg_type == RTM_NEWADDR ? RESTRACK_ADDR_ADDED : RESTRACK_ADDR_REMOVED;
+    event.ifindex = (int)ifa->ifa_index;
+    event.family = ifa->ifa_family;
+    event.prefixlen = ifa->ifa_prefixlen;
+    if (inet_ntop(ifa->ifa_family, ours, event.address, sizeof(event.address)) == NULL) {
+        return;
+    }
+
+    const LinkState *link = find_link(&g_links, event.ifindex);
+    if (link != NULL) {
+        memcpy(event.name, link->name, sizeof(event.name));
+        event.flags = link->flags;
+        event.operstate = link->operstate;
+        event.up = link_is_up(link->flags, link->operstate);
+    }
+
+    g_handler(&event, g_handler_ctx);
+}
+
+/**
+ * @brief Handle one message read from the socket
+ * @param nlh Netlink message
+ */
+static void handle_message(struct nlmsghdr *nlh) {
+    // Notifications carry the port and sequence of whoever caused them,
+    // so only our own port id marks a dump reply
+    if (nlh->nlmsg_pid == g_watch_port && g_watch_port != 0) {
+        if (!g_dumping || nlh->nlmsg_seq != g_watch_seq) {
+            return;
+        }
+        if (nlh->nlmsg_type == NLMSG_DONE) {
+            finish_dump();
+        } else if (nlh->nlmsg_type == NLMSG_ERROR) {
+            log_message(LOG_WARNING, "Link dump failed, keeping the previous interface table");
+            g_dumping = 0;
+            g_initial = 0;
+        } else if (nlh->nlmsg_type == RTM_NEWLINK) {
+            LinkState state;
+            if (parse_link_state(nlh, &state)) {
+                store_link(&g_dump_links, &state);
+            }
+        }
+        return;
+    }
+
+    switch (nlh->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            handle_link_message(nlh);
+            break;
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            handle_addr_message(nlh);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Subscribe to link and address notifications
+ * @param handler Receives the events
+ * @param ctx Passed to the handler
+ * @return ERR_SUCCESS on success, error code if netlink is unusable
+ */
+int linkwatch_open(LinkEventHandler handler, void *ctx) {
+    if (handler == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+    if (g_watch_fd >= 0) {
+        return ERR_SUCCESS;
+    }
+
+    g_watch_buf = (char*)malloc(LINKWATCH_RECV_BUF_SIZE);
+    if (g_watch_buf == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+
+    g_watch_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (g_watch_fd < 0) {
+        log_message(LOG_WARNING, "rtnetlink unavailable (%s), link events disabled", strerror(errno));
+        linkwatch_cleanup();
+        return ERR_SYS_RESOURCE;
+    }
+
+    int rcvbuf = LINKWATCH_SOCKET_BUF_SIZE;
+    setsockopt(g_watch_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(g_watch_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        log_message(LOG_WARNING, "Failed to join rtnetlink groups (%s), link events disabled", strerror(errno));
+        linkwatch_cleanup();
+        return ERR_SYS_RESOURCE;
+    }
+
+    socklen_t addr_len = sizeof(addr);
+    if (getsockname(g_watch_fd, (struct sockaddr*)&addr, &addr_len) == 0) {
+        g_watch_port = addr.nl_pid;
+    }
+
+    g_handler = handler;
+    g_handler_ctx = ctx;
+    g_links.count = 0;
+    g_initial = 1;
+
+    int result = start_dump();
+    if (result != ERR_SUCCESS) {
+        linkwatch_cleanup();
+        return result;
+    }
+
+    log_message(LOG_INFO, "Watching link and address changes");
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Get the descriptor to poll for pending notifications
+ * @return Socket descriptor, -1 when not open
+ */
+int linkwatch_fd(void) {
+    return g_watch_fd;
+}
+
+/**
+ * @brief Read every pending notification and emit the resulting events
+ */
+void linkwatch_process(void) {
+    if (g_watch_fd < 0) {
+        return;
+    }
+
+    for (;;) {
+        ssize_t n = recv(g_watch_fd, g_watch_buf, LINKWATCH_RECV_BUF_SIZE, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // The kernel dropped notifications; only a fresh dump is reliable
+                log_message(LOG_WARNING, "Link notifications overflowed, resynchronising");
+                if (g_dumping) {
+                    g_resync_pending = 1;
+                } else {
+                    start_dump();
+                }
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_message(LOG_WARNING, "Failed to read link notifications: %s", strerror(errno));
+            }
+            return;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr*)g_watch_buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            handle_message(nlh);
+        }
+    }
+}
+
+/**
+ * @brief Close the socket and forget the interface table
+ */
+void linkwatch_cleanup(void) {
+    if (g_watch_fd >= 0) {
+        close(g_watch_fd);
+        g_watch_fd = -1;
+    }
+    free(g_watch_buf);
+    g_watch_buf = NULL;
+    g_watch_port = 0;
+    g_handler = NULL;
+    g_handler_ctx = NULL;
+    g_links.count = 0;
+    g_dump_links.count = 0;
+    g_dumping = 0;
+    g_resync_pending = 0;
+    g_initial = 1;
+}
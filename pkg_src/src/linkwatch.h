@@ -0,0 +1,51 @@
+/**
+ * @file linkwatch.h
+ * @brief Event-driven link and address tracking over rtnetlink multicast
+ */
+
+#ifndef LINKWATCH_H
+#define LINKWATCH_H
+
+#include "resources.h"
+
+/**
+ * @brief Called for every link or address change
+ * @param event Change that was observed
+ * @param ctx Context given to linkwatch_open()
+ */
+typedef void (*LinkEventHandler)(const restrack_link_event_t *event, void *ctx);
+
+/**
+ * @brief Subscribe to link and address notifications
+ * @param handler Receives the events
+ * @param ctx Passed to the handler
+ * @return ERR_SUCCESS on success, error code if netlink is unusable
+ *
+ * The socket joins RTMGRP_LINK and the IPv4/IPv6 address groups, and an
+ * initial RTM_GETLINK dump fills the interface table without emitting
+ * events. Only linkwatch_process() reads the socket, so the caller
+ * decides when handlers run.
+ */
+int linkwatch_open(LinkEventHandler handler, void *ctx);
+
+/**
+ * @brief Get the descriptor to poll for pending notifications
+ * @return Socket descriptor, -1 when not open
+ */
+int linkwatch_fd(void);
+
+/**
+ * @brief Read every pending notification and emit the resulting events
+ *
+ * Never blocks. If the kernel dropped notifications because the socket
+ * buffer overflowed, the links are dumped again and the differences are
+ * reported as events.
+ */
+void linkwatch_process(void);
+
+/**
+ * @brief Close the socket and forget the interface table
+ */
+void linkwatch_cleanup(void);
+
+#endif /* LINKWATCH_H */
@@ -0,0 +1,157 @@
+/**
+ * @file meminfo.c
+ * @brief Memory breakdown from /proc/meminfo
+ */
+
+#include "meminfo.h"
+#include "procfs.h"
+
+// Lines of /proc/meminfo covered by the index; current kernels have about 60
+#define MEMINFO_MAX_LINES 128
+
+// Fields read from /proc/meminfo
+enum {
+    MEMINFO_TOTAL,
+    MEMINFO_FREE,
+    MEMINFO_AVAILABLE,
+    MEMINFO_BUFFERS,
+    MEMINFO_CACHED,
+    MEMINFO_SHMEM,
+    MEMINFO_SLAB,
+    MEMINFO_SRECLAIMABLE,
+    MEMINFO_FIELDS
+};
+
+// Keys of the fields, in MEMINFO_* order
+static const char *const g_keys[MEMINFO_FIELDS] = {
+    "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "Shmem", "Slab", "SReclaimable"
+};
+
+static ProcfsFile g_proc_meminfo = PROCFS_FILE_INIT("/proc/meminfo");
+
+// Field fed by each line of the file, -1 for lines that are not needed
+static signed char g_line_field[MEMINFO_MAX_LINES];
+static int g_num_lines = 0;
+
+/**
+ * @brief Map a key to its field
+ * @param key Start of the key
+ * @param len Length of the key
+ * @return MEMINFO_* field, -1 if the key is not needed
+ */
+static int key_field(const char *key, size_t len) {
+    for (int i = 0; i < MEMINFO_FIELDS; i++) {
+        if (procfs_token_equals(key, len, g_keys[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse the buffer of the last read, through the line index
+ * @param values Receives the fields in kB
+ * @param found Receives a bitmask of the fields seen
+ * @return 1 on success, 0 if the index no longer matches the file
+ */
+static int parse_indexed(uint64_t *values, unsigned int *found) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_meminfo);
+
+    *found = 0;
+    for (int i = 0; procfs_next_line(&file, &line); i++) {
+        // Lines past a full index are ignored, new lines of a short one mean a different file
+        if (i >= g_num_lines) {
+            return g_num_lines == MEMINFO_MAX_LINES;
+        }
+
+        int field = g_line_field[i];
+        if (field < 0) {
+            continue;
+        }
+
+        const char *key;
+        size_t key_len;
+        uint64_t value;
+        if (!procfs_next_token(&line, ':', &key, &key_len) || !procfs_token_equals(key, key_len, g_keys[field]) ||
+            line.pos >= line.end || *line.pos++ != ':' || !procfs_next_u64(&line, &value)) {
+            return 0;
+        }
+        values[field] = value;
+        *found |= 1u << field;
+    }
+    return 1;
+}
+
+/**
+ * @brief Record which line of the last read feeds which field
+ */
+static void build_index(void) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_meminfo);
+
+    g_num_lines = 0;
+    while (g_num_lines < MEMINFO_MAX_LINES && procfs_next_line(&file, &line)) {
+        const char *key;
+        size_t key_len;
+        g_line_field[g_num_lines++] =
+            procfs_next_token(&line, ':', &key, &key_len) ? (signed char)key_field(key, key_len) : -1;
+    }
+}
+
+/**
+ * @brief Read /proc/meminfo into the memory section
+ * @param memory Memory section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int meminfo_read(restrack_memory_t *memory) {
+    int result = procfs_read(&g_proc_meminfo);
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
+    uint64_t kb[MEMINFO_FIELDS] = { 0 };
+    unsigned int found = 0;
+    if (!parse_indexed(kb, &found)) {
+        build_index();
+        if (!parse_indexed(kb, &found)) {
+            return ERR_FILE_READ;
+        }
+    }
+    if (!(found & (1u << MEMINFO_TOTAL)) || kb[MEMINFO_TOTAL] == 0) {
+        return ERR_FILE_READ;
+    }
+
+    // Kernels before 3.14 lack MemAvailable; estimate it the way the kernel does
+    uint64_t available_kb = kb[MEMINFO_AVAILABLE];
+    memory->available_estimated = !(found & (1u << MEMINFO_AVAILABLE));
+    if (memory->available_estimated) {
+        available_kb = kb[MEMINFO_FREE] + kb[MEMINFO_BUFFERS] + kb[MEMINFO_CACHED] + kb[MEMINFO_SRECLAIMABLE];
+        available_kb = available_kb > kb[MEMINFO_SHMEM] ? available_kb - kb[MEMINFO_SHMEM] : 0;
+    }
+    if (available_kb > kb[MEMINFO_TOTAL]) {
+        available_kb = kb[MEMINFO_TOTAL];
+    }
+
+    memory->has_meminfo = 1;
+    memory->total_mb = kb[MEMINFO_TOTAL] / 1024;
+    memory->free_mb = kb[MEMINFO_FREE] / 1024;
+    memory->available_mb = available_kb / 1024;
+    memory->used_mb = (kb[MEMINFO_TOTAL] - available_kb) / 1024;
+    memory->usage_percent = 100.0 * (double)(kb[MEMINFO_TOTAL] - available_kb) / (double)kb[MEMINFO_TOTAL];
+    memory->buffers_mb = kb[MEMINFO_BUFFERS] / 1024;
+    memory->cached_mb = kb[MEMINFO_CACHED] / 1024;
+    memory->shmem_mb = kb[MEMINFO_SHMEM] / 1024;
+    memory->slab_mb = kb[MEMINFO_SLAB] / 1024;
+    memory->sreclaimable_mb = kb[MEMINFO_SRECLAIMABLE] / 1024;
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close /proc/meminfo and forget the line index
+ */
+void meminfo_cleanup(void) {
+    procfs_close(&g_proc_meminfo);
+    g_num_lines = 0;
+}
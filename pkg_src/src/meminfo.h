@@ -0,0 +1,27 @@
+/**
+ * @file meminfo.h
+ * @brief Memory breakdown from /proc/meminfo
+ */
+
+#ifndef MEMINFO_H
+#define MEMINFO_H
+
+#include "resources.h"
+
+/**
+ * @brief Read /proc/meminfo into the memory section
+ * @param memory Memory section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * The first read records which line of the file feeds which field, so
+ * later reads only parse the numbers of the lines that are needed. The
+ * index is rebuilt when a line no longer carries the expected key.
+ */
+int meminfo_read(restrack_memory_t *memory);
+
+/**
+ * @brief Close /proc/meminfo and forget the line index
+ */
+void meminfo_cleanup(void);
+
+#endif /* MEMINFO_H */
@@ -0,0 +1,530 @@
+/**
+ * @file mounts.c
+ * @brief Usage of every mounted filesystem, with statvfs off the main thread
+ */
+
+#include "mounts.h"
+#include "procfs.h"
+#include "util.h"
+#include <pthread.h>
+#include <poll.h>
+#include <sys/statvfs.h>
+
+// Mounts tracked at once, including unmounted ones whose statvfs is still running
+#define MOUNTS_MAX_SLOTS (2 * RESTRACK_MAX_FILESYSTEMS)
+
+// Worker threads; a new one is only started while all others are stuck
+#define MOUNTS_MAX_WORKERS 4
+
+// Longest wait for idle workers to leave in mounts_cleanup()
+#define MOUNTS_STOP_TIMEOUT_MS 1000
+
+// Longest mount point kept for statvfs; longer ones are skipped
+#define MOUNTS_PATH_LEN 256
+
+// States of a slot
+enum {
+    SLOT_FREE,                   // Not in use
+    SLOT_IDLE,                   // Mounted, no statvfs pending
+    SLOT_QUEUED,                 // Waiting for a worker
+    SLOT_BUSY                    // A worker is inside statvfs
+};
+
+/**
+ * @struct MountSlot
+ * @brief One mount and the last statvfs answer for it
+ *
+ * A busy slot belongs to the worker calling statvfs on it and is never
+ * handed to another mount, even once unmounted, so a late answer always
+ * lands on the slot it was asked for.
+ */
+typedef struct {
+    int state;                   // SLOT_*
+    int present;                 // Listed in the current mount table
+    int mount_id;                // First column of mountinfo
+    unsigned int major;
+    unsigned int minor;
+    int has_value;               // statvfs answered at least once
+    char path[MOUNTS_PATH_LEN];  // Unescaped mount point
+    restrack_filesystem_t fs;    // Mount details and last answer
+} MountSlot;
+
+// Pseudo filesystems that never hold user data
+static const char *const g_pseudo_fs[] = {
+    "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "debugfs",
+    "tracefs", "securityfs", "pstore", "bpf", "configfs", "mqueue",
+    "hugetlbfs", "fusectl", "binfmt_misc", "autofs", "efivarfs",
+    "selinuxfs", "rpc_pipefs", "nsfs"
+};
+
+static ProcfsFile g_mountinfo = PROCFS_FILE_INIT("/proc/self/mountinfo");
+static int g_have_table = 0;
+
+// Mounts in mountinfo order, as slot indices
+static int g_order[RESTRACK_MAX_FILESYSTEMS];
+static int g_num_order = 0;
+static int g_dropped = 0;
+
+// Everything below is protected by g_lock
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_work_cond;       // Signalled when slots are queued
+static pthread_cond_t g_done_cond;       // Signalled when a statvfs returns
+static int g_conds_ready = 0;
+static MountSlot g_slots[MOUNTS_MAX_SLOTS];
+static int g_workers = 0;                // Running worker threads
+static int g_idle_workers = 0;           // Workers waiting for a queued slot
+static int g_busy_workers = 0;           // Workers inside statvfs
+static int g_stop = 0;
+
+/**
+ * @brief Create the condition variables on the monotonic clock
+ */
+static void init_conds(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_work_cond, &attr);
+    pthread_cond_init(&g_done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    g_conds_ready = 1;
+}
+
+/**
+ * @brief Get an absolute CLOCK_MONOTONIC time some milliseconds from now
+ * @param ms Milliseconds to add
+ * @param ts Receives the time
+ */
+static void deadline_after(int ms, struct timespec *ts) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * @brief Store a statvfs answer in a slot
+ * @param fs Filesystem entry to update
+ * @param st statvfs result
+ */
+static void store_statvfs(restrack_filesystem_t *fs, const struct statvfs *st) {
+    uint64_t frsize = st->f_frsize ? st->f_frsize : st->f_bsize;
+
+    fs->total_mb = ((uint64_t)st->f_blocks * frsize) / (1024 * 1024);
+    fs->free_mb = ((uint64_t)st->f_bfree * frsize) / (1024 * 1024);
+    fs->available_mb = ((uint64_t)st->f_bavail * frsize) / (1024 * 1024);
+    fs->used_mb = fs->total_mb - fs->free_mb;
+    fs->usage_percent = fs->total_mb > 0 ? 100.0 * fs->used_mb / fs->total_mb : 0.0;
+
+    fs->inodes_total = st->f_files;
+    fs->inodes_free = st->f_ffree <= st->f_files ? st->f_ffree : st->f_files;
+    fs->inodes_used = fs->inodes_total - fs->inodes_free;
+    fs->inode_usage_percent = fs->inodes_total > 0 ? 100.0 * fs->inodes_used / fs->inodes_total : 0.0;
+
+    if (st->f_flag & ST_RDONLY) {
+        fs->readonly = 1;
+    }
+}
+
+/**
+ * @brief Find the oldest queued slot
+ * @return Slot index, -1 when nothing is queued
+ */
+static int next_queued_slot(void) {
+    for (int i = 0; i < MOUNTS_MAX_SLOTS; i++) {
+        if (g_slots[i].state == SLOT_QUEUED) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Worker thread running statvfs on queued slots
+ * @param arg Unused
+ * @return NULL
+ */
+static void* statvfs_worker(void *arg) {
+    pthread_mutex_lock(&g_lock);
+    while (!g_stop) {
+        int index = next_queued_slot();
+        if (index < 0) {
+            g_idle_workers++;
+            pthread_cond_wait(&g_work_cond, &g_lock);
+            g_idle_workers--;
+            continue;
+        }
+
+        MountSlot *slot = &g_slots[index];
+        char path[MOUNTS_PATH_LEN];
+        memcpy(path, slot->path, sizeof(path));
+        slot->state = SLOT_BUSY;
+        g_busy_workers++;
+        pthread_mutex_unlock(&g_lock);
+
+        // May block for as long as the server or device takes to answer
+        struct statvfs st;
+        int rc = statvfs(path, &st);
+
+        pthread_mutex_lock(&g_lock);
+        g_busy_workers--;
+        if (slot->present) {
+            if (rc == 0) {
+                store_statvfs(&slot->fs, &st);
+                slot->has_value = 1;
+            }
+            slot->state = SLOT_IDLE;
+        } else {
+            slot->state = SLOT_FREE;
+        }
+        pthread_cond_broadcast(&g_done_cond);
+    }
+
+    g_workers--;
+    pthread_cond_broadcast(&g_done_cond);
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+/**
+ * @brief Start one more detached worker thread, called with g_lock held
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int start_worker(void) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&thread, &attr, statvfs_worker, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (rc != 0) {
+        return ERR_SYS_RESOURCE;
+    }
+    g_workers++;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Check whether a filesystem type is a pseudo filesystem
+ * @param fstype Filesystem type token
+ * @param len Length of the token
+ * @return 1 if it is, 0 otherwise
+ */
+static int is_pseudo_fs(const char *fstype, size_t len) {
+    for (size_t i = 0; i < sizeof(g_pseudo_fs) / sizeof(g_pseudo_fs[0]); i++) {
+        if (procfs_token_equals(fstype, len, g_pseudo_fs[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copy a mountinfo path, decoding the octal escapes of the kernel
+ * @param dst Destination buffer
+ * @param size Size of the destination buffer
+ * @param token Start of the escaped path
+ * @param len Length of the escaped path
+ * @return 1 if the whole path fit, 0 if it was truncated
+ */
+static int unescape_path(char *dst, size_t size, const char *token, size_t len) {
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (out + 1 >= size) {
+            dst[out] = '\0';
+            return 0;
+        }
+
+        // Space, tab, newline and backslash appear as \040, \011, \012 and \134
+        if (token[i] == '\\' && i + 3 < len &&
+            (unsigned)(token[i + 1] - '0') < 4 && (unsigned)(token[i + 2] - '0') < 8 &&
+            (unsigned)(token[i + 3] - '0') < 8) {
+            dst[out++] = (char)((token[i + 1] - '0') * 64 + (token[i + 2] - '0') * 8 + (token[i + 3] - '0'));
+            i += 3;
+        } else {
+            dst[out++] = token[i];
+        }
+    }
+
+    dst[out] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Find the slot of a mount that was already listed
+ * @param mount_id Mount id
+ * @param major Device major number
+ * @param minor Device minor number
+ * @param path Unescaped mount point
+ * @return Slot index, -1 if the mount is new
+ */
+static int find_slot(int mount_id, unsigned int major, unsigned int minor, const char *path) {
+    for (int i = 0; i < MOUNTS_MAX_SLOTS; i++) {
+        const MountSlot *slot = &g_slots[i];
+        if (slot->state != SLOT_FREE && slot->present && slot->mount_id == mount_id &&
+            slot->major == major && slot->minor == minor && strcmp(slot->path, path) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Take a free slot
+ * @return Slot index, -1 if every slot is in use
+ */
+static int alloc_slot(void) {
+    for (int i = 0; i < MOUNTS_MAX_SLOTS; i++) {
+        if (g_slots[i].state == SLOT_FREE) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Rebuild the mount list from the last read of mountinfo, called with g_lock held
+ *
+ * Mounts that are still listed keep their slot and last answer. Slots of
+ * unmounted filesystems are released, except busy ones, which the worker
+ * releases when statvfs returns.
+ */
+static void parse_mountinfo(void) {
+    int keep[MOUNTS_MAX_SLOTS] = { 0 };
+    ProcfsScanner file, line;
+
+    g_num_order = 0;
+    g_dropped = 0;
+    procfs_scan_file(&file, &g_mountinfo);
+
+    // id parent major:minor root mount_point options [optional...] - fstype source super_options
+    while (procfs_next_line(&file, &line)) {
+        uint64_t mount_id, parent, major, minor;
+        const char *root, *point, *options, *tok, *fstype, *source;
+        size_t root_len, point_len, options_len, tok_len, fstype_len, source_len;
+
+        if (!procfs_next_u64(&line, &mount_id) || !procfs_next_u64(&line, &parent) ||
+            !procfs_next_u64(&line, &major) || line.pos >= line.end || *line.pos++ != ':' ||
+            !procfs_next_u64(&line, &minor) ||
+            !procfs_next_token(&line, 0, &root, &root_len) ||
+            !procfs_next_token(&line, 0, &point, &point_len) ||
+            !procfs_next_token(&line, 0, &options, &options_len)) {
+            continue;
+        }
+
+        // Optional fields end at a lone "-"
+        int separated = 0;
+        while (procfs_next_token(&line, 0, &tok, &tok_len)) {
+            if (procfs_token_equals(tok, tok_len, "-")) {
+                separated = 1;
+                break;
+            }
+        }
+        if (!separated || !procfs_next_token(&line, 0, &fstype, &fstype_len) ||
+            !procfs_next_token(&line, 0, &source, &source_len)) {
+            continue;
+        }
+
+        if (is_pseudo_fs(fstype, fstype_len)) {
+            continue;
+        }
+
+        // Bind mounts and repeated mounts of a device are listed once
+        int duplicate = 0;
+        for (int i = 0; i < g_num_order; i++) {
+            const MountSlot *seen = &g_slots[g_order[i]];
+            if (seen->major == major && seen->minor == minor) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (duplicate) {
+            continue;
+        }
+
+        char path[MOUNTS_PATH_LEN];
+        if (!unescape_path(path, sizeof(path), point, point_len)) {
+            continue;
+        }
+
+        if (g_num_order >= RESTRACK_MAX_FILESYSTEMS) {
+            g_dropped++;
+            continue;
+        }
+
+        int index = find_slot((int)mount_id, (unsigned int)major, (unsigned int)minor, path);
+        if (index < 0) {
+            index = alloc_slot();
+            if (index < 0) {
+                g_dropped++;
+                continue;
+            }
+
+            MountSlot *slot = &g_slots[index];
+            memset(slot, 0, sizeof(*slot));
+            slot->state = SLOT_IDLE;
+            slot->present = 1;
+            slot->mount_id = (int)mount_id;
+            slot->major = (unsigned int)major;
+            slot->minor = (unsigned int)minor;
+            memcpy(slot->path, path, sizeof(slot->path));
+            procfs_copy_token(slot->fs.mount_point, sizeof(slot->fs.mount_point), path, strlen(path));
+            procfs_copy_token(slot->fs.fstype, sizeof(slot->fs.fstype), fstype, fstype_len);
+            unescape_path(slot->fs.device, sizeof(slot->fs.device), source, source_len);
+        }
+
+        // Per-mount options start with "ro" or "rw" and may change on remount
+        g_slots[index].fs.readonly = options_len >= 2 && strncmp(options, "ro", 2) == 0 &&
+                                     (options_len == 2 || options[2] == ',');
+        keep[index] = 1;
+        g_order[g_num_order++] = index;
+    }
+
+    for (int i = 0; i < MOUNTS_MAX_SLOTS; i++) {
+        MountSlot *slot = &g_slots[i];
+        if (slot->state == SLOT_FREE || keep[i]) {
+            continue;
+        }
+        slot->present = 0;
+        if (slot->state != SLOT_BUSY) {
+            slot->state = SLOT_FREE;
+        }
+    }
+}
+
+/**
+ * @brief Re-read mountinfo if the mount table changed since the last read
+ * @return ERR_SUCCESS when a mount table is available, error code otherwise
+ */
+static int refresh_mount_table(void) {
+    if (g_have_table && g_mountinfo.fd >= 0) {
+        // The kernel raises POLLPRI once per change of the mount table
+        struct pollfd pfd = { g_mountinfo.fd, POLLPRI, 0 };
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLPRI | POLLERR))) {
+            return ERR_SUCCESS;
+        }
+    }
+
+    int result = procfs_read(&g_mountinfo);
+    if (result != ERR_SUCCESS) {
+        return g_have_table ? ERR_SUCCESS : result;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    parse_mountinfo();
+    pthread_mutex_unlock(&g_lock);
+    g_have_table = 1;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Fill the filesystem table of the disk section
+ * @param timeout_ms Longest time to wait for statvfs answers in this call
+ * @param disk Disk section whose filesystems are replaced
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int mounts_collect(int timeout_ms, restrack_disk_t *disk) {
+    disk->num_filesystems = 0;
+    disk->filesystems_dropped = 0;
+
+    int result = refresh_mount_table();
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    if (!g_conds_ready) {
+        init_conds();
+    }
+
+    // Mounts still busy from an earlier call are not asked again or waited for
+    int wanted[RESTRACK_MAX_FILESYSTEMS];
+    int queued = 0;
+    for (int i = 0; i < g_num_order; i++) {
+        MountSlot *slot = &g_slots[g_order[i]];
+        if (slot->state == SLOT_IDLE) {
+            slot->state = SLOT_QUEUED;
+        }
+        wanted[i] = slot->state == SLOT_QUEUED;
+        queued += wanted[i];
+    }
+
+    // Another worker is only needed when every existing one is stuck
+    if (queued > 0 && g_idle_workers == 0 && g_workers < MOUNTS_MAX_WORKERS &&
+        start_worker() != ERR_SUCCESS && g_workers == 0) {
+        log_message(LOG_WARNING, "Failed to start statvfs worker, filesystem usage unavailable");
+    }
+    pthread_cond_broadcast(&g_work_cond);
+
+    struct timespec deadline;
+    deadline_after(timeout_ms > 0 ? timeout_ms : 0, &deadline);
+    for (;;) {
+        int pending = 0;
+        for (int i = 0; i < g_num_order; i++) {
+            int state = g_slots[g_order[i]].state;
+            if (wanted[i] && (state == SLOT_QUEUED || state == SLOT_BUSY)) {
+                pending = 1;
+                break;
+            }
+        }
+        if (!pending || pthread_cond_timedwait(&g_done_cond, &g_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < g_num_order; i++) {
+        MountSlot *slot = &g_slots[g_order[i]];
+
+        // Filesystems without blocks (e.g. ramfs) have no usage to report
+        if (slot->has_value && slot->fs.total_mb == 0 && slot->fs.inodes_total == 0) {
+            continue;
+        }
+
+        restrack_filesystem_t *fs = &disk->filesystems[disk->num_filesystems++];
+        *fs = slot->fs;
+        fs->responding = slot->state == SLOT_IDLE;
+    }
+    disk->filesystems_dropped = g_dropped;
+    pthread_mutex_unlock(&g_lock);
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Stop the statvfs worker and close /proc/self/mountinfo
+ *
+ * Idle workers leave at once. A worker stuck in statvfs cannot be
+ * interrupted; it keeps its slot and exits when the call returns.
+ */
+void mounts_cleanup(void) {
+    pthread_mutex_lock(&g_lock);
+    if (g_conds_ready) {
+        g_stop = 1;
+        pthread_cond_broadcast(&g_work_cond);
+
+        struct timespec deadline;
+        deadline_after(MOUNTS_STOP_TIMEOUT_MS, &deadline);
+        while (g_workers > g_busy_workers &&
+               pthread_cond_timedwait(&g_done_cond, &g_lock, &deadline) != ETIMEDOUT) {
+        }
+        g_stop = 0;
+    }
+
+    for (int i = 0; i < MOUNTS_MAX_SLOTS; i++) {
+        g_slots[i].present = 0;
+        if (g_slots[i].state != SLOT_BUSY) {
+            g_slots[i].state = SLOT_FREE;
+        }
+    }
+    g_num_order = 0;
+    g_dropped = 0;
+    pthread_mutex_unlock(&g_lock);
+
+    procfs_close(&g_mountinfo);
+    g_have_table = 0;
+}
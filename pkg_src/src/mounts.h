@@ -0,0 +1,32 @@
+/**
+ * @file mounts.h
+ * @brief Usage of every mounted filesystem, with statvfs off the main thread
+ */
+
+#ifndef MOUNTS_H
+#define MOUNTS_H
+
+#include "resources.h"
+
+/**
+ * @brief Fill the filesystem table of the disk section
+ * @param timeout_ms Longest time to wait for statvfs answers in this call
+ * @param disk Disk section whose filesystems are replaced
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * /proc/self/mountinfo is re-parsed only after the kernel flags a change
+ * of the mount table (POLLPRI on the open descriptor). Pseudo
+ * filesystems are left out and each device is listed once. statvfs()
+ * runs on a worker thread; a mount that does not answer within the
+ * timeout is reported with its last values and responding set to 0, and
+ * is skipped until its call returns, so a hung NFS or USB mount cannot
+ * stall collection.
+ */
+int mounts_collect(int timeout_ms, restrack_disk_t *disk);
+
+/**
+ * @brief Stop the statvfs worker and close /proc/self/mountinfo
+ */
+void mounts_cleanup(void);
+
+#endif /* MOUNTS_H */
@@ -0,0 +1,317 @@
+/**
+ * @file netproto.c
+ * @brief IP, TCP and UDP error rates from /proc/net/snmp and /proc/net/netstat
+ */
+
+#include "netproto.h"
+#include "procfs.h"
+
+// Counters read from the two files
+enum {
+    PROTO_IP_REASM_REQDS,
+    PROTO_IP_REASM_FAILS,
+    PROTO_TCP_OUT_SEGS,
+    PROTO_TCP_RETRANS_SEGS,
+    PROTO_TCP_IN_ERRS,
+    PROTO_UDP_IN_DATAGRAMS,
+    PROTO_UDP_IN_ERRORS,
+    PROTO_UDP_RCVBUF_ERRORS,
+    PROTO_TCP_LISTEN_OVERFLOWS,
+    PROTO_TCP_LISTEN_DROPS,
+    PROTO_COUNTERS
+};
+
+// Files the counters come from
+enum {
+    PROTO_FILE_SNMP,
+    PROTO_FILE_NETSTAT,
+    PROTO_FILES
+};
+
+/**
+ * @struct ProtoKey
+ * @brief Where a counter is named: file, line prefix and column header
+ */
+typedef struct {
+    int file;                    // PROTO_FILE_*
+    const char *prefix;          // Text before the colon, e.g. "Tcp"
+    const char *name;            // Column header, e.g. "RetransSegs"
+} ProtoKey;
+
+// Keys of the counters, in PROTO_* order
+static const ProtoKey g_keys[PROTO_COUNTERS] = {
+    { PROTO_FILE_SNMP, "Ip", "ReasmReqds" },
+    { PROTO_FILE_SNMP, "Ip", "ReasmFails" },
+    { PROTO_FILE_SNMP, "Tcp", "OutSegs" },
+    { PROTO_FILE_SNMP, "Tcp", "RetransSegs" },
+    { PROTO_FILE_SNMP, "Tcp", "InErrs" },
+    { PROTO_FILE_SNMP, "Udp", "InDatagrams" },
+    { PROTO_FILE_SNMP, "Udp", "InErrors" },
+    { PROTO_FILE_SNMP, "Udp", "RcvbufErrors" },
+    { PROTO_FILE_NETSTAT, "TcpExt", "ListenOverflows" },
+    { PROTO_FILE_NETSTAT, "TcpExt", "ListenDrops" }
+};
+
+/**
+ * @struct ProtoSlot
+ * @brief Position of one counter within the value lines of a file
+ */
+typedef struct {
+    int line;                    // Line number of the value line
+    int column;                  // Column after the prefix, from 0
+    int counter;                 // PROTO_* counter
+} ProtoSlot;
+
+/**
+ * @struct ProtoTable
+ * @brief One of the two files and its column index
+ *
+ * Slots are ordered by line and then by column, the order in which a
+ * read meets them.
+ */
+typedef struct {
+    ProcfsFile file;
+    ProtoSlot slots[PROTO_COUNTERS];
+    int num_slots;
+    int indexed;                 // Whether slots describe the file
+} ProtoTable;
+
+static ProtoTable g_tables[PROTO_FILES] = {
+    { PROCFS_FILE_INIT_CAP("/proc/net/snmp", 4096), { { 0, 0, 0 } }, 0, 0 },
+    { PROCFS_FILE_INIT_CAP("/proc/net/netstat", 8192), { { 0, 0, 0 } }, 0, 0 }
+};
+
+// Previous reading, for the rates
+static int g_has_prev = 0;
+static unsigned int g_prev_found = 0;
+static uint64_t g_prev_ns = 0;
+static uint64_t g_prev[PROTO_COUNTERS];
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Take the prefix and its colon off a line
+ * @param line Line to advance past the colon
+ * @param prefix Receives the start of the prefix
+ * @param len Receives the length of the prefix
+ * @return 1 on success, 0 if the line has no prefix
+ */
+static int next_prefix(ProcfsScanner *line, const char **prefix, size_t *len) {
+    return procfs_next_token(line, ':', prefix, len) && line->pos < line->end && *line->pos++ == ':';
+}
+
+/**
+ * @brief Record the line and column of each counter of a file
+ * @param table File that was read
+ * @param file PROTO_FILE_* of the table
+ */
+static void build_index(ProtoTable *table, int file) {
+    ProcfsScanner scanner, line;
+    procfs_scan_file(&scanner, &table->file);
+
+    table->num_slots = 0;
+    table->indexed = 1;
+
+    // Header lines are the even ones; the values follow on the next line
+    for (int i = 0; procfs_next_line(&scanner, &line); i++) {
+        const char *prefix;
+        size_t prefix_len;
+        if (i % 2 != 0 || !next_prefix(&line, &prefix, &prefix_len)) {
+            continue;
+        }
+
+        const char *name;
+        size_t name_len;
+        for (int column = 0; procfs_next_token(&line, 0, &name, &name_len); column++) {
+            for (int k = 0; k < PROTO_COUNTERS && table->num_slots < PROTO_COUNTERS; k++) {
+                if (g_keys[k].file == file && procfs_token_equals(prefix, prefix_len, g_keys[k].prefix) &&
+                    procfs_token_equals(name, name_len, g_keys[k].name)) {
+                    ProtoSlot *slot = &table->slots[table->num_slots++];
+                    slot->line = i + 1;
+                    slot->column = column;
+                    slot->counter = k;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Parse the buffer of the last read, through the column index
+ * @param table File that was read
+ * @param values Receives the counters
+ * @param found Receives a bitmask of the counters seen
+ * @return 1 on success, 0 if the index no longer matches the file
+ */
+static int parse_indexed(const ProtoTable *table, uint64_t *values, unsigned int *found) {
+    ProcfsScanner scanner, line;
+    procfs_scan_file(&scanner, &table->file);
+
+    const ProtoSlot *slot = table->slots;
+    const ProtoSlot *end = table->slots + table->num_slots;
+    for (int i = 0; slot < end && procfs_next_line(&scanner, &line); i++) {
+        if (slot->line != i) {
+            continue;
+        }
+
+        const char *prefix;
+        size_t prefix_len;
+        if (!next_prefix(&line, &prefix, &prefix_len) ||
+            !procfs_token_equals(prefix, prefix_len, g_keys[slot->counter].prefix)) {
+            return 0;
+        }
+
+        // Columns in between are skipped unparsed; some are signed, e.g. Tcp MaxConn is -1
+        int column = 0;
+        for (; slot < end && slot->line == i; slot++) {
+            const char *skipped;
+            size_t skipped_len;
+            for (; column < slot->column; column++) {
+                if (!procfs_next_token(&line, 0, &skipped, &skipped_len)) {
+                    return 0;
+                }
+            }
+
+            uint64_t value;
+            if (!procfs_next_u64(&line, &value)) {
+                return 0;
+            }
+            column++;
+            values[slot->counter] = value;
+            *found |= 1u << slot->counter;
+        }
+    }
+    return slot == end;
+}
+
+/**
+ * @brief Read one file into the counters
+ * @param table File to read
+ * @param file PROTO_FILE_* of the table
+ * @param values Receives the counters
+ * @param found Receives a bitmask of the counters seen
+ * @return 1 if the file was read, 0 otherwise
+ */
+static int read_table(ProtoTable *table, int file, uint64_t *values, unsigned int *found) {
+    if (procfs_try_read(&table->file) != ERR_SUCCESS) {
+        return 0;
+    }
+
+    unsigned int table_found = 0;
+    if (!table->indexed || !parse_indexed(table, values, &table_found)) {
+        build_index(table, file);
+        table_found = 0;
+        if (!parse_indexed(table, values, &table_found)) {
+            table->indexed = 0;
+            return 0;
+        }
+    }
+    *found |= table_found;
+    return 1;
+}
+
+/**
+ * @brief Difference between two readings of a counter
+ * @param cur Current reading
+ * @param prev Previous reading
+ * @return The difference, 0 if the counter was reset
+ *
+ * Kernels with a 32-bit unsigned long wrap the counters at 2^32. A value
+ * that went back is taken as such a wrap when the previous reading fits
+ * in 32 bits and the result is plausible.
+ */
+static uint64_t counter_delta(uint64_t cur, uint64_t prev) {
+    if (cur >= prev) {
+        return cur - prev;
+    }
+    if (prev <= UINT32_MAX) {
+        uint64_t wrapped = cur + (UINT64_C(1) << 32) - prev;
+        if (wrapped < (UINT64_C(1) << 31)) {
+            return wrapped;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Read the protocol counters and derive their rates
+ * @param protocols Protocol section to fill
+ * @return ERR_SUCCESS if at least one of the files was read, error code otherwise
+ */
+int netproto_collect(restrack_protocols_t *protocols) {
+    if (protocols == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    uint64_t now_ns = monotonic_ns();
+    uint64_t values[PROTO_COUNTERS] = { 0 };
+    unsigned int found = 0;
+
+    memset(protocols, 0, sizeof(*protocols));
+    protocols->has_snmp = read_table(&g_tables[PROTO_FILE_SNMP], PROTO_FILE_SNMP, values, &found);
+    protocols->has_netstat = read_table(&g_tables[PROTO_FILE_NETSTAT], PROTO_FILE_NETSTAT, values, &found);
+    if (!protocols->has_snmp && !protocols->has_netstat) {
+        g_has_prev = 0;
+        return ERR_FILE_READ;
+    }
+
+    protocols->tcp_retrans_segs = values[PROTO_TCP_RETRANS_SEGS];
+    protocols->tcp_listen_overflows = values[PROTO_TCP_LISTEN_OVERFLOWS];
+    protocols->tcp_listen_drops = values[PROTO_TCP_LISTEN_DROPS];
+    protocols->udp_rcvbuf_errors = values[PROTO_UDP_RCVBUF_ERRORS];
+    protocols->ip_reasm_fails = values[PROTO_IP_REASM_FAILS];
+
+    // Rates need the same counters on both readings
+    if (g_has_prev && now_ns > g_prev_ns && found == g_prev_found) {
+        double elapsed_sec = (now_ns - g_prev_ns) / 1e9;
+        double rates[PROTO_COUNTERS];
+        for (int i = 0; i < PROTO_COUNTERS; i++) {
+            rates[i] = counter_delta(values[i], g_prev[i]) / elapsed_sec;
+        }
+
+        protocols->has_rates = 1;
+        protocols->interval_ms = elapsed_sec * 1000.0;
+        protocols->ip_reasm_reqds_per_sec = rates[PROTO_IP_REASM_REQDS];
+        protocols->ip_reasm_fails_per_sec = rates[PROTO_IP_REASM_FAILS];
+        protocols->tcp_out_segs_per_sec = rates[PROTO_TCP_OUT_SEGS];
+        protocols->tcp_retrans_segs_per_sec = rates[PROTO_TCP_RETRANS_SEGS];
+        protocols->tcp_in_errs_per_sec = rates[PROTO_TCP_IN_ERRS];
+        protocols->tcp_listen_overflows_per_sec = rates[PROTO_TCP_LISTEN_OVERFLOWS];
+        protocols->tcp_listen_drops_per_sec = rates[PROTO_TCP_LISTEN_DROPS];
+        protocols->udp_in_datagrams_per_sec = rates[PROTO_UDP_IN_DATAGRAMS];
+        protocols->udp_in_errors_per_sec = rates[PROTO_UDP_IN_ERRORS];
+        protocols->udp_rcvbuf_errors_per_sec = rates[PROTO_UDP_RCVBUF_ERRORS];
+
+        // Retransmitted segments are counted within OutSegs
+        if (rates[PROTO_TCP_OUT_SEGS] > 0) {
+            protocols->tcp_retrans_percent = 100.0 * rates[PROTO_TCP_RETRANS_SEGS] / rates[PROTO_TCP_OUT_SEGS];
+        }
+    }
+
+    g_has_prev = 1;
+    g_prev_found = found;
+    g_prev_ns = now_ns;
+    memcpy(g_prev, values, sizeof(values));
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close the files and forget the column index
+ */
+void netproto_cleanup(void) {
+    for (int i = 0; i < PROTO_FILES; i++) {
+        procfs_close(&g_tables[i].file);
+        g_tables[i].num_slots = 0;
+        g_tables[i].indexed = 0;
+    }
+    g_has_prev = 0;
+}
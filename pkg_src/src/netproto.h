@@ -0,0 +1,29 @@
+/**
+ * @file netproto.h
+ * @brief IP, TCP and UDP error rates from /proc/net/snmp and /proc/net/netstat
+ */
+
+#ifndef NETPROTO_H
+#define NETPROTO_H
+
+#include "resources.h"
+
+/**
+ * @brief Read the protocol counters and derive their rates
+ * @param protocols Protocol section to fill
+ * @return ERR_SUCCESS if at least one of the files was read, error code otherwise
+ *
+ * Both files come as pairs of lines, a header naming the columns and a
+ * line of values. The first read resolves each counter to a line and a
+ * column, so later reads only skip to those columns and parse integers.
+ * The index is rebuilt when a value line no longer carries the expected
+ * prefix.
+ */
+int netproto_collect(restrack_protocols_t *protocols);
+
+/**
+ * @brief Close the files and forget the column index
+ */
+void netproto_cleanup(void);
+
+#endif /* NETPROTO_H */
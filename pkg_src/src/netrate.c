@@ -0,0 +1,184 @@
+/**
+ * @file netrate.c
+ * @brief Interval interface rates from consecutive counter readings
+ */
+
+#include "netrate.h"
+
+// Slots per table, a power of two at least twice RESTRACK_MAX_INTERFACES
+#define NETRATE_SLOTS 128
+
+// Fastest rate taken as possible when the link speed is unknown, 100 Gbit/s
+#define NETRATE_MAX_BYTES_PER_SEC 12500000000.0
+
+// Smallest Ethernet frame, bounding packets per byte
+#define NETRATE_MIN_FRAME 64
+
+// Counters kept per interface, in this order
+enum {
+    NETRATE_RX_BYTES,
+    NETRATE_RX_PACKETS,
+    NETRATE_RX_ERRORS,
+    NETRATE_RX_DROPPED,
+    NETRATE_TX_BYTES,
+    NETRATE_TX_PACKETS,
+    NETRATE_TX_ERRORS,
+    NETRATE_TX_DROPPED,
+    NETRATE_COUNTERS
+};
+
+/**
+ * @struct IfaceEntry
+ * @brief Counters of one interface from an earlier call
+ */
+typedef struct {
+    int ifindex;                 // 0 marks an empty slot
+    char name[RESTRACK_NAME_LEN];
+    uint64_t read_ns;            // CLOCK_MONOTONIC time of the reading
+    uint64_t counters[NETRATE_COUNTERS];
+} IfaceEntry;
+
+// Open-addressing tables with linear probing: the previous call's and the one being built
+static IfaceEntry g_tables[2][NETRATE_SLOTS];
+static int g_current = 0;
+
+/**
+ * @brief Home slot of an ifindex
+ * @param ifindex Interface index
+ * @return Slot index
+ */
+static size_t home_slot(int ifindex) {
+    return ((uint32_t)ifindex * 2654435761u) & (NETRATE_SLOTS - 1);
+}
+
+/**
+ * @brief Find the slot of an ifindex, or the empty slot where it belongs
+ * @param table Table to search
+ * @param ifindex Interface index, not 0
+ * @return Slot
+ */
+static IfaceEntry* find_slot(IfaceEntry *table, int ifindex) {
+    size_t i = home_slot(ifindex);
+    while (table[i].ifindex != 0 && table[i].ifindex != ifindex) {
+        i = (i + 1) & (NETRATE_SLOTS - 1);
+    }
+    return &table[i];
+}
+
+/**
+ * @brief Difference between two readings of a counter
+ * @param cur Current reading
+ * @param prev Previous reading
+ * @param limit Largest difference possible over the interval
+ * @param delta Receives the difference
+ * @return 1 on success, 0 if the counter was reset
+ *
+ * A counter that went back is taken as a 32-bit wrap when the previous
+ * value fit in 32 bits and the unwrapped difference stays within limit.
+ */
+static int counter_delta(uint64_t cur, uint64_t prev, double limit, uint64_t *delta) {
+    if (cur >= prev) {
+        *delta = cur - prev;
+        return 1;
+    }
+    if (prev <= UINT32_MAX) {
+        uint64_t wrapped = cur + (UINT64_C(1) << 32) - prev;
+        if ((double)wrapped <= limit) {
+            *delta = wrapped;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compute the rates of one interface against its previous counters
+ * @param iface Interface with fresh counters
+ * @param cur Counters of iface, in NETRATE_* order
+ * @param prev Entry of the same interface from the previous call
+ * @param now_ns CLOCK_MONOTONIC time of the fresh counters
+ */
+static void update_rates(restrack_iface_t *iface, const uint64_t *cur, const IfaceEntry *prev, uint64_t now_ns) {
+    if (now_ns <= prev->read_ns) {
+        return;
+    }
+    double elapsed_sec = (double)(now_ns - prev->read_ns) / 1e9;
+
+    // What the link could have carried at most, with room for bursts and bonding
+    double max_bytes = (iface->speed_mbps > 0 ? iface->speed_mbps * 125000.0 * 2.0 : NETRATE_MAX_BYTES_PER_SEC) *
+                       elapsed_sec;
+    double max_packets = max_bytes / NETRATE_MIN_FRAME;
+
+    uint64_t delta[NETRATE_COUNTERS];
+    for (int i = 0; i < NETRATE_COUNTERS; i++) {
+        int is_bytes = i == NETRATE_RX_BYTES || i == NETRATE_TX_BYTES;
+        if (!counter_delta(cur[i], prev->counters[i], is_bytes ? max_bytes : max_packets, &delta[i])) {
+            return;
+        }
+    }
+
+    iface->has_rates = 1;
+    iface->interval_ms = elapsed_sec * 1000.0;
+    iface->rx_rate.bits_per_sec = delta[NETRATE_RX_BYTES] * 8.0 / elapsed_sec;
+    iface->rx_rate.packets_per_sec = delta[NETRATE_RX_PACKETS] / elapsed_sec;
+    iface->rx_rate.errors_per_sec = delta[NETRATE_RX_ERRORS] / elapsed_sec;
+    iface->rx_rate.dropped_per_sec = delta[NETRATE_RX_DROPPED] / elapsed_sec;
+    iface->tx_rate.bits_per_sec = delta[NETRATE_TX_BYTES] * 8.0 / elapsed_sec;
+    iface->tx_rate.packets_per_sec = delta[NETRATE_TX_PACKETS] / elapsed_sec;
+    iface->tx_rate.errors_per_sec = delta[NETRATE_TX_ERRORS] / elapsed_sec;
+    iface->tx_rate.dropped_per_sec = delta[NETRATE_TX_DROPPED] / elapsed_sec;
+}
+
+/**
+ * @brief Turn the cumulative counters of a network section into interval rates
+ * @param network Network section holding freshly read counters; its rates are filled
+ */
+void netrate_update(restrack_network_t *network) {
+    if (network == NULL) {
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    IfaceEntry *prev_table = g_tables[g_current];
+    IfaceEntry *next_table = g_tables[g_current ^ 1];
+    memset(next_table, 0, sizeof(g_tables[0]));
+
+    for (int i = 0; i < network->num_interfaces; i++) {
+        restrack_iface_t *iface = &network->interfaces[i];
+        iface->has_rates = 0;
+        if (iface->ifindex <= 0) {
+            continue;
+        }
+
+        const uint64_t cur[NETRATE_COUNTERS] = {
+            iface->rx.bytes, iface->rx.packets, iface->rx.errors, iface->rx.dropped,
+            iface->tx.bytes, iface->tx.packets, iface->tx.errors, iface->tx.dropped
+        };
+
+        // An index reused by a recreated interface starts over
+        const IfaceEntry *prev = find_slot(prev_table, iface->ifindex);
+        if (prev->ifindex != 0 && strcmp(prev->name, iface->name) == 0) {
+            update_rates(iface, cur, prev, now_ns);
+        }
+
+        IfaceEntry *entry = find_slot(next_table, iface->ifindex);
+        entry->ifindex = iface->ifindex;
+        memcpy(entry->name, iface->name, sizeof(entry->name));
+        entry->read_ns = now_ns;
+        memcpy(entry->counters, cur, sizeof(entry->counters));
+    }
+
+    // Interfaces that disappeared are left behind in the old table
+    g_current ^= 1;
+}
+
+/**
+ * @brief Forget the remembered counters
+ */
+void netrate_reset(void) {
+    memset(g_tables, 0, sizeof(g_tables));
+    g_current = 0;
+}
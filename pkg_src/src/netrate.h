@@ -0,0 +1,29 @@
+/**
+ * @file netrate.h
+ * @brief Interval interface rates from consecutive counter readings
+ */
+
+#ifndef NETRATE_H
+#define NETRATE_H
+
+#include "resources.h"
+
+/**
+ * @brief Turn the cumulative counters of a network section into interval rates
+ * @param network Network section holding freshly read counters; its rates are filled
+ *
+ * The counters of every interface are remembered until the next call in
+ * a hash table keyed by ifindex, together with the CLOCK_MONOTONIC time
+ * they were read at. An interface that is new, was recreated, or whose
+ * counters were reset reports no rates until its next reading. Counters
+ * of drivers that only keep 32 bits are unwrapped when the resulting rate
+ * is possible over the time between the two readings.
+ */
+void netrate_update(restrack_network_t *network);
+
+/**
+ * @brief Forget the remembered counters
+ */
+void netrate_reset(void);
+
+#endif /* NETRATE_H */
@@ -0,0 +1,176 @@
+/**
+ * @file procfs.c
+ * @brief Persistent procfs file readers for resource collectors
+ */
+
+#include "procfs.h"
+#include "util.h"
+
+// Initial buffer size, enough for most procfs files on small systems
+#define PROCFS_INITIAL_CAP 4096
+
+/**
+ * @brief Read the file from offset 0 until EOF, growing the buffer
+ * @param file Open file
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_whole(ProcfsFile *file) {
+    file->len = 0;
+
+    for (;;) {
+        // Always keep room for the terminating NUL
+        if (file->buf == NULL || file->len + 1 >= file->cap) {
+            // A cap set before the first read is used as a size hint
+            size_t new_cap = file->buf == NULL ? (file->cap ? file->cap : PROCFS_INITIAL_CAP) : file->cap * 2;
+            char *new_buf = (char*)realloc(file->buf, new_cap);
+            if (new_buf == NULL) {
+                return ERR_MEMORY_ALLOC;
+            }
+            file->buf = new_buf;
+            file->cap = new_cap;
+        }
+
+        ssize_t n = pread(file->fd, file->buf + file->len, file->cap - 1 - file->len, file->len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERR_FILE_READ;
+        }
+        if (n == 0) {
+            break;
+        }
+        file->len += n;
+    }
+
+    file->buf[file->len] = '\0';
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Open the file if needed and read it, retrying once on a stale descriptor
+ * @param file File to read
+ * @param log_errors Whether failures are logged
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int read_procfs_file(ProcfsFile *file, int log_errors) {
+    if (file == NULL || file->path == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    // One retry with a fresh descriptor covers files that went stale
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (file->fd < 0) {
+            file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+            if (file->fd < 0) {
+                if (log_errors) {
+                    log_message(LOG_ERROR, "Failed to open %s: %s", file->path, strerror(errno));
+                }
+                return ERR_FILE_OPEN;
+            }
+        }
+
+        int result = read_whole(file);
+        if (result != ERR_FILE_READ) {
+            return result;
+        }
+
+        close(file->fd);
+        file->fd = -1;
+    }
+
+    if (log_errors) {
+        log_message(LOG_ERROR, "Failed to read %s: %s", file->path, strerror(errno));
+    }
+    return ERR_FILE_READ;
+}
+
+/**
+ * @brief Re-read the whole file into its buffer
+ * @param file File to read; opened on first use and reopened after errors
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int procfs_read(ProcfsFile *file) {
+    return read_procfs_file(file, 1);
+}
+
+/**
+ * @brief Re-read the whole file into its buffer without logging failures
+ * @param file File to read; opened on first use and reopened after errors
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * For files that are expected to vanish or be unreadable, such as those
+ * under /proc/<pid>.
+ */
+int procfs_try_read(ProcfsFile *file) {
+    return read_procfs_file(file, 0);
+}
+
+/**
+ * @brief Close the descriptor and release the buffer
+ * @param file File to close
+ */
+void procfs_close(ProcfsFile *file) {
+    if (file == NULL) {
+        return;
+    }
+
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    free(file->buf);
+    file->buf = NULL;
+    file->cap = 0;
+    file->len = 0;
+}
+
+/**
+ * @brief Close the descriptor but keep the buffer
+ * @param file File to close; the next read opens it again
+ */
+void procfs_close_fd(ProcfsFile *file) {
+    if (file != NULL && file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+}
+
+/**
+ * @brief Parse consecutive unsigned integers
+ * @param scanner Scanner to advance
+ * @param values Receives the values
+ * @param max Capacity of values; further numbers are skipped
+ * @return Number of integers found, which may exceed max
+ */
+size_t procfs_next_u64s(ProcfsScanner *scanner, uint64_t *values, size_t max) {
+    size_t count = 0;
+    uint64_t value;
+
+    while (procfs_next_u64(scanner, &value)) {
+        if (count < max) {
+            values[count] = value;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Copy a token into a fixed buffer, truncating if needed
+ * @param dst Destination buffer
+ * @param size Size of the destination buffer
+ * @param token Start of the token
+ * @param len Length of the token
+ */
+void procfs_copy_token(char *dst, size_t size, const char *token, size_t len) {
+    if (size == 0) {
+        return;
+    }
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, token, len);
+    dst[len] = '\0';
+}
@@ -0,0 +1,193 @@
+/**
+ * @file procfs.h
+ * @brief Persistent procfs file readers for resource collectors
+ */
+
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include "sysmon.h"
+#include <stdint.h>
+
+/**
+ * @struct ProcfsFile
+ * @brief A procfs file kept open between ticks
+ *
+ * The descriptor is opened once and the whole file is re-read from offset
+ * 0 with pread() into a buffer that only grows. After the initial growth
+ * a read costs no open/close and no allocation.
+ */
+typedef struct {
+    const char *path;            // Path of the procfs file
+    int fd;                      // Descriptor, -1 until first read
+    char *buf;                   // Contents of the last read, NUL terminated
+    size_t cap;                  // Allocated size of buf, or initial size hint while buf is NULL
+    size_t len;                  // Bytes read by the last read
+} ProcfsFile;
+
+// Static initializer for a closed ProcfsFile
+#define PROCFS_FILE_INIT(p) { (p), -1, NULL, 0, 0 }
+
+// Same, with the initial buffer size for small files such as /proc/<pid>/stat
+#define PROCFS_FILE_INIT_CAP(p, cap) { (p), -1, NULL, (cap), 0 }
+
+/**
+ * @struct ProcfsScanner
+ * @brief Read-only cursor over a span of a procfs buffer
+ *
+ * The scanner never copies or modifies the buffer and never allocates, so
+ * one pass over a file costs only the bytes it touches. Lines of any
+ * length and any number of columns are handled.
+ */
+typedef struct {
+    const char *pos;             // Next byte to look at
+    const char *end;             // One past the last byte of the span
+} ProcfsScanner;
+
+/**
+ * @brief Start scanning the contents of the last procfs_read()
+ * @param scanner Scanner to initialise
+ * @param file File that was read
+ */
+static inline void procfs_scan_file(ProcfsScanner *scanner, const ProcfsFile *file) {
+    scanner->pos = file->buf;
+    scanner->end = file->buf + file->len;
+}
+
+/**
+ * @brief Split the next line off a scanner
+ * @param scanner Scanner over a buffer, advanced past the line
+ * @param line Receives a scanner over the line without its newline
+ * @return 1 if a line was returned, 0 at the end of the buffer
+ */
+static inline int procfs_next_line(ProcfsScanner *scanner, ProcfsScanner *line) {
+    if (scanner->pos >= scanner->end) {
+        return 0;
+    }
+
+    // memchr is the vectorized newline search of the C library
+    const char *nl = (const char*)memchr(scanner->pos, '\n', scanner->end - scanner->pos);
+    line->pos = scanner->pos;
+    line->end = nl != NULL ? nl : scanner->end;
+    scanner->pos = nl != NULL ? nl + 1 : scanner->end;
+    return 1;
+}
+
+/**
+ * @brief Skip spaces and tabs
+ * @param scanner Scanner to advance
+ */
+static inline void procfs_skip_space(ProcfsScanner *scanner) {
+    while (scanner->pos < scanner->end && (*scanner->pos == ' ' || *scanner->pos == '\t')) {
+        scanner->pos++;
+    }
+}
+
+/**
+ * @brief Parse the next unsigned decimal integer
+ * @param scanner Scanner to advance
+ * @param value Receives the value
+ * @return 1 if a number was parsed, 0 if the next token is not a number
+ */
+static inline int procfs_next_u64(ProcfsScanner *scanner, uint64_t *value) {
+    procfs_skip_space(scanner);
+
+    const char *p = scanner->pos;
+    uint64_t v = 0;
+    while (p < scanner->end && (unsigned)(*p - '0') < 10) {
+        v = v * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    if (p == scanner->pos) {
+        return 0;
+    }
+
+    scanner->pos = p;
+    *value = v;
+    return 1;
+}
+
+/**
+ * @brief Return the next run of characters up to whitespace or a delimiter
+ * @param scanner Scanner to advance
+ * @param delim Extra character ending the token (e.g. ':'), or 0 for none
+ * @param token Receives the start of the token
+ * @param len Receives the length of the token
+ * @return 1 if a non-empty token was found, 0 otherwise
+ */
+static inline int procfs_next_token(ProcfsScanner *scanner, char delim, const char **token, size_t *len) {
+    procfs_skip_space(scanner);
+
+    const char *p = scanner->pos;
+    while (p < scanner->end && *p != ' ' && *p != '\t' && *p != delim) {
+        p++;
+    }
+    if (p == scanner->pos) {
+        return 0;
+    }
+
+    *token = scanner->pos;
+    *len = p - scanner->pos;
+    scanner->pos = p;
+    return 1;
+}
+
+/**
+ * @brief Check whether a token equals a NUL-terminated string
+ * @param token Start of the token
+ * @param len Length of the token
+ * @param str String to compare with
+ * @return 1 if equal, 0 otherwise
+ */
+static inline int procfs_token_equals(const char *token, size_t len, const char *str) {
+    return strncmp(token, str, len) == 0 && str[len] == '\0';
+}
+
+/**
+ * @brief Parse consecutive unsigned integers
+ * @param scanner Scanner to advance
+ * @param values Receives the values
+ * @param max Capacity of values; further numbers are skipped
+ * @return Number of integers found, which may exceed max
+ */
+size_t procfs_next_u64s(ProcfsScanner *scanner, uint64_t *values, size_t max);
+
+/**
+ * @brief Copy a token into a fixed buffer, truncating if needed
+ * @param dst Destination buffer
+ * @param size Size of the destination buffer
+ * @param token Start of the token
+ * @param len Length of the token
+ */
+void procfs_copy_token(char *dst, size_t size, const char *token, size_t len);
+
+/**
+ * @brief Re-read the whole file into its buffer
+ * @param file File to read; opened on first use and reopened after errors
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int procfs_read(ProcfsFile *file);
+
+/**
+ * @brief Re-read the whole file into its buffer without logging failures
+ * @param file File to read; opened on first use and reopened after errors
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int procfs_try_read(ProcfsFile *file);
+
+/**
+ * @brief Close the descriptor and release the buffer
+ * @param file File to close
+ */
+void procfs_close(ProcfsFile *file);
+
+/**
+ * @brief Close the descriptor but keep the buffer
+ * @param file File to close; the next read opens it again
+ *
+ * For files read too rarely or in too great a number to hold a
+ * descriptor each.
+ */
+void procfs_close_fd(ProcfsFile *file);
+
+#endif /* PROCFS_H */
@@ -0,0 +1,507 @@
+/**
+ * @file proctop.c
+ * @brief Per-process CPU, memory and IO tracking with top-N selection
+ */
+
+#include "proctop.h"
+#include "procfs.h"
+#include "util.h"
+#include <sys/resource.h>
+
+// Initial number of PID table slots, a power of two
+#define PROCTOP_INITIAL_SLOTS 256
+
+// Buffer sizes for the per-process files, far below the procfs default
+#define PROCTOP_STAT_CAP 512
+#define PROCTOP_IO_CAP 256
+
+// Most stat descriptors kept open, and the share of RLIMIT_NOFILE they may take
+#define PROCTOP_MAX_CACHED_FDS 512
+#define PROCTOP_FD_SHARE 4
+
+/**
+ * @struct ProcEntry
+ * @brief A process tracked across passes
+ *
+ * The stat file stays open for the lifetime of the process while the
+ * descriptor budget allows, so a known process costs one pread() for it.
+ * Past the budget, and for io in every case, a read opens and closes the
+ * file, keeping only its buffer.
+ */
+typedef struct {
+    int pid;
+    unsigned int generation;     // Last pass that read the process
+    uint64_t start_time;         // Clock ticks after boot, tells a reused PID apart
+    uint64_t cpu_ticks;          // utime + stime at the last pass
+    int primed;                  // Whether cpu_ticks and io counters are a valid baseline
+    int io_denied;               // /proc/<pid>/io is not readable by us
+    int cached;                  // Whether stat stays open between passes
+    char stat_path[32];
+    char io_path[32];
+    ProcfsFile stat;
+    ProcfsFile io;
+    restrack_proc_t info;        // Values of the last pass
+} ProcEntry;
+
+// Open-addressing PID table with linear probing, at most half full
+static ProcEntry **g_slots = NULL;
+static size_t g_num_slots = 0;
+static size_t g_num_entries = 0;
+
+static unsigned int g_generation = 0;
+static uint64_t g_pass_ns = 0;           // CLOCK_MONOTONIC time of the current pass
+static double g_elapsed_sec = 0.0;       // Time since the previous pass
+static uint64_t g_boot_ticks = 0;        // Clock ticks since boot at the current pass
+static uint64_t g_prev_boot_ticks = 0;   // Same, at the previous pass
+static long g_clock_ticks = 100;
+static long g_page_kb = 4;
+
+// Stat descriptors that may stay open, and the entries holding one
+static int g_fd_budget = 0;
+static int g_cached_fds = 0;
+
+/**
+ * @brief Home slot of a PID
+ * @param pid Process id
+ * @return Slot index
+ */
+static size_t home_slot(int pid) {
+    return ((uint32_t)pid * 2654435761u) & (g_num_slots - 1);
+}
+
+/**
+ * @brief Find the slot holding a PID, or the empty slot where it belongs
+ * @param pid Process id
+ * @return Pointer to the slot
+ */
+static ProcEntry **find_slot(int pid) {
+    size_t i = home_slot(pid);
+    while (g_slots[i] != NULL && g_slots[i]->pid != pid) {
+        i = (i + 1) & (g_num_slots - 1);
+    }
+    return &g_slots[i];
+}
+
+/**
+ * @brief Double the PID table and re-insert every entry
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int grow_table(void) {
+    size_t new_num = g_num_slots ? g_num_slots * 2 : PROCTOP_INITIAL_SLOTS;
+    ProcEntry **new_slots = (ProcEntry**)calloc(new_num, sizeof(*new_slots));
+    if (new_slots == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+
+    ProcEntry **old_slots = g_slots;
+    size_t old_num = g_num_slots;
+    g_slots = new_slots;
+    g_num_slots = new_num;
+
+    for (size_t i = 0; i < old_num; i++) {
+        if (old_slots[i] != NULL) {
+            *find_slot(old_slots[i]->pid) = old_slots[i];
+        }
+    }
+    free(old_slots);
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Empty a slot, shifting later entries of its probe chain back
+ * @param i Slot to empty
+ *
+ * Backward-shift deletion keeps every chain contiguous without tombstones.
+ */
+static void remove_slot(size_t i) {
+    size_t mask = g_num_slots - 1;
+    size_t j = i;
+
+    for (;;) {
+        j = (j + 1) & mask;
+        if (g_slots[j] == NULL) {
+            break;
+        }
+        // The entry at j may fill the hole if the hole lies between its home and j
+        size_t home = home_slot(g_slots[j]->pid);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            g_slots[i] = g_slots[j];
+            i = j;
+        }
+    }
+    g_slots[i] = NULL;
+}
+
+/**
+ * @brief Close the files of a process and free it
+ * @param entry Entry to release
+ */
+static void free_entry(ProcEntry *entry) {
+    if (entry->cached) {
+        g_cached_fds--;
+    }
+    procfs_close(&entry->stat);
+    procfs_close(&entry->io);
+    free(entry);
+}
+
+/**
+ * @brief Parse /proc/<pid>/io for the storage byte counters
+ * @param entry Process whose io file was just read
+ * @param read_bytes Receives read_bytes
+ * @param write_bytes Receives write_bytes
+ */
+static void parse_io(const ProcEntry *entry, uint64_t *read_bytes, uint64_t *write_bytes) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &entry->io);
+
+    while (procfs_next_line(&file, &line)) {
+        const char *key;
+        size_t key_len;
+        if (!procfs_next_token(&line, ':', &key, &key_len) || line.pos >= line.end) {
+            continue;
+        }
+        line.pos++;
+
+        if (procfs_token_equals(key, key_len, "read_bytes")) {
+            procfs_next_u64(&line, read_bytes);
+        } else if (procfs_token_equals(key, key_len, "write_bytes")) {
+            procfs_next_u64(&line, write_bytes);
+        }
+    }
+}
+
+/**
+ * @brief Re-read a process and derive its interval figures
+ * @param entry Process to update
+ * @return ERR_SUCCESS on success, error code if the process is gone
+ */
+static int update_entry(ProcEntry *entry) {
+    int result = procfs_try_read(&entry->stat);
+    if (!entry->cached) {
+        procfs_close_fd(&entry->stat);
+    }
+    if (result != ERR_SUCCESS) {
+        return ERR_FILE_READ;
+    }
+
+    // "pid (comm) state ..." where comm may itself contain spaces and ')'
+    const char *buf = entry->stat.buf;
+    const char *end = buf + entry->stat.len;
+    const char *open_paren = (const char*)memchr(buf, '(', entry->stat.len);
+    const char *close_paren = end;
+    while (close_paren > buf && *--close_paren != ')') {
+    }
+    if (open_paren == NULL || close_paren <= open_paren) {
+        return ERR_FILE_READ;
+    }
+
+    restrack_proc_t *info = &entry->info;
+    info->pid = entry->pid;
+    procfs_copy_token(info->name, sizeof(info->name), open_paren + 1, close_paren - open_paren - 1);
+
+    // Fields after comm, numbered as in proc(5); some of them may be negative
+    uint64_t utime = 0, stime = 0, threads = 0, start_time = 0, rss_pages = 0;
+    ProcfsScanner line = { close_paren + 1, end };
+    const char *token;
+    size_t token_len;
+    for (int field = 3; field <= 24 && procfs_next_token(&line, 0, &token, &token_len); field++) {
+        ProcfsScanner number = { token, token + token_len };
+        switch (field) {
+            case 3:  info->state = token[0]; break;
+            case 14: procfs_next_u64(&number, &utime); break;
+            case 15: procfs_next_u64(&number, &stime); break;
+            case 20: procfs_next_u64(&number, &threads); break;
+            case 22: procfs_next_u64(&number, &start_time); break;
+            case 24: procfs_next_u64(&number, &rss_pages); break;
+            default: break;
+        }
+    }
+
+    // A different start time means the PID was reused by a new process
+    if (entry->primed && start_time != entry->start_time) {
+        entry->primed = 0;
+        entry->io_denied = 0;
+        procfs_close(&entry->io);
+    }
+
+    info->threads = threads;
+    info->rss_kb = rss_pages * g_page_kb;
+
+    // CPU share since the previous pass; a process born during the
+    // interval is charged from zero, one seen for the first time otherwise
+    // gets its baseline now
+    uint64_t cpu_ticks = utime + stime;
+    uint64_t base = cpu_ticks;
+    if (entry->primed) {
+        base = entry->cpu_ticks;
+    } else if (g_prev_boot_ticks > 0 && start_time >= g_prev_boot_ticks) {
+        base = 0;
+    }
+    info->cpu_percent = g_elapsed_sec > 0 && cpu_ticks >= base
+        ? 100.0 * (double)(cpu_ticks - base) / g_clock_ticks / g_elapsed_sec : 0.0;
+
+    // Storage IO; only readable for our own processes unless running as root
+    int had_io = entry->primed && info->has_io;
+    uint64_t prev_read = info->read_bytes;
+    uint64_t prev_write = info->write_bytes;
+    info->has_io = 0;
+    info->read_bytes_per_sec = 0.0;
+    info->write_bytes_per_sec = 0.0;
+    if (!entry->io_denied) {
+        int io_result = procfs_try_read(&entry->io);
+        int io_errno = errno;
+        procfs_close_fd(&entry->io);
+        errno = io_errno;
+        if (io_result == ERR_SUCCESS) {
+            parse_io(entry, &info->read_bytes, &info->write_bytes);
+            info->has_io = 1;
+            if (had_io && g_elapsed_sec > 0) {
+                if (info->read_bytes >= prev_read) {
+                    info->read_bytes_per_sec = (info->read_bytes - prev_read) / g_elapsed_sec;
+                }
+                if (info->write_bytes >= prev_write) {
+                    info->write_bytes_per_sec = (info->write_bytes - prev_write) / g_elapsed_sec;
+                }
+            }
+        } else if (errno == EACCES || errno == EPERM) {
+            entry->io_denied = 1;
+        }
+    }
+
+    entry->start_time = start_time;
+    entry->cpu_ticks = cpu_ticks;
+    entry->primed = 1;
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Size the stat descriptor budget from the soft descriptor limit
+ *
+ * The budget leaves most of RLIMIT_NOFILE to the other collectors, the
+ * journal and the connections of the runner.
+ */
+static void set_fd_budget(void) {
+    struct rlimit limit;
+    g_fd_budget = PROCTOP_MAX_CACHED_FDS;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur / PROCTOP_FD_SHARE < (rlim_t)g_fd_budget) {
+        g_fd_budget = (int)(limit.rlim_cur / PROCTOP_FD_SHARE);
+    }
+}
+
+/**
+ * @brief Start a pass over the processes in /proc
+ */
+void proctop_begin(void) {
+    if (g_slots == NULL) {
+        g_clock_ticks = sysconf(_SC_CLK_TCK);
+        g_page_kb = sysconf(_SC_PAGESIZE) / 1024;
+        if (g_clock_ticks <= 0) {
+            g_clock_ticks = 100;
+        }
+        set_fd_budget();
+        if (grow_table() != ERR_SUCCESS) {
+            log_message(LOG_ERROR, "Failed to allocate process table");
+            return;
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    g_elapsed_sec = g_pass_ns > 0 ? (double)(now_ns - g_pass_ns) / 1e9 : 0.0;
+    g_pass_ns = now_ns;
+
+    // Start times in /proc/<pid>/stat count clock ticks since boot
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    g_prev_boot_ticks = g_boot_ticks;
+    g_boot_ticks = (uint64_t)ts.tv_sec * g_clock_ticks + (uint64_t)ts.tv_nsec * g_clock_ticks / 1000000000ULL;
+
+    g_generation++;
+}
+
+/**
+ * @brief Refresh one process during a pass
+ * @param pid Process id found in /proc
+ */
+void proctop_visit(int pid) {
+    if (g_slots == NULL) {
+        return;
+    }
+    if ((g_num_entries + 1) * 2 > g_num_slots && grow_table() != ERR_SUCCESS) {
+        return;
+    }
+
+    ProcEntry **slot = find_slot(pid);
+    ProcEntry *entry = *slot;
+    if (entry == NULL) {
+        entry = (ProcEntry*)calloc(1, sizeof(ProcEntry));
+        if (entry == NULL) {
+            return;
+        }
+        entry->pid = pid;
+        snprintf(entry->stat_path, sizeof(entry->stat_path), "/proc/%d/stat", pid);
+        snprintf(entry->io_path, sizeof(entry->io_path), "/proc/%d/io", pid);
+        ProcfsFile stat = PROCFS_FILE_INIT_CAP(entry->stat_path, PROCTOP_STAT_CAP);
+        ProcfsFile io = PROCFS_FILE_INIT_CAP(entry->io_path, PROCTOP_IO_CAP);
+        entry->stat = stat;
+        entry->io = io;
+        entry->cached = g_cached_fds < g_fd_budget;
+        if (entry->cached) {
+            g_cached_fds++;
+        }
+        *slot = entry;
+        g_num_entries++;
+    }
+
+    // Entries that cannot be read keep an old generation and are swept
+    if (update_entry(entry) == ERR_SUCCESS) {
+        entry->generation = g_generation;
+    }
+}
+
+/**
+ * @brief Sift an entry down a min-heap keyed by a ranking value
+ * @param heap Heap of entries
+ * @param keys Ranking value of each heap entry
+ * @param count Number of entries in the heap
+ * @param index Index to sift down
+ */
+static void sift_down(const ProcEntry **heap, double *keys, int count, int index) {
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < count && keys[left] < keys[smallest]) {
+            smallest = left;
+        }
+        if (right < count && keys[right] < keys[smallest]) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            return;
+        }
+
+        const ProcEntry *entry = heap[index];
+        double key = keys[index];
+        heap[index] = heap[smallest];
+        keys[index] = keys[smallest];
+        heap[smallest] = entry;
+        keys[smallest] = key;
+        index = smallest;
+    }
+}
+
+/**
+ * @brief Pick the n largest processes by a ranking value
+ * @param n Number of processes to pick, at most RESTRACK_MAX_TOP
+ * @param by_memory Rank by RSS instead of CPU share
+ * @param out Receives the picked processes, largest first
+ * @return Number of processes picked
+ *
+ * A size-n min-heap holds the best candidates seen so far, so a pass
+ * over P processes costs O(P log n) and no full sort is needed.
+ */
+static int select_top(int n, int by_memory, restrack_proc_t *out) {
+    const ProcEntry *heap[RESTRACK_MAX_TOP];
+    double keys[RESTRACK_MAX_TOP];
+    int count = 0;
+
+    for (size_t i = 0; i < g_num_slots; i++) {
+        const ProcEntry *entry = g_slots[i];
+        if (entry == NULL) {
+            continue;
+        }
+        double key = by_memory ? (double)entry->info.rss_kb : entry->info.cpu_percent;
+
+        if (count < n) {
+            // Fill phase: append, then restore the heap once it is full
+            heap[count] = entry;
+            keys[count] = key;
+            if (++count == n) {
+                for (int k = n / 2 - 1; k >= 0; k--) {
+                    sift_down(heap, keys, count, k);
+                }
+            }
+        } else if (key > keys[0]) {
+            heap[0] = entry;
+            keys[0] = key;
+            sift_down(heap, keys, count, 0);
+        }
+    }
+
+    if (count < n) {
+        for (int k = count / 2 - 1; k >= 0; k--) {
+            sift_down(heap, keys, count, k);
+        }
+    }
+
+    // Pop the smallest into the back so the output ends up largest first
+    int picked = count;
+    while (count > 0) {
+        out[count - 1] = heap[0]->info;
+        count--;
+        heap[0] = heap[count];
+        keys[0] = keys[count];
+        sift_down(heap, keys, count, 0);
+    }
+
+    return picked;
+}
+
+/**
+ * @brief End a pass: forget exited processes and pick the top N
+ * @param top_n Number of processes to report per ranking
+ * @param processes Process section receiving the rankings
+ */
+void proctop_finish(int top_n, restrack_process_t *processes) {
+    processes->num_top_cpu = 0;
+    processes->num_top_memory = 0;
+    if (g_slots == NULL) {
+        return;
+    }
+
+    // Drop processes not seen in this pass; a shifted-in entry is re-checked
+    for (size_t i = 0; i < g_num_slots; ) {
+        ProcEntry *entry = g_slots[i];
+        if (entry != NULL && entry->generation != g_generation) {
+            free_entry(entry);
+            remove_slot(i);
+            g_num_entries--;
+            continue;
+        }
+        i++;
+    }
+
+    if (top_n > RESTRACK_MAX_TOP) {
+        top_n = RESTRACK_MAX_TOP;
+    }
+    if (top_n <= 0) {
+        return;
+    }
+
+    processes->num_top_cpu = select_top(top_n, 0, processes->top_cpu);
+    processes->num_top_memory = select_top(top_n, 1, processes->top_memory);
+}
+
+/**
+ * @brief Close every tracked process and release the PID table
+ */
+void proctop_cleanup(void) {
+    for (size_t i = 0; i < g_num_slots; i++) {
+        if (g_slots[i] != NULL) {
+            free_entry(g_slots[i]);
+        }
+    }
+    free(g_slots);
+    g_slots = NULL;
+    g_num_slots = 0;
+    g_num_entries = 0;
+    g_cached_fds = 0;
+    g_pass_ns = 0;
+    g_boot_ticks = 0;
+    g_prev_boot_ticks = 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file proctop.h
+ * @brief Per-process CPU, memory and IO tracking with top-N selection
+ */
+
+#ifndef PROCTOP_H
+#define PROCTOP_H
+
+#include "resources.h"
+
+/**
+ * @brief Start a pass over the processes in /proc
+ */
+void proctop_begin(void);
+
+/**
+ * @brief Refresh one process during a pass
+ * @param pid Process id found in /proc
+ *
+ * Processes already known from earlier passes re-read /proc/<pid>/stat
+ * through a descriptor kept open while the budget allows, and open io for
+ * each read; new ones are added to the PID table.
+ */
+void proctop_visit(int pid);
+
+/**
+ * @brief End a pass: forget exited processes and pick the top N
+ * @param top_n Number of processes to report per ranking
+ * @param processes Process section receiving the rankings
+ */
+void proctop_finish(int top_n, restrack_process_t *processes);
+
+/**
+ * @brief Close every tracked process and release the PID table
+ */
+void proctop_cleanup(void);
+
+#endif /* PROCTOP_H */
@@ -0,0 +1,202 @@
+/**
+ * @file psi.c
+ * @brief Pressure stall information and kernel PSI triggers
+ */
+
+#include "psi.h"
+#include "procfs.h"
+#include "util.h"
+
+// Pressure files, indexed by SysmonPsiResource
+static ProcfsFile g_pressure_files[SYSMON_PSI_COUNT] = {
+    PROCFS_FILE_INIT_CAP("/proc/pressure/cpu", 256),
+    PROCFS_FILE_INIT_CAP("/proc/pressure/memory", 256),
+    PROCFS_FILE_INIT_CAP("/proc/pressure/io", 256)
+};
+
+// Descriptors holding the kernel triggers, -1 for none
+static int g_trigger_fds[SYSMON_PSI_COUNT] = { -1, -1, -1 };
+
+// Resources whose trigger fired since the last psi_read()
+static unsigned int g_fired = 0;
+
+/**
+ * @brief Parse a fixed-point number such as "12.34"
+ * @param scanner Scanner to advance
+ * @param value Receives the value
+ * @return 1 if a number was parsed, 0 otherwise
+ */
+static int next_fixed(ProcfsScanner *scanner, double *value) {
+    uint64_t whole;
+    if (!procfs_next_u64(scanner, &whole)) {
+        return 0;
+    }
+
+    double fraction = 0.0;
+    double scale = 0.1;
+    if (scanner->pos < scanner->end && *scanner->pos == '.') {
+        scanner->pos++;
+        while (scanner->pos < scanner->end && (unsigned)(*scanner->pos - '0') < 10) {
+            fraction += (*scanner->pos - '0') * scale;
+            scale /= 10.0;
+            scanner->pos++;
+        }
+    }
+
+    *value = (double)whole + fraction;
+    return 1;
+}
+
+/**
+ * @brief Parse "avg10=0.00 avg60=0.00 avg300=0.00 total=0" after the line kind
+ * @param line Scanner over the rest of the line
+ * @param psi Receives the values
+ * @return 1 if every field was found, 0 otherwise
+ */
+static int parse_psi_line(ProcfsScanner *line, restrack_psi_line_t *psi) {
+    int found = 0;
+    const char *key;
+    size_t key_len;
+
+    while (procfs_next_token(line, '=', &key, &key_len)) {
+        if (line->pos >= line->end || *line->pos != '=') {
+            continue;
+        }
+        line->pos++;
+
+        if (procfs_token_equals(key, key_len, "avg10") && next_fixed(line, &psi->avg10)) {
+            found |= 1;
+        } else if (procfs_token_equals(key, key_len, "avg60") && next_fixed(line, &psi->avg60)) {
+            found |= 2;
+        } else if (procfs_token_equals(key, key_len, "avg300") && next_fixed(line, &psi->avg300)) {
+            found |= 4;
+        } else if (procfs_token_equals(key, key_len, "total") && procfs_next_u64(line, &psi->total_us)) {
+            found |= 8;
+        }
+    }
+    return found == 15;
+}
+
+/**
+ * @brief Read /proc/pressure/{cpu,memory,io}
+ * @param pressure Pressure section to fill
+ * @return ERR_SUCCESS on success, error code if the files could not be read
+ */
+int psi_read(restrack_pressure_t *pressure) {
+    memset(pressure, 0, sizeof(*pressure));
+
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        if (procfs_try_read(&g_pressure_files[i]) != ERR_SUCCESS) {
+            continue;
+        }
+
+        restrack_psi_t *psi = &pressure->resources[i];
+        ProcfsScanner file, line;
+        procfs_scan_file(&file, &g_pressure_files[i]);
+        while (procfs_next_line(&file, &line)) {
+            const char *kind;
+            size_t kind_len;
+            if (!procfs_next_token(&line, 0, &kind, &kind_len)) {
+                continue;
+            }
+
+            if (procfs_token_equals(kind, kind_len, "some")) {
+                psi->has_some = parse_psi_line(&line, &psi->some);
+            } else if (procfs_token_equals(kind, kind_len, "full")) {
+                psi->has_full = parse_psi_line(&line, &psi->full);
+            }
+        }
+
+        if (psi->has_some) {
+            pressure->available |= 1u << i;
+        }
+    }
+
+    pressure->triggered = g_fired;
+    g_fired = 0;
+
+    // Kernels without CONFIG_PSI have no /proc/pressure at all
+    if (pressure->available == 0) {
+        if (access("/proc/pressure", F_OK) != 0) {
+            return ERR_SUCCESS;
+        }
+        return ERR_FILE_READ;
+    }
+
+    pressure->supported = 1;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Register kernel triggers on the pressure files
+ * @param triggers Trigger per SysmonPsiResource, empty for none
+ * @return Number of triggers registered
+ */
+int psi_triggers_open(const char triggers[][SYSMON_PSI_TRIGGER_LEN]) {
+    int count = 0;
+
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        if (g_trigger_fds[i] >= 0 || triggers[i][0] == '\0') {
+            continue;
+        }
+
+        // Each trigger needs its own open file; it lives until the file is closed
+        int fd = open(g_pressure_files[i].path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            log_message(LOG_WARNING, "PSI trigger on %s unavailable: %s", g_pressure_files[i].path, strerror(errno));
+            continue;
+        }
+
+        // The kernel expects the terminating NUL as part of the write
+        size_t len = strnlen(triggers[i], SYSMON_PSI_TRIGGER_LEN - 1) + 1;
+        if (write(fd, triggers[i], len) != (ssize_t)len) {
+            log_message(LOG_WARNING, "Failed to set PSI trigger \"%s\" on %s: %s", triggers[i],
+                        g_pressure_files[i].path, strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        g_trigger_fds[i] = fd;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Get the descriptor of a registered trigger
+ * @param resource SysmonPsiResource
+ * @return Descriptor to poll for POLLPRI, -1 if the resource has no trigger
+ */
+int psi_trigger_fd(int resource) {
+    if (resource < 0 || resource >= SYSMON_PSI_COUNT) {
+        return -1;
+    }
+    return g_trigger_fds[resource];
+}
+
+/**
+ * @brief Record that a trigger descriptor reported POLLPRI
+ * @param fd Descriptor returned by psi_trigger_fd()
+ */
+void psi_trigger_fired(int fd) {
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        if (g_trigger_fds[i] >= 0 && g_trigger_fds[i] == fd) {
+            g_fired |= 1u << i;
+        }
+    }
+}
+
+/**
+ * @brief Close the trigger descriptors and the pressure files
+ */
+void psi_cleanup(void) {
+    for (int i = 0; i < SYSMON_PSI_COUNT; i++) {
+        if (g_trigger_fds[i] >= 0) {
+            close(g_trigger_fds[i]);
+            g_trigger_fds[i] = -1;
+        }
+        procfs_close(&g_pressure_files[i]);
+    }
+    g_fired = 0;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file psi.h
+ * @brief Pressure stall information and kernel PSI triggers
+ */
+
+#ifndef PSI_H
+#define PSI_H
+
+#include "resources.h"
+
+/**
+ * @brief Read /proc/pressure/{cpu,memory,io}
+ * @param pressure Pressure section to fill; its triggered mask takes the
+ *                 triggers that fired since the previous read
+ * @return ERR_SUCCESS on success, including on kernels without PSI
+ *         (supported is then 0), error code if the files could not be read
+ */
+int psi_read(restrack_pressure_t *pressure);
+
+/**
+ * @brief Register kernel triggers on the pressure files
+ * @param triggers Trigger per SysmonPsiResource, e.g. "some 150000 1000000",
+ *                 empty for none
+ * @return Number of triggers registered
+ *
+ * The kernel raises POLLPRI on a trigger's descriptor at most once per
+ * window when the stall time within the window crosses the threshold.
+ */
+int psi_triggers_open(const char triggers[][SYSMON_PSI_TRIGGER_LEN]);
+
+/**
+ * @brief Get the descriptor of a registered trigger
+ * @param resource SysmonPsiResource
+ * @return Descriptor to poll for POLLPRI, -1 if the resource has no trigger
+ */
+int psi_trigger_fd(int resource);
+
+/**
+ * @brief Record that a trigger descriptor reported POLLPRI
+ * @param fd Descriptor returned by psi_trigger_fd()
+ */
+void psi_trigger_fired(int fd);
+
+/**
+ * @brief Close the trigger descriptors and the pressure files
+ */
+void psi_cleanup(void);
+
+#endif /* PSI_H */
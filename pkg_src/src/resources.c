@@ -5,498 +5,670 @@
 
 #include "resources.h"
 #include "util.h"
+#include "procfs.h"
+#include "cpustat.h"
+#include "proctop.h"
+#include "rtnl.h"
+#include "mounts.h"
+#include "diskio.h"
+#include "netrate.h"
+#include "meminfo.h"
+#include "psi.h"
+#include "cgroups.h"
+#include "irqstat.h"
+#include "connections.h"
+#include "netproto.h"
+#include "thermal.h"
+#include "vmstat.h"
+#include "watch.h"
 #include <dirent.h>
-#include <sys/statvfs.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
+#include <net/if.h>
 #include <linux/if_link.h>
 
+// Columns after the device name in /proc/diskstats on current kernels
+#define DISKSTAT_MAX_FIELDS 20
+
+// procfs files kept open between ticks
+static ProcfsFile g_proc_stat = PROCFS_FILE_INIT("/proc/stat");
+static ProcfsFile g_proc_diskstats = PROCFS_FILE_INIT("/proc/diskstats");
+static ProcfsFile g_proc_net_dev = PROCFS_FILE_INIT("/proc/net/dev");
+
+// Fork counter of the previous process collection, for the fork rate
+static int g_has_prev_forks = 0;
+static uint64_t g_prev_forks = 0;
+static uint64_t g_prev_forks_ns = 0;
+
 /**
- * @brief Collect all system resources based on configuration
+ * @brief Release the procfs descriptors and buffers held by the collectors
+ */
+void resources_cleanup(void) {
+    procfs_close(&g_proc_stat);
+    procfs_close(&g_proc_diskstats);
+    procfs_close(&g_proc_net_dev);
+    cpustat_reset();
+    g_has_prev_forks = 0;
+    diskio_reset();
+    netrate_reset();
+    meminfo_cleanup();
+    psi_cleanup();
+    cgroups_cleanup();
+    irqstat_cleanup();
+    connections_cleanup();
+    netproto_cleanup();
+    thermal_cleanup();
+    vmstat_cleanup();
+    watch_cleanup();
+    proctop_cleanup();
+    rtnl_cleanup();
+    mounts_cleanup();
+}
+
+/**
+ * @brief Get the collectors enabled by a configuration
  * @param config Pointer to configuration structure
- * @return cJSON object with collected resources or NULL on failure
+ * @return Bitmask of RESTRACK_HAS_* bits
  */
-cJSON* collect_all_resources(SysmonConfig *config) {
+unsigned int enabled_resource_mask(const SysmonConfig *config) {
+    unsigned int mask = 0;
     if (config == NULL) {
+        return 0;
+    }
+
+    if (config->collect_cpu) mask |= RESTRACK_HAS_CPU;
+    if (config->collect_memory) mask |= RESTRACK_HAS_MEMORY;
+    if (config->collect_load) mask |= RESTRACK_HAS_LOAD;
+    if (config->collect_disk) mask |= RESTRACK_HAS_DISK;
+    if (config->collect_network) mask |= RESTRACK_HAS_NETWORK;
+    if (config->collect_uptime) mask |= RESTRACK_HAS_UPTIME;
+    if (config->collect_processes) mask |= RESTRACK_HAS_PROCESSES;
+    if (config->collect_swap) mask |= RESTRACK_HAS_SWAP;
+    if (config->collect_pressure) mask |= RESTRACK_HAS_PRESSURE;
+    if (config->collect_cgroups) mask |= RESTRACK_HAS_CGROUPS;
+    if (config->collect_interrupts) mask |= RESTRACK_HAS_INTERRUPTS;
+    if (config->collect_connections) mask |= RESTRACK_HAS_CONNECTIONS;
+    if (config->collect_protocols) mask |= RESTRACK_HAS_PROTOCOLS;
+    if (config->collect_thermal) mask |= RESTRACK_HAS_THERMAL;
+    if (config->collect_paging) mask |= RESTRACK_HAS_PAGING;
+    if (config->collect_watched) mask |= RESTRACK_HAS_WATCHED;
+
+    return mask;
+}
+
+/**
+ * @brief Collect all system resources based on configuration
+ * @param config Pointer to configuration structure
+ * @param sample Sample to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_all_resources(SysmonConfig *config, restrack_sample_t *sample) {
+    if (config == NULL || sample == NULL) {
         log_message(LOG_ERROR, "Invalid configuration");
-        return NULL;
+        return ERR_INVALID_PARAM;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) {
-        log_message(LOG_ERROR, "Failed to create JSON object");
-        return NULL;
+    sample->valid = 0;
+    return collect_resources(config, sample, enabled_resource_mask(config));
+}
+
+/**
+ * @brief Run some of the collectors, keeping the other sections of the sample
+ * @param config Pointer to configuration structure
+ * @param sample Sample to update
+ * @param collectors Bitmask of RESTRACK_HAS_* bits selecting the collectors;
+ *                   disabled collectors are ignored
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_resources(SysmonConfig *config, restrack_sample_t *sample, unsigned int collectors) {
+    if (config == NULL || sample == NULL) {
+        log_message(LOG_ERROR, "Invalid configuration");
+        return ERR_INVALID_PARAM;
     }
 
-    // Collect resources based on configuration
-    if (config->collect_cpu) {
-        cJSON *cpu_data = collect_cpu_usage();
-        if (cpu_data != NULL) {
-            cJSON_AddItemToObject(root, "cpu_usage", cpu_data);
+    collectors &= enabled_resource_mask(config);
+
+    ResourceSnapshot snapshot;
+    take_resource_snapshot(collectors, sample, &snapshot);
+
+    // Sections that are about to be refreshed lose their old value on failure
+    sample->valid &= ~collectors;
+    sample->timestamp = snapshot.timestamp;
+
+    // Run the selected collectors
+    if (collectors & RESTRACK_HAS_CPU) {
+        if (collect_cpu_usage(&snapshot, &sample->cpu) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_CPU;
         } else {
             log_message(LOG_WARNING, "Failed to collect CPU usage");
         }
     }
 
-    if (config->collect_memory) {
-        cJSON *memory_data = collect_memory_usage();
-        if (memory_data != NULL) {
-            cJSON_AddItemToObject(root, "memory_usage", memory_data);
+    if (collectors & RESTRACK_HAS_MEMORY) {
+        if (collect_memory_usage(&snapshot, &sample->memory) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_MEMORY;
         } else {
             log_message(LOG_WARNING, "Failed to collect memory usage");
         }
     }
 
-    if (config->collect_load) {
-        cJSON *load_data = collect_system_load();
-        if (load_data != NULL) {
-            cJSON_AddItemToObject(root, "system_load", load_data);
+    if (collectors & RESTRACK_HAS_LOAD) {
+        if (collect_system_load(&snapshot, &sample->load) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_LOAD;
         } else {
             log_message(LOG_WARNING, "Failed to collect system load");
         }
     }
 
-    if (config->collect_disk) {
-        cJSON *disk_data = collect_disk_usage();
-        if (disk_data != NULL) {
-            cJSON_AddItemToObject(root, "disk_usage", disk_data);
+    if (collectors & RESTRACK_HAS_DISK) {
+        if (collect_disk_usage(config->statvfs_timeout_ms, &sample->disk) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_DISK;
         } else {
             log_message(LOG_WARNING, "Failed to collect disk usage");
         }
     }
 
-    if (config->collect_network) {
-        cJSON *network_data = collect_network_stats();
-        if (network_data != NULL) {
-            cJSON_AddItemToObject(root, "network_stats", network_data);
+    if (collectors & RESTRACK_HAS_NETWORK) {
+        if (collect_network_stats(&sample->network) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_NETWORK;
         } else {
             log_message(LOG_WARNING, "Failed to collect network statistics");
         }
     }
 
-    if (config->collect_uptime) {
-        cJSON *uptime_data = collect_system_uptime();
-        if (uptime_data != NULL) {
-            cJSON_AddItemToObject(root, "system_uptime", uptime_data);
+    if (collectors & RESTRACK_HAS_UPTIME) {
+        if (collect_system_uptime(&snapshot, &sample->uptime) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_UPTIME;
         } else {
             log_message(LOG_WARNING, "Failed to collect system uptime");
         }
     }
 
-    if (config->collect_processes) {
-        cJSON *process_data = collect_process_info();
-        if (process_data != NULL) {
-            cJSON_AddItemToObject(root, "process_info", process_data);
+    if (collectors & RESTRACK_HAS_PROCESSES) {
+        if (collect_process_info(&snapshot, config->process_top_n, &sample->processes) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_PROCESSES;
         } else {
             log_message(LOG_WARNING, "Failed to collect process information");
         }
     }
 
-    if (config->collect_swap) {
-        cJSON *swap_data = collect_swap_usage();
-        if (swap_data != NULL) {
-            cJSON_AddItemToObject(root, "swap_usage", swap_data);
+    if (collectors & RESTRACK_HAS_SWAP) {
+        if (collect_swap_usage(&snapshot, &sample->swap) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_SWAP;
         } else {
             log_message(LOG_WARNING, "Failed to collect swap usage");
         }
     }
 
-    return root;
+    if (collectors & RESTRACK_HAS_PRESSURE) {
+        if (collect_pressure(&sample->pressure) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_PRESSURE;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect pressure stall information");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_CGROUPS) {
+        if (collect_cgroups(config, &sample->cgroups) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_CGROUPS;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect cgroup usage");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_INTERRUPTS) {
+        if (collect_interrupts(config->irq_top_n, &sample->interrupts) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_INTERRUPTS;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect interrupt statistics");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_CONNECTIONS) {
+        if (collect_connections(&sample->connections) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_CONNECTIONS;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect connection statistics");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_PROTOCOLS) {
+        if (collect_protocols(&sample->protocols) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_PROTOCOLS;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect protocol statistics");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_THERMAL) {
+        // The newest CPU section, from this run or an earlier one, scales the usage
+        const restrack_cpu_t *cpu = (sample->valid & RESTRACK_HAS_CPU) ? &sample->cpu : NULL;
+        if (collect_thermal(cpu, &sample->thermal) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_THERMAL;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect thermal statistics");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_PAGING) {
+        if (collect_paging(&sample->paging) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_PAGING;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect paging statistics");
+        }
+    }
+
+    if (collectors & RESTRACK_HAS_WATCHED) {
+        if (collect_watched(config, &sample->watched) == ERR_SUCCESS) {
+            sample->valid |= RESTRACK_HAS_WATCHED;
+        } else {
+            log_message(LOG_WARNING, "Failed to collect watched processes");
+        }
+    }
+
+    return ERR_SUCCESS;
 }
 
 /**
- * @brief Collect CPU usage information
- * @return cJSON object with CPU usage data or NULL on failure
+ * @brief Parse /proc/stat in a single pass
+ * @param cpu CPU section receiving the cpu lines, or NULL to skip them
+ * @param snapshot Snapshot receiving the remaining fields
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_cpu_usage(void) {
-    FILE *stat_file = fopen("/proc/stat", "r");
-    if (stat_file == NULL) {
-        log_message(LOG_ERROR, "Failed to open /proc/stat: %s", strerror(errno));
-        return NULL;
+static int parse_proc_stat(restrack_cpu_t *cpu, ResourceSnapshot *snapshot) {
+    int result = procfs_read(&g_proc_stat);
+    if (result != ERR_SUCCESS) {
+        return result;
     }
 
-    cJSON *cpu_data = cJSON_CreateObject();
-    if (cpu_data == NULL) {
-        fclose(stat_file);
-        return NULL;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    snapshot->stat_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    if (cpu != NULL) {
+        cpu->num_cpus = 0;
+        cpu->dropped = 0;
     }
+    int have_total = 0;
+    int counters = 0;
 
-    // Add number of CPU cores
-    int num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
-    if (num_cpus > 0) {
-        cJSON_AddNumberToObject(cpu_data, "cpu_count", num_cpus);
-    }
-
-    // Parse CPU statistics
-    char line[256];
-    cJSON *cpus_array = cJSON_CreateArray();
-    if (cpus_array == NULL) {
-        cJSON_Delete(cpu_data);
-        fclose(stat_file);
-        return NULL;
-    }
-
-    while (fgets(line, sizeof(line), stat_file)) {
-        char cpu_name[16];
-        unsigned long user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice;
-        
-        // Read CPU line (cpu0, cpu1, etc.)
-        if (sscanf(line, "%s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu", 
-                   cpu_name, &user, &nice, &system, &idle, &iowait, 
-                   &irq, &softirq, &steal, &guest, &guest_nice) >= 5) {
-            
-            if (strncmp(cpu_name, "cpu", 3) == 0) {
-                // Skip the aggregate CPU line (just "cpu")
-                if (strlen(cpu_name) == 3) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_stat);
+    while (procfs_next_line(&file, &line)) {
+        const char *name;
+        size_t name_len;
+        if (!procfs_next_token(&line, 0, &name, &name_len)) {
+            continue;
+        }
+
+        if (name_len >= 3 && strncmp(name, "cpu", 3) == 0) {
+            if (cpu == NULL) {
+                continue;
+            }
+
+            uint64_t v[10] = {0};
+            if (procfs_next_u64s(&line, v, 10) < 4) {
+                continue;
+            }
+
+            restrack_cpu_stat_t *stat;
+            int id = -1;
+            if (name_len == 3) {
+                // The aggregate "cpu" line
+                stat = &cpu->total;
+                have_total = 1;
+            } else {
+                ProcfsScanner digits = { name + 3, name + name_len };
+                uint64_t number;
+                if (!procfs_next_u64(&digits, &number) || digits.pos != digits.end) {
                     continue;
                 }
-                
-                cJSON *cpu_obj = cJSON_CreateObject();
-                if (cpu_obj == NULL) {
+                if (cpu->num_cpus >= RESTRACK_MAX_CPUS) {
+                    cpu->dropped++;
                     continue;
                 }
-                
-                cJSON_AddStringToObject(cpu_obj, "name", cpu_name);
-                cJSON_AddNumberToObject(cpu_obj, "user", user);
-                cJSON_AddNumberToObject(cpu_obj, "nice", nice);
-                cJSON_AddNumberToObject(cpu_obj, "system", system);
-                cJSON_AddNumberToObject(cpu_obj, "idle", idle);
-                cJSON_AddNumberToObject(cpu_obj, "iowait", iowait);
-                
-                // Calculate total time
-                unsigned long total = user + nice + system + idle + iowait + irq + softirq + steal;
-                if (total > 0) {
-                    double usage_pct = 100.0 * (total - idle) / total;
-                    cJSON_AddNumberToObject(cpu_obj, "usage_percent", usage_pct);
-                }
-                
-                cJSON_AddItemToArray(cpus_array, cpu_obj);
+                stat = &cpu->cpus[cpu->num_cpus++];
+                id = number < RESTRACK_MAX_CPUS ? (int)number : -1;
             }
+
+            procfs_copy_token(stat->name, sizeof(stat->name), name, name_len);
+            stat->id = id;
+            memcpy(stat->ticks, v, sizeof(stat->ticks));
+            stat->guest = v[8];
+            stat->guest_nice = v[9];
+        } else if (procfs_token_equals(name, name_len, "procs_running")) {
+            procfs_next_u64(&line, &snapshot->procs_running);
+        } else if (procfs_token_equals(name, name_len, "procs_blocked")) {
+            procfs_next_u64(&line, &snapshot->procs_blocked);
+        } else if (procfs_token_equals(name, name_len, "ctxt")) {
+            counters += procfs_next_u64(&line, &snapshot->ctxt);
+        } else if (procfs_token_equals(name, name_len, "intr")) {
+            // The total comes first; the per-line counts after it are left unparsed
+            counters += procfs_next_u64(&line, &snapshot->intr);
+        } else if (procfs_token_equals(name, name_len, "processes")) {
+            counters += procfs_next_u64(&line, &snapshot->processes);
+        } else if (procfs_token_equals(name, name_len, "btime")) {
+            procfs_next_u64(&line, &snapshot->btime);
         }
     }
-    
-    fclose(stat_file);
-    
-    // Add the CPUs array to the main object
-    cJSON_AddItemToObject(cpu_data, "cpus", cpus_array);
-    
-    return cpu_data;
+
+    snapshot->has_stat = 1;
+    snapshot->has_counters = counters == 3;
+    snapshot->has_cpu_lines = have_total;
+    return ERR_SUCCESS;
 }
 
 /**
- * @brief Collect memory usage information
- * @return cJSON object with memory usage data or NULL on failure
+ * @brief Take the shared snapshot for one collection
+ * @param collectors Bitmask of RESTRACK_HAS_* bits deciding which sources are read
+ * @param sample Sample whose CPU section receives the cpu lines
+ * @param snapshot Snapshot to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_memory_usage(void) {
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) {
-        log_message(LOG_ERROR, "Failed to get system info: %s", strerror(errno));
-        return NULL;
+int take_resource_snapshot(unsigned int collectors, restrack_sample_t *sample, ResourceSnapshot *snapshot) {
+    if (sample == NULL || snapshot == NULL) {
+        return ERR_INVALID_PARAM;
     }
 
-    cJSON *memory_data = cJSON_CreateObject();
-    if (memory_data == NULL) {
-        return NULL;
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->timestamp = time(NULL);
+    int result = ERR_SUCCESS;
+
+    if (collectors & (RESTRACK_HAS_MEMORY | RESTRACK_HAS_LOAD | RESTRACK_HAS_UPTIME | RESTRACK_HAS_SWAP)) {
+        if (sysinfo(&snapshot->info) == 0) {
+            snapshot->has_sysinfo = 1;
+        } else {
+            log_message(LOG_ERROR, "Failed to get system info: %s", strerror(errno));
+            result = ERR_SYS_RESOURCE;
+        }
     }
 
-    // Convert to MB for readability
-    unsigned long total_mb = info.totalram * info.mem_unit / (1024 * 1024);
-    unsigned long free_mb = info.freeram * info.mem_unit / (1024 * 1024);
-    unsigned long used_mb = total_mb - free_mb;
-    
-    cJSON_AddNumberToObject(memory_data, "total_mb", total_mb);
-    cJSON_AddNumberToObject(memory_data, "used_mb", used_mb);
-    cJSON_AddNumberToObject(memory_data, "free_mb", free_mb);
-    
-    if (total_mb > 0) {
-        double usage_pct = 100.0 * used_mb / total_mb;
-        cJSON_AddNumberToObject(memory_data, "usage_percent", usage_pct);
-    }
-
-    return memory_data;
+    if (collectors & (RESTRACK_HAS_CPU | RESTRACK_HAS_PROCESSES)) {
+        int stat_result = parse_proc_stat((collectors & RESTRACK_HAS_CPU) ? &sample->cpu : NULL, snapshot);
+        if (stat_result != ERR_SUCCESS) {
+            result = stat_result;
+        }
+    }
+
+    return result;
 }
 
 /**
- * @brief Collect system load information
- * @return cJSON object with system load data or NULL on failure
+ * @brief Collect CPU usage information
+ * @param snapshot Snapshot of the current tick
+ * @param cpu CPU section to fill; its counters were read by the snapshot
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_cpu_usage(const ResourceSnapshot *snapshot, restrack_cpu_t *cpu) {
+    if (snapshot == NULL || !snapshot->has_cpu_lines) {
+        return ERR_FILE_READ;
+    }
+
+    // Add number of CPU cores
+    cpu->cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    cpu->has_counters = snapshot->has_counters;
+    cpu->ctxt = snapshot->ctxt;
+    cpu->intr = snapshot->intr;
+    cpu->boot_time = snapshot->btime;
+    cpustat_update(cpu, snapshot->stat_ns);
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Collect memory usage information
+ * @param snapshot Snapshot of the current tick
+ * @param memory Memory section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_system_load(void) {
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) {
-        log_message(LOG_ERROR, "Failed to get system info: %s", strerror(errno));
-        return NULL;
+int collect_memory_usage(const ResourceSnapshot *snapshot, restrack_memory_t *memory) {
+    // MemAvailable tells reclaimable cache apart from memory in use
+    if (meminfo_read(memory) == ERR_SUCCESS) {
+        return ERR_SUCCESS;
     }
 
-    cJSON *load_data = cJSON_CreateObject();
-    if (load_data == NULL) {
-        return NULL;
+    if (snapshot == NULL || !snapshot->has_sysinfo) {
+        return ERR_SYS_RESOURCE;
+    }
+    const struct sysinfo *info = &snapshot->info;
+
+    // Without /proc/meminfo only free pages are known; convert to MB for readability
+    memory->has_meminfo = 0;
+    memory->total_mb = (uint64_t)info->totalram * info->mem_unit / (1024 * 1024);
+    memory->free_mb = (uint64_t)info->freeram * info->mem_unit / (1024 * 1024);
+    memory->used_mb = memory->total_mb - memory->free_mb;
+    memory->usage_percent = memory->total_mb > 0 ? 100.0 * memory->used_mb / memory->total_mb : 0.0;
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Collect system load information
+ * @param snapshot Snapshot of the current tick
+ * @param load Load section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_system_load(const ResourceSnapshot *snapshot, restrack_load_t *load) {
+    if (snapshot == NULL || !snapshot->has_sysinfo) {
+        return ERR_SYS_RESOURCE;
     }
+    const struct sysinfo *info = &snapshot->info;
 
     // Get load averages (1, 5, and 15 minutes)
     // Convert from fixed point (1/65536) to float
-    double load1 = info.loads[0] / 65536.0;
-    double load5 = info.loads[1] / 65536.0;
-    double load15 = info.loads[2] / 65536.0;
-    
-    cJSON_AddNumberToObject(load_data, "load1", load1);
-    cJSON_AddNumberToObject(load_data, "load5", load5);
-    cJSON_AddNumberToObject(load_data, "load15", load15);
+    load->load1 = info->loads[0] / 65536.0;
+    load->load5 = info->loads[1] / 65536.0;
+    load->load15 = info->loads[2] / 65536.0;
 
     // Add number of running processes
-    cJSON_AddNumberToObject(load_data, "running_processes", info.procs);
+    load->running_processes = info->procs;
 
-    return load_data;
+    return ERR_SUCCESS;
 }
 
 /**
  * @brief Collect disk usage and IO information
- * @return cJSON object with disk usage data or NULL on failure
+ * @param statvfs_timeout_ms Longest wait for statvfs answers of the mounted filesystems
+ * @param disk Disk section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_disk_usage(void) {
-    cJSON *disk_data = cJSON_CreateObject();
-    if (disk_data == NULL) {
-        return NULL;
-    }
-
-    // Get filesystem statistics
-    cJSON *filesystems = cJSON_CreateArray();
-    if (filesystems == NULL) {
-        cJSON_Delete(disk_data);
-        return NULL;
-    }
-
-    // Get root filesystem statistics as a minimum
-    struct statvfs stat;
-    if (statvfs("/", &stat) == 0) {
-        cJSON *fs = cJSON_CreateObject();
-        if (fs != NULL) {
-            unsigned long total_mb = (stat.f_blocks * stat.f_frsize) / (1024 * 1024);
-            unsigned long free_mb = (stat.f_bfree * stat.f_frsize) / (1024 * 1024);
-            unsigned long used_mb = total_mb - free_mb;
-            
-            cJSON_AddStringToObject(fs, "mount_point", "/");
-            cJSON_AddNumberToObject(fs, "total_mb", total_mb);
-            cJSON_AddNumberToObject(fs, "used_mb", used_mb);
-            cJSON_AddNumberToObject(fs, "free_mb", free_mb);
-            
-            if (total_mb > 0) {
-                double usage_pct = 100.0 * used_mb / total_mb;
-                cJSON_AddNumberToObject(fs, "usage_percent", usage_pct);
-            }
-            
-            cJSON_AddItemToArray(filesystems, fs);
-        }
+int collect_disk_usage(int statvfs_timeout_ms, restrack_disk_t *disk) {
+    disk->num_devices = 0;
+    disk->dropped = 0;
+    disk->has_io_stats = 0;
+
+    // Every real mounted filesystem, without waiting on hung ones
+    if (mounts_collect(statvfs_timeout_ms, disk) != ERR_SUCCESS) {
+        log_message(LOG_WARNING, "Failed to list mounted filesystems");
     }
 
     // Try to read disk IO statistics
-    FILE *diskstats = fopen("/proc/diskstats", "r");
-    if (diskstats != NULL) {
-        cJSON *io_stats = cJSON_CreateArray();
-        if (io_stats != NULL) {
-            char line[256];
-            
-            while (fgets(line, sizeof(line), diskstats) != NULL) {
-                int major, minor;
-                char dev_name[32];
-                unsigned long reads, reads_merged, sectors_read, read_time;
-                unsigned long writes, writes_merged, sectors_written, write_time;
-                unsigned long io_pending, io_time, weighted_io_time;
-                
-                // Parse diskstats line
-                if (sscanf(line, "%d %d %s %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                          &major, &minor, dev_name,
-                          &reads, &reads_merged, &sectors_read, &read_time,
-                          &writes, &writes_merged, &sectors_written, &write_time,
-                          &io_pending, &io_time, &weighted_io_time) == 14) {
-                    
-                    // Skip loop, ram and dm devices
-                    if (strncmp(dev_name, "loop", 4) == 0 ||
-                        strncmp(dev_name, "ram", 3) == 0 ||
-                        strncmp(dev_name, "dm-", 3) == 0) {
-                        continue;
-                    }
-                    
-                    cJSON *dev = cJSON_CreateObject();
-                    if (dev != NULL) {
-                        cJSON_AddStringToObject(dev, "device", dev_name);
-                        cJSON_AddNumberToObject(dev, "reads", reads);
-                        cJSON_AddNumberToObject(dev, "writes", writes);
-                        cJSON_AddNumberToObject(dev, "read_sectors", sectors_read);
-                        cJSON_AddNumberToObject(dev, "written_sectors", sectors_written);
-                        
-                        // 512 bytes is the traditional sector size
-                        unsigned long read_kb = sectors_read / 2;
-                        unsigned long written_kb = sectors_written / 2;
-                        
-                        cJSON_AddNumberToObject(dev, "read_kb", read_kb);
-                        cJSON_AddNumberToObject(dev, "written_kb", written_kb);
-                        
-                        cJSON_AddItemToArray(io_stats, dev);
-                    }
-                }
+    if (procfs_read(&g_proc_diskstats) == ERR_SUCCESS) {
+        ProcfsScanner file, line;
+        procfs_scan_file(&file, &g_proc_diskstats);
+        disk->has_io_stats = 1;
+
+        while (procfs_next_line(&file, &line)) {
+            uint64_t major, minor;
+            const char *dev_name;
+            size_t name_len;
+            uint64_t v[DISKSTAT_MAX_FIELDS];
+
+            // major minor name, then 11 fields on old kernels and up to 20 on new ones
+            if (!procfs_next_u64(&line, &major) || !procfs_next_u64(&line, &minor) ||
+                !procfs_next_token(&line, 0, &dev_name, &name_len) ||
+                procfs_next_u64s(&line, v, DISKSTAT_MAX_FIELDS) < 11) {
+                continue;
+            }
+
+            // Skip loop, ram and dm devices
+            if ((name_len >= 4 && strncmp(dev_name, "loop", 4) == 0) ||
+                (name_len >= 3 && strncmp(dev_name, "ram", 3) == 0) ||
+                (name_len >= 3 && strncmp(dev_name, "dm-", 3) == 0)) {
+                continue;
             }
-            
-            cJSON_AddItemToObject(disk_data, "io_stats", io_stats);
+
+            if (disk->num_devices >= RESTRACK_MAX_DISKS) {
+                disk->dropped++;
+                continue;
+            }
+
+            restrack_disk_io_t *dev = &disk->io_stats[disk->num_devices++];
+            procfs_copy_token(dev->device, sizeof(dev->device), dev_name, name_len);
+            dev->major = (unsigned int)major;
+            dev->minor = (unsigned int)minor;
+            dev->reads = v[0];
+            dev->read_sectors = v[2];
+            dev->read_ms = v[3];
+            dev->writes = v[4];
+            dev->written_sectors = v[6];
+            dev->write_ms = v[7];
+            dev->in_flight = v[8];
+            dev->io_ms = v[9];
+            dev->weighted_io_ms = v[10];
+
+            // diskstats counts 512-byte sectors whatever the device's block size
+            dev->read_kb = v[2] / 2;
+            dev->written_kb = v[6] / 2;
         }
-        
-        fclose(diskstats);
+
+        diskio_update(disk);
     }
 
-    cJSON_AddItemToObject(disk_data, "filesystems", filesystems);
-    return disk_data;
+    return ERR_SUCCESS;
 }
 
 /**
- * @brief Collect network statistics
- * @return cJSON object with network statistics or NULL on failure
+ * @brief Read the interface counters from /proc/net/dev
+ * @param network Network section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_network_stats(void) {
-    cJSON *network_data = cJSON_CreateObject();
-    if (network_data == NULL) {
-        return NULL;
+static int read_net_dev(restrack_network_t *network) {
+    int result = procfs_read(&g_proc_net_dev);
+    if (result != ERR_SUCCESS) {
+        return result;
     }
 
-    // Get network interface statistics
-    cJSON *interfaces = cJSON_CreateArray();
-    if (interfaces == NULL) {
-        cJSON_Delete(network_data);
-        return NULL;
-    }
-
-    // Read from /proc/net/dev which has network interface statistics
-    FILE *netdev = fopen("/proc/net/dev", "r");
-    if (netdev == NULL) {
-        log_message(LOG_ERROR, "Failed to open /proc/net/dev: %s", strerror(errno));
-        cJSON_Delete(network_data);
-        return NULL;
-    }
+    network->source = RESTRACK_NET_SOURCE_PROCFS;
+    network->num_interfaces = 0;
+    network->dropped = 0;
 
-    char line[256];
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_net_dev);
     // Skip the first two header lines
-    fgets(line, sizeof(line), netdev);
-    fgets(line, sizeof(line), netdev);
-
-    while (fgets(line, sizeof(line), netdev)) {
-        char *colon = strchr(line, ':');
-        if (colon == NULL) {
+    procfs_next_line(&file, &line);
+    procfs_next_line(&file, &line);
+
+    while (procfs_next_line(&file, &line)) {
+        // "  eth0: rx_bytes rx_packets ..." the colon may touch the first number
+        const char *iface_name;
+        size_t name_len;
+        if (!procfs_next_token(&line, ':', &iface_name, &name_len) ||
+            line.pos >= line.end || *line.pos != ':') {
             continue;
         }
+        line.pos++;
 
-        *colon = '\0';
-        char *iface_name = line;
-        // Trim leading whitespace
-        while (isspace(*iface_name)) {
-            iface_name++;
+        // rx: bytes packets errs drop fifo frame compressed multicast, then tx: bytes packets errs drop ...
+        uint64_t v[16];
+        if (procfs_next_u64s(&line, v, 16) < 16) {
+            continue;
         }
 
-        // Parse interface statistics
-        char *stats = colon + 1;
-        unsigned long rx_bytes, rx_packets, rx_errs, rx_drop, rx_fifo, rx_frame, rx_compressed, rx_multicast;
-        unsigned long tx_bytes, tx_packets, tx_errs, tx_drop, tx_fifo, tx_colls, tx_carrier, tx_compressed;
-
-        if (sscanf(stats, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                  &rx_bytes, &rx_packets, &rx_errs, &rx_drop, &rx_fifo, &rx_frame, &rx_compressed, &rx_multicast,
-                  &tx_bytes, &tx_packets, &tx_errs, &tx_drop, &tx_fifo, &tx_colls, &tx_carrier, &tx_compressed) == 16) {
-            
-            cJSON *iface = cJSON_CreateObject();
-            if (iface != NULL) {
-                cJSON_AddStringToObject(iface, "interface", iface_name);
-                
-                // Add receive statistics
-                cJSON *rx = cJSON_CreateObject();
-                if (rx != NULL) {
-                    cJSON_AddNumberToObject(rx, "bytes", rx_bytes);
-                    cJSON_AddNumberToObject(rx, "packets", rx_packets);
-                    cJSON_AddNumberToObject(rx, "errors", rx_errs);
-                    cJSON_AddNumberToObject(rx, "dropped", rx_drop);
-                    cJSON_AddItemToObject(iface, "receive", rx);
-                }
-                
-                // Add transmit statistics
-                cJSON *tx = cJSON_CreateObject();
-                if (tx != NULL) {
-                    cJSON_AddNumberToObject(tx, "bytes", tx_bytes);
-                    cJSON_AddNumberToObject(tx, "packets", tx_packets);
-                    cJSON_AddNumberToObject(tx, "errors", tx_errs);
-                    cJSON_AddNumberToObject(tx, "dropped", tx_drop);
-                    cJSON_AddItemToObject(iface, "transmit", tx);
-                }
-                
-                cJSON_AddItemToArray(interfaces, iface);
-            }
+        if (network->num_interfaces >= RESTRACK_MAX_INTERFACES) {
+            network->dropped++;
+            continue;
         }
+
+        restrack_iface_t *iface = &network->interfaces[network->num_interfaces++];
+        memset(iface, 0, sizeof(*iface));
+        procfs_copy_token(iface->name, sizeof(iface->name), iface_name, name_len);
+        iface->ifindex = (int)if_nametoindex(iface->name);
+        iface->speed_mbps = -1;
+        iface->multicast = v[7];
+        iface->collisions = v[13];
+
+        // Receive statistics
+        iface->rx.bytes = v[0];
+        iface->rx.packets = v[1];
+        iface->rx.errors = v[2];
+        iface->rx.dropped = v[3];
+
+        // Transmit statistics
+        iface->tx.bytes = v[8];
+        iface->tx.packets = v[9];
+        iface->tx.errors = v[10];
+        iface->tx.dropped = v[11];
     }
 
-    fclose(netdev);
-    cJSON_AddItemToObject(network_data, "interfaces", interfaces);
-    return network_data;
+    return ERR_SUCCESS;
 }
 
 /**
- * @brief Collect system uptime information
- * @return cJSON object with uptime data or NULL on failure
+ * @brief Collect network statistics
+ * @param network Network section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_system_uptime(void) {
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) {
-        log_message(LOG_ERROR, "Failed to get system info: %s", strerror(errno));
-        return NULL;
+int collect_network_stats(restrack_network_t *network) {
+    // One binary rtnetlink dump when available, /proc/net/dev otherwise
+    int result = rtnl_collect_links(network);
+    if (result != ERR_SUCCESS) {
+        result = read_net_dev(network);
+    }
+
+    if (result == ERR_SUCCESS) {
+        netrate_update(network);
     }
+    return result;
+}
 
-    cJSON *uptime_data = cJSON_CreateObject();
-    if (uptime_data == NULL) {
-        return NULL;
+/**
+ * @brief Collect system uptime information
+ * @param snapshot Snapshot of the current tick
+ * @param uptime Uptime section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_system_uptime(const ResourceSnapshot *snapshot, restrack_uptime_t *uptime) {
+    if (snapshot == NULL || !snapshot->has_sysinfo) {
+        return ERR_SYS_RESOURCE;
     }
+    const struct sysinfo *info = &snapshot->info;
 
     // Calculate days, hours, minutes, seconds
-    unsigned long uptime_seconds = info.uptime;
-    unsigned int days = uptime_seconds / (60 * 60 * 24);
-    unsigned int hours = (uptime_seconds % (60 * 60 * 24)) / (60 * 60);
-    unsigned int minutes = (uptime_seconds % (60 * 60)) / 60;
-    unsigned int seconds = uptime_seconds % 60;
-
-    cJSON_AddNumberToObject(uptime_data, "total_seconds", uptime_seconds);
-    cJSON_AddNumberToObject(uptime_data, "days", days);
-    cJSON_AddNumberToObject(uptime_data, "hours", hours);
-    cJSON_AddNumberToObject(uptime_data, "minutes", minutes);
-    cJSON_AddNumberToObject(uptime_data, "seconds", seconds);
-
-    // Format human-readable uptime
-    char uptime_str[64];
-    if (days > 0) {
-        snprintf(uptime_str, sizeof(uptime_str), "%u days %u hours %u minutes", days, hours, minutes);
-    } else if (hours > 0) {
-        snprintf(uptime_str, sizeof(uptime_str), "%u hours %u minutes", hours, minutes);
-    } else {
-        snprintf(uptime_str, sizeof(uptime_str), "%u minutes %u seconds", minutes, seconds);
-    }
-    
-    cJSON_AddStringToObject(uptime_data, "uptime", uptime_str);
-
-    return uptime_data;
+    uint64_t uptime_seconds = info->uptime;
+    uptime->total_seconds = uptime_seconds;
+    uptime->days = uptime_seconds / (60 * 60 * 24);
+    uptime->hours = (uptime_seconds % (60 * 60 * 24)) / (60 * 60);
+    uptime->minutes = (uptime_seconds % (60 * 60)) / 60;
+    uptime->seconds = uptime_seconds % 60;
+
+    return ERR_SUCCESS;
 }
 
 /**
  * @brief Collect process information
- * @return cJSON object with process information or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param top_n Number of processes to rank by CPU and by memory, 0 to skip
+ * @param processes Process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_process_info(void) {
-    cJSON *process_data = cJSON_CreateObject();
-    if (process_data == NULL) {
-        return NULL;
-    }
-
+int collect_process_info(const ResourceSnapshot *snapshot, int top_n, restrack_process_t *processes) {
     // Get number of processes
     DIR *proc_dir = opendir("/proc");
     if (proc_dir == NULL) {
         log_message(LOG_ERROR, "Failed to open /proc directory: %s", strerror(errno));
-        cJSON_Delete(process_data);
-        return NULL;
+        return ERR_FILE_OPEN;
     }
 
     int process_count = 0;
     struct dirent *entry;
-    
+
+    // The same readdir pass feeds the per-process tracker
+    if (top_n > 0) {
+        proctop_begin();
+    }
+
     while ((entry = readdir(proc_dir)) != NULL) {
         // Count only numeric directories (PIDs)
         /* Skip . and .. entries, and only check directories with numeric names (PID dirs) */
@@ -505,66 +677,136 @@ cJSON* collect_process_info(void) {
             long pid = strtol(entry->d_name, &endptr, 10);
             if (*endptr == '\0' && pid > 0) {
                 process_count++;
+                if (top_n > 0) {
+                    proctop_visit((int)pid);
+                }
             }
         }
     }
-    
+
     closedir(proc_dir);
-    cJSON_AddNumberToObject(process_data, "count", process_count);
-
-    // Try to get number of running processes
-    FILE *stat_file = fopen("/proc/stat", "r");
-    if (stat_file != NULL) {
-        char line[256];
-        int procs_running = 0;
-        int procs_blocked = 0;
-        
-        while (fgets(line, sizeof(line), stat_file)) {
-            if (strncmp(line, "procs_running", 13) == 0) {
-                sscanf(line, "procs_running %d", &procs_running);
-            } else if (strncmp(line, "procs_blocked", 13) == 0) {
-                sscanf(line, "procs_blocked %d", &procs_blocked);
-            }
+    processes->count = process_count;
+
+    processes->num_top_cpu = 0;
+    processes->num_top_memory = 0;
+    if (top_n > 0) {
+        proctop_finish(top_n, processes);
+    }
+
+    // Running and blocked counts and the fork counter come from the /proc/stat pass
+    processes->has_stat = snapshot != NULL && snapshot->has_stat;
+    processes->has_fork_rate = 0;
+    processes->forks_per_sec = 0.0;
+    if (processes->has_stat) {
+        processes->running = snapshot->procs_running;
+        processes->blocked = snapshot->procs_blocked;
+        processes->forks = snapshot->processes;
+
+        if (g_has_prev_forks && snapshot->stat_ns > g_prev_forks_ns && snapshot->processes >= g_prev_forks) {
+            processes->has_fork_rate = 1;
+            processes->forks_per_sec = (snapshot->processes - g_prev_forks) * 1e9 / (snapshot->stat_ns - g_prev_forks_ns);
         }
-        
-        fclose(stat_file);
-        
-        cJSON_AddNumberToObject(process_data, "running", procs_running);
-        cJSON_AddNumberToObject(process_data, "blocked", procs_blocked);
+        g_has_prev_forks = snapshot->has_counters;
+        g_prev_forks = snapshot->processes;
+        g_prev_forks_ns = snapshot->stat_ns;
     }
 
-    return process_data;
+    return ERR_SUCCESS;
 }
 
 /**
  * @brief Collect swap usage information
- * @return cJSON object with swap usage data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param swap Swap section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_swap_usage(void) {
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) {
-        log_message(LOG_ERROR, "Failed to get system info: %s", strerror(errno));
-        return NULL;
-    }
-
-    cJSON *swap_data = cJSON_CreateObject();
-    if (swap_data == NULL) {
-        return NULL;
+int collect_swap_usage(const ResourceSnapshot *snapshot, restrack_swap_t *swap) {
+    if (snapshot == NULL || !snapshot->has_sysinfo) {
+        return ERR_SYS_RESOURCE;
     }
+    const struct sysinfo *info = &snapshot->info;
 
     // Convert to MB for readability
-    unsigned long total_mb = info.totalswap * info.mem_unit / (1024 * 1024);
-    unsigned long free_mb = info.freeswap * info.mem_unit / (1024 * 1024);
-    unsigned long used_mb = total_mb - free_mb;
-    
-    cJSON_AddNumberToObject(swap_data, "total_mb", total_mb);
-    cJSON_AddNumberToObject(swap_data, "used_mb", used_mb);
-    cJSON_AddNumberToObject(swap_data, "free_mb", free_mb);
-    
-    if (total_mb > 0) {
-        double usage_pct = 100.0 * used_mb / total_mb;
-        cJSON_AddNumberToObject(swap_data, "usage_percent", usage_pct);
-    }
-
-    return swap_data;
+    swap->total_mb = (uint64_t)info->totalswap * info->mem_unit / (1024 * 1024);
+    swap->free_mb = (uint64_t)info->freeswap * info->mem_unit / (1024 * 1024);
+    swap->used_mb = swap->total_mb - swap->free_mb;
+    swap->usage_percent = swap->total_mb > 0 ? 100.0 * swap->used_mb / swap->total_mb : 0.0;
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Collect pressure stall information
+ * @param pressure Pressure section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_pressure(restrack_pressure_t *pressure) {
+    return psi_read(pressure);
+}
+
+/**
+ * @brief Collect resource usage of the configured cgroups
+ * @param config Pointer to configuration structure holding the cgroup paths
+ * @param cgroups Cgroup section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_cgroups(const SysmonConfig *config, restrack_cgroups_t *cgroups) {
+    return cgroups_collect(config->cgroup_paths, config->num_cgroup_paths, cgroups);
+}
+
+/**
+ * @brief Collect softirq, interrupt and packet backlog rates
+ * @param top_n Number of interrupt lines to rank by rate, 0 to skip
+ * @param interrupts Interrupt section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_interrupts(int top_n, restrack_interrupts_t *interrupts) {
+    return irqstat_collect(top_n, interrupts);
+}
+
+/**
+ * @brief Collect conntrack and TCP socket table usage
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_connections(restrack_connections_t *connections) {
+    return connections_collect(connections);
+}
+
+/**
+ * @brief Collect IP, TCP and UDP error rates
+ * @param protocols Protocol section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_protocols(restrack_protocols_t *protocols) {
+    return netproto_collect(protocols);
+}
+
+/**
+ * @brief Collect temperatures, cooling states and CPU frequencies
+ * @param cpu CPU section for frequency-scaled usage, or NULL when not collected
+ * @param thermal Thermal section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_thermal(const restrack_cpu_t *cpu, restrack_thermal_t *thermal) {
+    return thermal_collect(cpu, thermal);
+}
+
+/**
+ * @brief Collect swap, fault and OOM rates and zram compression
+ * @param paging Paging section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_paging(restrack_paging_t *paging) {
+    return vmstat_collect(paging);
+}
+
+/**
+ * @brief Collect usage of the processes matching the watch patterns
+ * @param config Configuration holding the patterns
+ * @param watched Watched process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_watched(const SysmonConfig *config, restrack_watched_t *watched) {
+    return watch_collect(config->watch_patterns, config->num_watch_patterns, watched);
 }
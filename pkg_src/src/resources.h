@@ -8,60 +8,917 @@
 
 #include "cJSON.h"
 #include "sysmon.h"
+#include <stdint.h>
+
+// Fixed table sizes of a sample; extra entries are dropped and counted
+#define RESTRACK_MAX_CPUS 256
+#define RESTRACK_MAX_INTERFACES 64
+#define RESTRACK_MAX_DISKS 32
+#define RESTRACK_MAX_FILESYSTEMS 16
+#define RESTRACK_NAME_LEN 32
+#define RESTRACK_MAX_TOP 16
+#define RESTRACK_MAX_CGROUPS 256
+#define RESTRACK_CGROUP_NAME_LEN 96
+#define RESTRACK_MAX_SOFTIRQS 16
+#define RESTRACK_IRQ_DESC_LEN 48
+#define RESTRACK_MAX_THERMAL_ZONES 16
+#define RESTRACK_MAX_COOLING_DEVICES 16
+#define RESTRACK_MAX_ZRAM 8
+#define RESTRACK_MAX_WATCHED 32
+
+// Sections present in a sample, one bit per SysmonCollector
+#define RESTRACK_HAS_CPU        (1u << SYSMON_COLLECTOR_CPU)
+#define RESTRACK_HAS_MEMORY     (1u << SYSMON_COLLECTOR_MEMORY)
+#define RESTRACK_HAS_LOAD       (1u << SYSMON_COLLECTOR_LOAD)
+#define RESTRACK_HAS_DISK       (1u << SYSMON_COLLECTOR_DISK)
+#define RESTRACK_HAS_NETWORK    (1u << SYSMON_COLLECTOR_NETWORK)
+#define RESTRACK_HAS_UPTIME     (1u << SYSMON_COLLECTOR_UPTIME)
+#define RESTRACK_HAS_PROCESSES  (1u << SYSMON_COLLECTOR_PROCESSES)
+#define RESTRACK_HAS_SWAP       (1u << SYSMON_COLLECTOR_SWAP)
+#define RESTRACK_HAS_PRESSURE   (1u << SYSMON_COLLECTOR_PRESSURE)
+#define RESTRACK_HAS_CGROUPS    (1u << SYSMON_COLLECTOR_CGROUPS)
+#define RESTRACK_HAS_INTERRUPTS (1u << SYSMON_COLLECTOR_INTERRUPTS)
+#define RESTRACK_HAS_CONNECTIONS (1u << SYSMON_COLLECTOR_CONNECTIONS)
+#define RESTRACK_HAS_PROTOCOLS  (1u << SYSMON_COLLECTOR_PROTOCOLS)
+#define RESTRACK_HAS_THERMAL    (1u << SYSMON_COLLECTOR_THERMAL)
+#define RESTRACK_HAS_PAGING     (1u << SYSMON_COLLECTOR_PAGING)
+#define RESTRACK_HAS_WATCHED    (1u << SYSMON_COLLECTOR_WATCHED)
+
+// Columns of a /proc/stat cpu line that make up its total time
+enum {
+    RESTRACK_CPU_USER,
+    RESTRACK_CPU_NICE,
+    RESTRACK_CPU_SYSTEM,
+    RESTRACK_CPU_IDLE,
+    RESTRACK_CPU_IOWAIT,
+    RESTRACK_CPU_IRQ,
+    RESTRACK_CPU_SOFTIRQ,
+    RESTRACK_CPU_STEAL,
+    RESTRACK_CPU_STATES
+};
+
+/**
+ * @struct restrack_cpu_stat_t
+ * @brief One cpu line from /proc/stat and its share over the last interval
+ *
+ * ticks are the cumulative counters in clock ticks. percent holds each
+ * state's share of the time elapsed since the previous collection, or
+ * since boot on the first one. A CPU that comes online later only has its
+ * counters on the collection that first sees it. Guest time is already
+ * part of user and nice, so it is reported but not counted in the total.
+ */
+typedef struct {
+    char name[16];               // "cpu" for the aggregate, "cpu0", "cpu1", ...
+    int id;                      // CPU number, -1 for the aggregate
+    uint64_t ticks[RESTRACK_CPU_STATES];
+    uint64_t guest;
+    uint64_t guest_nice;
+    int has_percent;             // Whether percent and usage_percent are valid
+    double percent[RESTRACK_CPU_STATES];
+    double usage_percent;        // Non-idle share of the interval
+} restrack_cpu_stat_t;
+
+/**
+ * @struct restrack_cpu_t
+ * @brief CPU usage section of a sample
+ */
+typedef struct {
+    int cpu_count;               // Online CPUs
+    int interval;                // Whether percentages cover an interval rather than uptime
+    restrack_cpu_stat_t total;   // Aggregate "cpu" line
+    int num_cpus;                // Entries used in cpus
+    int dropped;                 // CPUs that did not fit in cpus
+    restrack_cpu_stat_t cpus[RESTRACK_MAX_CPUS];
+    int has_counters;            // Whether the ctxt and intr lines were read
+    uint64_t ctxt;               // Context switches since boot
+    uint64_t intr;               // Interrupts since boot, all lines
+    uint64_t boot_time;          // btime, seconds since the epoch
+    int has_rates;               // Whether the rates below cover an interval
+    double ctxt_per_sec;
+    double intr_per_sec;
+} restrack_cpu_t;
+
+/**
+ * @struct restrack_memory_t
+ * @brief Memory usage section of a sample
+ *
+ * used_mb is the memory that cannot be handed to applications without
+ * swapping, i.e. total minus MemAvailable, so page cache and reclaimable
+ * slab do not count as used.
+ */
+typedef struct {
+    uint64_t total_mb;
+    uint64_t used_mb;
+    uint64_t free_mb;            // Completely unused pages (MemFree)
+    double usage_percent;        // used_mb share of total_mb
+    int has_meminfo;             // Whether the fields below come from /proc/meminfo
+    int available_estimated;     // MemAvailable was missing and was estimated
+    uint64_t available_mb;
+    uint64_t buffers_mb;
+    uint64_t cached_mb;
+    uint64_t shmem_mb;
+    uint64_t slab_mb;
+    uint64_t sreclaimable_mb;
+} restrack_memory_t;
+
+/**
+ * @struct restrack_load_t
+ * @brief System load section of a sample
+ */
+typedef struct {
+    double load1;
+    double load5;
+    double load15;
+    unsigned int running_processes;
+} restrack_load_t;
+
+/**
+ * @struct restrack_filesystem_t
+ * @brief Usage of one mounted filesystem
+ */
+typedef struct {
+    char mount_point[64];
+    char fstype[16];
+    char device[64];             // Mount source, e.g. /dev/sda1
+    int readonly;
+    int responding;              // 0 when statvfs timed out; values are from the last answer
+    uint64_t total_mb;
+    uint64_t used_mb;
+    uint64_t free_mb;
+    uint64_t available_mb;       // Free space usable by unprivileged users
+    double usage_percent;
+    uint64_t inodes_total;       // 0 when the filesystem has no inode limit
+    uint64_t inodes_used;
+    uint64_t inodes_free;
+    double inode_usage_percent;
+} restrack_filesystem_t;
+
+/**
+ * @struct restrack_disk_io_t
+ * @brief IO counters of one block device and its rates over the last interval
+ *
+ * Counters are cumulative as in /proc/diskstats, whose sectors are always
+ * 512-byte units. The rates are only valid when has_rates is set, i.e.
+ * from the second reading of the same device on.
+ */
+typedef struct {
+    char device[RESTRACK_NAME_LEN];
+    unsigned int major;
+    unsigned int minor;
+    unsigned int sector_size;    // Logical block size of the device, 0 when unknown
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_sectors;
+    uint64_t written_sectors;
+    uint64_t read_kb;
+    uint64_t written_kb;
+    uint64_t read_ms;            // Time spent reading
+    uint64_t write_ms;           // Time spent writing
+    uint64_t in_flight;          // Requests issued but not completed
+    uint64_t io_ms;              // Time the device had requests in flight
+    uint64_t weighted_io_ms;     // io time weighted by requests in flight
+    int has_rates;               // Whether the fields below are valid
+    double interval_ms;          // Time the rates cover
+    double read_iops;
+    double write_iops;
+    double read_kb_per_sec;
+    double write_kb_per_sec;
+    double util_percent;         // Share of the interval the device was busy
+    double avg_queue_depth;      // Mean requests in flight
+    double await_ms;             // Mean time per completed request, queueing included
+    double read_await_ms;
+    double write_await_ms;
+} restrack_disk_io_t;
+
+/**
+ * @struct restrack_disk_t
+ * @brief Disk usage and IO section of a sample
+ */
+typedef struct {
+    int num_filesystems;
+    int filesystems_dropped;     // Mounts that did not fit in filesystems
+    restrack_filesystem_t filesystems[RESTRACK_MAX_FILESYSTEMS];
+    int has_io_stats;            // Whether /proc/diskstats could be read
+    int num_devices;
+    int dropped;                 // Devices that did not fit in io_stats
+    restrack_disk_io_t io_stats[RESTRACK_MAX_DISKS];
+} restrack_disk_t;
+
+/**
+ * @struct restrack_iface_dir_t
+ * @brief Counters of one traffic direction of an interface
+ */
+typedef struct {
+    uint64_t bytes;
+    uint64_t packets;
+    uint64_t errors;
+    uint64_t dropped;
+} restrack_iface_dir_t;
+
+/**
+ * @struct restrack_iface_rate_t
+ * @brief Rates of one traffic direction of an interface over the last interval
+ */
+typedef struct {
+    double bits_per_sec;
+    double packets_per_sec;
+    double errors_per_sec;
+    double dropped_per_sec;
+} restrack_iface_rate_t;
+
+/**
+ * @struct restrack_iface_t
+ * @brief Counters of one network interface
+ */
+typedef struct {
+    char name[RESTRACK_NAME_LEN];
+    restrack_iface_dir_t rx;
+    restrack_iface_dir_t tx;
+    int has_link_info;           // Whether the fields below are valid (netlink only)
+    int ifindex;
+    unsigned int flags;          // IFF_* flags
+    unsigned int mtu;
+    unsigned char operstate;     // IF_OPER_* value
+    int speed_mbps;              // Link speed, -1 when unknown
+    uint64_t multicast;          // Multicast packets received
+    uint64_t collisions;
+    int has_rates;               // Whether the rates below are valid
+    double interval_ms;          // Time the rates cover
+    restrack_iface_rate_t rx_rate;
+    restrack_iface_rate_t tx_rate;
+} restrack_iface_t;
+
+// Where the network counters were read from
+#define RESTRACK_NET_SOURCE_PROCFS  0
+#define RESTRACK_NET_SOURCE_NETLINK 1
+
+/**
+ * @struct restrack_network_t
+ * @brief Network statistics section of a sample
+ */
+typedef struct {
+    int source;                  // RESTRACK_NET_SOURCE_*
+    int num_interfaces;
+    int dropped;                 // Interfaces that did not fit in interfaces
+    restrack_iface_t interfaces[RESTRACK_MAX_INTERFACES];
+} restrack_network_t;
+
+/**
+ * @enum restrack_link_event_type_t
+ * @brief Kinds of link and address changes pushed by the link watcher
+ */
+typedef enum {
+    RESTRACK_LINK_ADDED = 0,
+    RESTRACK_LINK_REMOVED,
+    RESTRACK_LINK_UP,
+    RESTRACK_LINK_DOWN,
+    RESTRACK_ADDR_ADDED,
+    RESTRACK_ADDR_REMOVED
+} restrack_link_event_type_t;
+
+// Longest address text, large enough for IPv6
+#define RESTRACK_ADDR_LEN 46
+
+/**
+ * @struct restrack_link_event_t
+ * @brief One link or address change reported by the kernel
+ */
+typedef struct {
+    restrack_link_event_type_t type;
+    char name[RESTRACK_NAME_LEN];
+    int ifindex;
+    unsigned int flags;          // IFF_* flags
+    unsigned char operstate;     // IF_OPER_* value
+    int up;                      // Administratively up with carrier
+    int family;                  // AF_INET or AF_INET6 for address events
+    char address[RESTRACK_ADDR_LEN];
+    int prefixlen;
+} restrack_link_event_t;
+
+/**
+ * @struct restrack_uptime_t
+ * @brief System uptime section of a sample
+ */
+typedef struct {
+    uint64_t total_seconds;
+    unsigned int days;
+    unsigned int hours;
+    unsigned int minutes;
+    unsigned int seconds;
+} restrack_uptime_t;
+
+/**
+ * @struct restrack_proc_t
+ * @brief Resource usage of one process over the last interval
+ */
+typedef struct {
+    int pid;
+    char name[16];               // comm, as in /proc/<pid>/stat
+    char state;                  // R, S, D, Z, ...
+    unsigned int threads;
+    double cpu_percent;          // Share of one CPU since the previous pass
+    uint64_t rss_kb;             // Resident set size
+    int has_io;                  // Whether /proc/<pid>/io could be read
+    uint64_t read_bytes;         // Cumulative bytes fetched from storage
+    uint64_t write_bytes;        // Cumulative bytes sent to storage
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+} restrack_proc_t;
+
+/**
+ * @struct restrack_process_t
+ * @brief Process information section of a sample
+ */
+typedef struct {
+    int count;                   // Numeric entries in /proc
+    int has_stat;                // Whether running/blocked/forks are valid
+    int running;
+    int blocked;
+    uint64_t forks;              // Processes and threads created since boot
+    int has_fork_rate;           // Whether forks_per_sec covers an interval
+    double forks_per_sec;
+    int num_top_cpu;             // Entries used in top_cpu, 0 when disabled
+    restrack_proc_t top_cpu[RESTRACK_MAX_TOP];      // Busiest first
+    int num_top_memory;          // Entries used in top_memory
+    restrack_proc_t top_memory[RESTRACK_MAX_TOP];   // Largest RSS first
+} restrack_process_t;
+
+/**
+ * @struct restrack_swap_t
+ * @brief Swap usage section of a sample
+ */
+typedef struct {
+    uint64_t total_mb;
+    uint64_t used_mb;
+    uint64_t free_mb;
+    double usage_percent;
+} restrack_swap_t;
+
+/**
+ * @struct restrack_psi_line_t
+ * @brief One line of a /proc/pressure file
+ */
+typedef struct {
+    double avg10;                // Share of time stalled over the last 10 s, in percent
+    double avg60;
+    double avg300;
+    uint64_t total_us;           // Cumulative stall time
+} restrack_psi_line_t;
+
+/**
+ * @struct restrack_psi_t
+ * @brief Pressure of one resource
+ *
+ * "some" is time in which at least one task stalled on the resource,
+ * "full" time in which all non-idle tasks stalled at once.
+ */
+typedef struct {
+    int has_some;
+    int has_full;                // CPU has no full line before Linux 5.13
+    restrack_psi_line_t some;
+    restrack_psi_line_t full;
+} restrack_psi_t;
+
+/**
+ * @struct restrack_pressure_t
+ * @brief Pressure stall information section of a sample
+ */
+typedef struct {
+    int supported;               // Whether the kernel provides /proc/pressure
+    unsigned int available;      // Bitmask of SysmonPsiResource bits that were read
+    unsigned int triggered;      // Resources whose kernel trigger fired since the previous sample
+    restrack_psi_t resources[SYSMON_PSI_COUNT];
+} restrack_pressure_t;
+
+/**
+ * @struct restrack_cgroup_t
+ * @brief Resource usage of one cgroup v2 directory
+ *
+ * Counters are cumulative and include every descendant cgroup. Each
+ * group of fields is only valid when its controller is enabled for the
+ * cgroup, as told by the has_* flags. Rates cover the time since the
+ * previous reading of the same cgroup.
+ */
+typedef struct {
+    char name[RESTRACK_CGROUP_NAME_LEN]; // Path below the cgroup2 mount, e.g. "services/dnsmasq"
+    int has_cpu;                 // cpu.stat
+    uint64_t usage_usec;
+    uint64_t user_usec;
+    uint64_t system_usec;
+    uint64_t nr_throttled;       // Periods in which the cpu.max quota ran out
+    uint64_t throttled_usec;
+    int has_memory;              // memory.current
+    uint64_t memory_bytes;
+    int has_memory_events;       // memory.events
+    uint64_t events_high;        // Times usage went over memory.high and was throttled
+    uint64_t events_max;         // Times usage hit memory.max
+    uint64_t events_oom;         // Allocations that failed at memory.max
+    uint64_t events_oom_kill;    // Processes killed by the OOM killer
+    int has_io;                  // io.stat, summed over devices
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t read_ios;
+    uint64_t write_ios;
+    int has_rates;               // Whether the fields below are valid
+    double interval_ms;          // Time the rates cover
+    double cpu_percent;          // Share of one CPU
+    double user_percent;
+    double system_percent;
+    double throttled_percent;    // Share of the interval spent throttled
+    uint64_t new_high;           // memory.events increments over the interval
+    uint64_t new_max;
+    uint64_t new_oom;
+    uint64_t new_oom_kill;
+    double read_bytes_per_sec;
+    double write_bytes_per_sec;
+    double read_iops;
+    double write_iops;
+} restrack_cgroup_t;
+
+/**
+ * @struct restrack_cgroups_t
+ * @brief Per-cgroup resource usage section of a sample
+ */
+typedef struct {
+    int supported;               // Whether a cgroup2 hierarchy is mounted
+    int num_cgroups;
+    int dropped;                 // Matching cgroups that did not fit in cgroups
+    restrack_cgroup_t cgroups[RESTRACK_MAX_CGROUPS];
+} restrack_cgroups_t;
+
+/**
+ * @struct restrack_softirq_t
+ * @brief One softirq type of /proc/softirqs, over all CPUs
+ */
+typedef struct {
+    char name[16];               // HI, TIMER, NET_TX, NET_RX, BLOCK, ...
+    uint64_t total;              // Raised since boot
+    double per_sec;
+} restrack_softirq_t;
+
+/**
+ * @struct restrack_irq_cpu_t
+ * @brief Network softirq and packet backlog rates of one CPU
+ */
+typedef struct {
+    int cpu;                     // CPU number
+    double net_rx_per_sec;       // NET_RX softirqs
+    double net_tx_per_sec;       // NET_TX softirqs
+    int has_softnet;             // Whether the backlog rates below are valid
+    double processed_per_sec;    // Packets taken off the CPU's backlog
+    double dropped_per_sec;      // Packets dropped because the backlog was full
+    double time_squeeze_per_sec; // NET_RX runs that ran out of budget with work left
+} restrack_irq_cpu_t;
+
+/**
+ * @struct restrack_irq_t
+ * @brief One line of /proc/interrupts and its rate over the last interval
+ */
+typedef struct {
+    char irq[16];                // IRQ number, or a name such as "LOC"
+    char desc[RESTRACK_IRQ_DESC_LEN]; // Controller, trigger and devices, e.g. "GICv2 58 Level eth0"
+    double per_sec;              // Over all CPUs
+    int top_cpu;                 // CPU that handled the most
+    double top_cpu_percent;      // Share of the line handled by top_cpu
+} restrack_irq_t;
+
+/**
+ * @struct restrack_interrupts_t
+ * @brief Softirq, interrupt and packet backlog section of a sample
+ *
+ * Rates are only valid when has_rates is set, i.e. from the second
+ * reading on and while the set of online CPUs stays the same.
+ */
+typedef struct {
+    int has_softirqs;            // Whether /proc/softirqs was read
+    int has_interrupts;          // Whether /proc/interrupts was read
+    int has_softnet;             // Whether /proc/net/softnet_stat was read
+    int has_rates;
+    double interval_ms;          // Time the rates cover
+    int num_softirqs;
+    restrack_softirq_t softirqs[RESTRACK_MAX_SOFTIRQS];
+    int num_cpus;
+    int dropped;                 // CPUs that did not fit in cpus
+    restrack_irq_cpu_t cpus[RESTRACK_MAX_CPUS];
+    int num_irqs;                // Lines of /proc/interrupts
+    double irqs_per_sec;         // Over every line and CPU
+    int num_top_irqs;            // Entries used in top_irqs, 0 when disabled
+    restrack_irq_t top_irqs[RESTRACK_MAX_TOP];   // Busiest first
+} restrack_interrupts_t;
+
+// TCP states as numbered by the kernel, TCP_ESTABLISHED (1) to TCP_CLOSING (11); 0 is unused
+#define RESTRACK_TCP_STATES 12
+
+// Where the TCP socket counts were read from
+#define RESTRACK_TCP_SOURCE_SOCK_DIAG 0
+#define RESTRACK_TCP_SOURCE_SOCKSTAT  1
+
+/**
+ * @struct restrack_connections_t
+ * @brief Connection tracking and TCP socket table section of a sample
+ *
+ * Growth rates are signed and only valid when has_rates is set, i.e. from
+ * the second reading on.
+ */
+typedef struct {
+    int has_conntrack;           // Whether nf_conntrack is loaded
+    uint64_t conntrack_count;
+    uint64_t conntrack_max;
+    double conntrack_usage_percent;
+    int has_tcp;                 // Whether the TCP counts below are valid
+    int tcp_source;              // RESTRACK_TCP_SOURCE_*
+    int has_tcp_states;          // Whether tcp_states is valid (sock_diag only)
+    uint64_t tcp_total;          // TCP sockets of every state, IPv4 and IPv6
+    uint64_t tcp_states[RESTRACK_TCP_STATES];
+    uint64_t tcp_time_wait;
+    uint64_t tcp_max_tw_buckets; // TIME_WAIT limit, 0 when unknown
+    double time_wait_usage_percent;
+    int has_rates;
+    double interval_ms;          // Time the rates cover
+    double conntrack_growth_per_sec;
+    double tcp_growth_per_sec;
+    double established_growth_per_sec;
+} restrack_connections_t;
+
+/**
+ * @struct restrack_protocols_t
+ * @brief IP, TCP and UDP counters of /proc/net/snmp and /proc/net/netstat
+ *
+ * Counters are totals since boot. Rates are only valid when has_rates is
+ * set, i.e. from the second reading on.
+ */
+typedef struct {
+    int has_snmp;                // Whether /proc/net/snmp was read
+    int has_netstat;             // Whether /proc/net/netstat was read
+    uint64_t tcp_retrans_segs;
+    uint64_t tcp_listen_overflows;
+    uint64_t tcp_listen_drops;
+    uint64_t udp_rcvbuf_errors;
+    uint64_t ip_reasm_fails;
+    int has_rates;
+    double interval_ms;          // Time the rates cover
+    double tcp_out_segs_per_sec;
+    double tcp_retrans_segs_per_sec;
+    double tcp_retrans_percent;  // Retransmitted share of the segments sent
+    double tcp_in_errs_per_sec;  // Segments received with errors, e.g. bad checksums
+    double tcp_listen_overflows_per_sec; // Accept queue full
+    double tcp_listen_drops_per_sec;     // SYNs dropped at a listener, overflows included
+    double udp_in_datagrams_per_sec;
+    double udp_in_errors_per_sec;
+    double udp_rcvbuf_errors_per_sec;    // Datagrams dropped on a full socket buffer
+    double ip_reasm_reqds_per_sec;       // Fragments that needed reassembly
+    double ip_reasm_fails_per_sec;
+} restrack_protocols_t;
+
+/**
+ * @struct restrack_thermal_zone_t
+ * @brief Temperature of one thermal zone
+ */
+typedef struct {
+    char name[RESTRACK_NAME_LEN]; // Zone type, e.g. "cpu-thermal"
+    int zone;                    // N of thermal_zoneN
+    double temp_c;
+} restrack_thermal_zone_t;
+
+/**
+ * @struct restrack_cooling_device_t
+ * @brief State of one cooling device; CPU frequency caps are cooling devices too
+ */
+typedef struct {
+    char name[RESTRACK_NAME_LEN]; // Device type, e.g. "cpufreq-cpu0" or "fan"
+    int device;                  // N of cooling_deviceN
+    uint64_t cur_state;          // 0 when not cooling
+    uint64_t max_state;
+} restrack_cooling_device_t;
+
+/**
+ * @struct restrack_cpu_freq_t
+ * @brief Current clock of one CPU and its usage scaled by that clock
+ */
+typedef struct {
+    int cpu;                     // CPU number
+    uint64_t cur_khz;            // scaling_cur_freq
+    uint64_t max_khz;            // cpuinfo_max_freq, 0 when unknown
+    double freq_percent;         // cur_khz as a share of max_khz
+    int has_usage;               // Whether scaled_usage_percent is valid
+    double scaled_usage_percent; // Busy share times freq_percent, i.e. share of full-clock capacity
+} restrack_cpu_freq_t;
+
+/**
+ * @struct restrack_thermal_t
+ * @brief Thermal and CPU frequency section of a sample
+ */
+typedef struct {
+    int supported;               // Whether any zone, cooling device or cpufreq driver exists
+    int num_zones;
+    restrack_thermal_zone_t zones[RESTRACK_MAX_THERMAL_ZONES];
+    int has_max_temp;            // Whether max_temp_c is valid
+    double max_temp_c;           // Hottest zone
+    int num_cooling;
+    restrack_cooling_device_t cooling[RESTRACK_MAX_COOLING_DEVICES];
+    int throttled;               // Whether any cooling device is active
+    int num_cpus;                // CPUs with a cpufreq driver
+    restrack_cpu_freq_t cpus[RESTRACK_MAX_CPUS];
+} restrack_thermal_t;
+
+/**
+ * @struct restrack_zram_t
+ * @brief Compression of one zram device, from its mm_stat
+ */
+typedef struct {
+    char name[16];               // e.g. "zram0"
+    uint64_t orig_data_bytes;    // Data stored, before compression
+    uint64_t compr_data_bytes;   // Same data, compressed
+    uint64_t mem_used_bytes;     // Memory taken, allocator overhead included
+    double compression_ratio;    // orig_data_bytes / compr_data_bytes
+} restrack_zram_t;
+
+/**
+ * @struct restrack_paging_t
+ * @brief Paging, fault and OOM section of a sample, from /proc/vmstat
+ *
+ * Counters are totals since boot. Rates are only valid when has_rates is
+ * set, i.e. from the second reading on.
+ */
+typedef struct {
+    uint64_t pswpin;             // Pages swapped in
+    uint64_t pswpout;            // Pages swapped out
+    uint64_t pgmajfault;         // Faults that waited for I/O
+    uint64_t allocstall;         // Direct reclaim entries, all zones
+    int has_oom_kill;            // Whether oom_kill is valid (Linux 4.13 and later)
+    uint64_t oom_kill;
+    int has_rates;
+    double interval_ms;          // Time the rates cover
+    double pswpin_per_sec;
+    double pswpout_per_sec;
+    double pgmajfault_per_sec;
+    double allocstall_per_sec;
+    double oom_kill_per_sec;
+    int num_zram;                // zram devices holding data
+    restrack_zram_t zram[RESTRACK_MAX_ZRAM];
+    double zram_compression_ratio; // Over every device, 0 without data
+} restrack_paging_t;
+
+/**
+ * @struct restrack_watched_proc_t
+ * @brief A process matching one of the watch patterns
+ */
+typedef struct {
+    char pattern[SYSMON_WATCH_PATTERN_LEN]; // First pattern it matches
+    restrack_proc_t proc;        // cpu_percent and IO rates cover the time since the previous collection
+    uint64_t vm_kb;              // Virtual memory size
+    uint64_t shared_kb;          // Resident memory backed by files or shared with other processes
+    uint64_t start_time;         // Clock ticks after boot
+} restrack_watched_proc_t;
+
+/**
+ * @struct restrack_watched_t
+ * @brief Watched process section of a sample
+ */
+typedef struct {
+    int num_procs;               // Entries used in procs, in /proc order
+    int dropped;                 // Matches beyond RESTRACK_MAX_WATCHED
+    restrack_watched_proc_t procs[RESTRACK_MAX_WATCHED];
+    int num_missing;             // Patterns without any process
+    char missing[SYSMON_MAX_WATCH_PATTERNS][SYSMON_WATCH_PATTERN_LEN];
+    uint64_t scans;              // Scans of /proc so far
+} restrack_watched_t;
+
+/**
+ * @struct restrack_timing_t
+ * @brief How closely the runner kept to its schedule
+ *
+ * Jitter is how late the runner woke up after a deadline. interval_ms is
+ * the measured time between the last two samples, which rate consumers
+ * should prefer over the configured period.
+ */
+typedef struct {
+    uint64_t ticks;              // Samples emitted so far
+    uint64_t overruns;           // Collector runs skipped because the runner fell a full period behind
+    uint64_t monotonic_ms;       // CLOCK_MONOTONIC time of the sample
+    double interval_ms;          // Time since the previous sample
+    double jitter_ms;            // Wake-up lateness of this sample
+    double jitter_avg_ms;        // Mean wake-up lateness
+    double jitter_max_ms;        // Worst wake-up lateness
+} restrack_timing_t;
+
+/**
+ * @struct restrack_sample_t
+ * @brief Latest value of every collector, in fixed-layout tables
+ *
+ * One sample is allocated by the runner. Each collector overwrites its own
+ * section when it runs, so the sample always holds the newest value of
+ * every section; only the sink turns it into JSON.
+ */
+typedef struct {
+    unsigned int valid;          // Bitmask of RESTRACK_HAS_* sections
+    time_t timestamp;            // Wall clock time of the latest collection
+    restrack_cpu_t cpu;
+    restrack_memory_t memory;
+    restrack_load_t load;
+    restrack_disk_t disk;
+    restrack_network_t network;
+    restrack_uptime_t uptime;
+    restrack_process_t processes;
+    restrack_swap_t swap;
+    restrack_pressure_t pressure;
+    restrack_cgroups_t cgroups;
+    restrack_interrupts_t interrupts;
+    restrack_connections_t connections;
+    restrack_protocols_t protocols;
+    restrack_thermal_t thermal;
+    restrack_paging_t paging;
+    restrack_watched_t watched;
+    restrack_timing_t timing;    // Filled by the runner, valid when ticks > 0
+} restrack_sample_t;
+
+/**
+ * @struct ResourceSnapshot
+ * @brief Kernel state read once per tick and shared by the collectors
+ *
+ * Taking the snapshot costs one sysinfo() call and one pass over
+ * /proc/stat, however many collectors use them. The cpu lines of
+ * /proc/stat go straight into the sample's CPU section during that pass;
+ * everything else the collectors need is kept here. Only the first
+ * number of the long intr line is parsed.
+ */
+typedef struct {
+    time_t timestamp;            // Wall clock time shared by the whole sample
+    int has_sysinfo;             // Whether info is valid
+    struct sysinfo info;
+    int has_stat;                // Whether /proc/stat was read
+    int has_cpu_lines;           // Whether the cpu lines were parsed into the sample
+    uint64_t procs_running;
+    uint64_t procs_blocked;
+    int has_counters;            // Whether ctxt, intr and processes were found
+    uint64_t ctxt;
+    uint64_t intr;
+    uint64_t processes;          // Forks since boot
+    uint64_t btime;
+    uint64_t stat_ns;            // CLOCK_MONOTONIC time of the /proc/stat read
+} ResourceSnapshot;
+
+/**
+ * @brief Take the shared snapshot for one collection
+ * @param collectors Bitmask of RESTRACK_HAS_* bits deciding which sources are read
+ * @param sample Sample whose CPU section receives the cpu lines
+ * @param snapshot Snapshot to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int take_resource_snapshot(unsigned int collectors, restrack_sample_t *sample, ResourceSnapshot *snapshot);
+
+/**
+ * @brief Get the collectors enabled by a configuration
+ * @param config Pointer to configuration structure
+ * @return Bitmask of RESTRACK_HAS_* bits
+ */
+unsigned int enabled_resource_mask(const SysmonConfig *config);
 
 /**
  * @brief Collect all system resources based on configuration
  * @param config Pointer to configuration structure
- * @return cJSON object with collected resources or NULL on failure
+ * @param sample Sample to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_all_resources(SysmonConfig *config, restrack_sample_t *sample);
+
+/**
+ * @brief Run some of the collectors, keeping the other sections of the sample
+ * @param config Pointer to configuration structure
+ * @param sample Sample to update
+ * @param collectors Bitmask of RESTRACK_HAS_* bits selecting the collectors;
+ *                   disabled collectors are ignored
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_resources(SysmonConfig *config, restrack_sample_t *sample, unsigned int collectors);
+
+/**
+ * @brief Release the procfs descriptors and buffers held by the collectors
  */
-cJSON* collect_all_resources(SysmonConfig *config);
+void resources_cleanup(void);
 
 /**
  * @brief Collect CPU usage information
- * @return cJSON object with CPU usage data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param cpu CPU section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_cpu_usage(void);
+int collect_cpu_usage(const ResourceSnapshot *snapshot, restrack_cpu_t *cpu);
 
 /**
  * @brief Collect memory usage information
- * @return cJSON object with memory usage data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param memory Memory section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_memory_usage(void);
+int collect_memory_usage(const ResourceSnapshot *snapshot, restrack_memory_t *memory);
 
 /**
  * @brief Collect system load information
- * @return cJSON object with system load data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param load Load section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_system_load(void);
+int collect_system_load(const ResourceSnapshot *snapshot, restrack_load_t *load);
 
 /**
  * @brief Collect disk usage and IO information
- * @return cJSON object with disk usage data or NULL on failure
+ * @param statvfs_timeout_ms Longest wait for statvfs answers of the mounted filesystems
+ * @param disk Disk section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_disk_usage(void);
+int collect_disk_usage(int statvfs_timeout_ms, restrack_disk_t *disk);
 
 /**
  * @brief Collect network statistics
- * @return cJSON object with network statistics or NULL on failure
+ * @param network Network section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_network_stats(void);
+int collect_network_stats(restrack_network_t *network);
 
 /**
  * @brief Collect system uptime information
- * @return cJSON object with uptime data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param uptime Uptime section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_system_uptime(void);
+int collect_system_uptime(const ResourceSnapshot *snapshot, restrack_uptime_t *uptime);
 
 /**
  * @brief Collect process information
- * @return cJSON object with process information or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param top_n Number of processes to rank by CPU and by memory, 0 to skip
+ * @param processes Process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_process_info(void);
+int collect_process_info(const ResourceSnapshot *snapshot, int top_n, restrack_process_t *processes);
 
 /**
  * @brief Collect swap usage information
- * @return cJSON object with swap usage data or NULL on failure
+ * @param snapshot Snapshot of the current tick
+ * @param swap Swap section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_swap_usage(const ResourceSnapshot *snapshot, restrack_swap_t *swap);
+
+/**
+ * @brief Collect pressure stall information
+ * @param pressure Pressure section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_pressure(restrack_pressure_t *pressure);
+
+/**
+ * @brief Collect resource usage of the configured cgroups
+ * @param config Pointer to configuration structure holding the cgroup paths
+ * @param cgroups Cgroup section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_cgroups(const SysmonConfig *config, restrack_cgroups_t *cgroups);
+
+/**
+ * @brief Collect softirq, interrupt and packet backlog rates
+ * @param top_n Number of interrupt lines to rank by rate, 0 to skip
+ * @param interrupts Interrupt section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_interrupts(int top_n, restrack_interrupts_t *interrupts);
+
+/**
+ * @brief Collect conntrack and TCP socket table usage
+ * @param connections Connection section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_connections(restrack_connections_t *connections);
+
+/**
+ * @brief Collect IP, TCP and UDP error rates
+ * @param protocols Protocol section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_protocols(restrack_protocols_t *protocols);
+
+/**
+ * @brief Collect temperatures, cooling states and CPU frequencies
+ * @param cpu CPU section for frequency-scaled usage, or NULL when not collected
+ * @param thermal Thermal section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_thermal(const restrack_cpu_t *cpu, restrack_thermal_t *thermal);
+
+/**
+ * @brief Collect swap, fault and OOM rates and zram compression
+ * @param paging Paging section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int collect_paging(restrack_paging_t *paging);
+
+/**
+ * @brief Collect usage of the processes matching the watch patterns
+ * @param config Configuration holding the patterns
+ * @param watched Watched process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
  */
-cJSON* collect_swap_usage(void);
+int collect_watched(const SysmonConfig *config, restrack_watched_t *watched);
 
 #endif /* RESOURCES_H */
@@ -0,0 +1,322 @@
+/**
+ * @file rtnl.c
+ * @brief Interface statistics over rtnetlink
+ */
+
+#include "rtnl.h"
+#include "procfs.h"
+#include "util.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+// Receive buffer; the kernel fills each dump datagram up to this size
+#define RTNL_RECV_BUF_SIZE 32768
+
+// Longest wait for a dump reply before falling back to /proc/net/dev
+#define RTNL_RECV_TIMEOUT_SEC 1
+
+/**
+ * @struct LinkSpeed
+ * @brief Cached sysfs link speed of one interface
+ */
+typedef struct {
+    int ifindex;
+    unsigned char operstate;     // State the speed was read in
+    int speed_mbps;
+} LinkSpeed;
+
+static int g_rtnl_fd = -1;
+static int g_rtnl_unavailable = 0;
+static uint32_t g_rtnl_seq = 0;
+static char *g_rtnl_buf = NULL;
+
+// Speeds of the links seen by the previous dump, and the one being built
+static LinkSpeed g_speeds[RESTRACK_MAX_INTERFACES];
+static int g_num_speeds = 0;
+static LinkSpeed g_new_speeds[RESTRACK_MAX_INTERFACES];
+static int g_num_new_speeds = 0;
+
+/**
+ * @brief Open the rtnetlink socket and allocate the receive buffer
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int rtnl_open(void) {
+    g_rtnl_buf = (char*)malloc(RTNL_RECV_BUF_SIZE);
+    if (g_rtnl_buf == NULL) {
+        return ERR_MEMORY_ALLOC;
+    }
+
+    g_rtnl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (g_rtnl_fd < 0) {
+        log_message(LOG_WARNING, "rtnetlink unavailable (%s), using /proc/net/dev", strerror(errno));
+        rtnl_cleanup();
+        return ERR_SYS_RESOURCE;
+    }
+
+    struct timeval timeout = { RTNL_RECV_TIMEOUT_SEC, 0 };
+    setsockopt(g_rtnl_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(g_rtnl_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        log_message(LOG_WARNING, "Failed to bind rtnetlink socket (%s), using /proc/net/dev", strerror(errno));
+        rtnl_cleanup();
+        return ERR_SYS_RESOURCE;
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Ask the kernel for a dump of every link
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+static int send_dump_request(void) {
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++g_rtnl_seq;
+    req.ifm.ifi_family = AF_UNSPEC;
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    ssize_t sent;
+    do {
+        sent = sendto(g_rtnl_fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel));
+    } while (sent < 0 && errno == EINTR);
+
+    return sent == (ssize_t)req.nlh.nlmsg_len ? ERR_SUCCESS : ERR_FILE_WRITE;
+}
+
+/**
+ * @brief Read the speed of a link from sysfs
+ * @param name Interface name
+ * @return Speed in Mbit/s, -1 when the driver does not report one
+ */
+static int read_link_speed(const char *name) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/speed", name);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    char buf[16];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    long speed = strtol(buf, NULL, 10);
+    return speed > 0 && speed < INT32_MAX ? (int)speed : -1;
+}
+
+/**
+ * @brief Get the speed of a link, reading sysfs only when it is new or changed state
+ * @param iface Interface with name, index and operstate set
+ * @return Speed in Mbit/s, -1 when unknown
+ */
+static int link_speed(const restrack_iface_t *iface) {
+    int speed = -2;
+    for (int i = 0; i < g_num_speeds; i++) {
+        if (g_speeds[i].ifindex == iface->ifindex && g_speeds[i].operstate == iface->operstate) {
+            speed = g_speeds[i].speed_mbps;
+            break;
+        }
+    }
+    if (speed == -2) {
+        speed = read_link_speed(iface->name);
+    }
+
+    if (g_num_new_speeds < RESTRACK_MAX_INTERFACES) {
+        LinkSpeed *entry = &g_new_speeds[g_num_new_speeds++];
+        entry->ifindex = iface->ifindex;
+        entry->operstate = iface->operstate;
+        entry->speed_mbps = speed;
+    }
+    return speed;
+}
+
+/**
+ * @brief Copy one link message into the network section
+ * @param nlh RTM_NEWLINK message
+ * @param network Network section to append to
+ */
+static void parse_link(struct nlmsghdr *nlh, restrack_network_t *network) {
+    struct ifinfomsg *ifm = (struct ifinfomsg*)NLMSG_DATA(nlh);
+    int len = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(sizeof(*ifm));
+    if (len < 0) {
+        return;
+    }
+
+    if (network->num_interfaces >= RESTRACK_MAX_INTERFACES) {
+        network->dropped++;
+        return;
+    }
+
+    restrack_iface_t *iface = &network->interfaces[network->num_interfaces];
+    memset(iface, 0, sizeof(*iface));
+    iface->has_link_info = 1;
+    iface->ifindex = ifm->ifi_index;
+    iface->flags = ifm->ifi_flags;
+    iface->speed_mbps = -1;
+
+    // Stats structs grew over kernel versions, so copy what is there
+    struct rtnl_link_stats64 stats64;
+    struct rtnl_link_stats stats32;
+    int have_name = 0, have_stats64 = 0, have_stats32 = 0;
+    memset(&stats64, 0, sizeof(stats64));
+    memset(&stats32, 0, sizeof(stats32));
+
+    for (struct rtattr *rta = IFLA_RTA(ifm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        size_t payload = RTA_PAYLOAD(rta);
+        switch (rta->rta_type) {
+            case IFLA_IFNAME:
+                procfs_copy_token(iface->name, sizeof(iface->name), (const char*)RTA_DATA(rta),
+                                  strnlen((const char*)RTA_DATA(rta), payload));
+                have_name = 1;
+                break;
+            case IFLA_MTU:
+                if (payload >= sizeof(uint32_t)) {
+                    uint32_t mtu;
+                    memcpy(&mtu, RTA_DATA(rta), sizeof(mtu));
+                    iface->mtu = mtu;
+                }
+                break;
+            case IFLA_OPERSTATE:
+                if (payload >= 1) {
+                    iface->operstate = *(const unsigned char*)RTA_DATA(rta);
+                }
+                break;
+            case IFLA_STATS64:
+                memcpy(&stats64, RTA_DATA(rta), payload < sizeof(stats64) ? payload : sizeof(stats64));
+                have_stats64 = 1;
+                break;
+            case IFLA_STATS:
+                memcpy(&stats32, RTA_DATA(rta), payload < sizeof(stats32) ? payload : sizeof(stats32));
+                have_stats32 = 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!have_name) {
+        return;
+    }
+
+    if (have_stats64) {
+        iface->rx.bytes = stats64.rx_bytes;
+        iface->rx.packets = stats64.rx_packets;
+        iface->rx.errors = stats64.rx_errors;
+        iface->rx.dropped = stats64.rx_dropped;
+        iface->tx.bytes = stats64.tx_bytes;
+        iface->tx.packets = stats64.tx_packets;
+        iface->tx.errors = stats64.tx_errors;
+        iface->tx.dropped = stats64.tx_dropped;
+        iface->multicast = stats64.multicast;
+        iface->collisions = stats64.collisions;
+    } else if (have_stats32) {
+        iface->rx.bytes = stats32.rx_bytes;
+        iface->rx.packets = stats32.rx_packets;
+        iface->rx.errors = stats32.rx_errors;
+        iface->rx.dropped = stats32.rx_dropped;
+        iface->tx.bytes = stats32.tx_bytes;
+        iface->tx.packets = stats32.tx_packets;
+        iface->tx.errors = stats32.tx_errors;
+        iface->tx.dropped = stats32.tx_dropped;
+        iface->multicast = stats32.multicast;
+        iface->collisions = stats32.collisions;
+    }
+
+    iface->speed_mbps = link_speed(iface);
+    network->num_interfaces++;
+}
+
+/**
+ * @brief Dump every link with one RTM_GETLINK request
+ * @param network Network section to fill
+ * @return ERR_SUCCESS on success, error code if netlink is unusable
+ */
+int rtnl_collect_links(restrack_network_t *network) {
+    if (network == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+    if (g_rtnl_unavailable) {
+        return ERR_SYS_RESOURCE;
+    }
+    if (g_rtnl_fd < 0 && rtnl_open() != ERR_SUCCESS) {
+        g_rtnl_unavailable = 1;
+        return ERR_SYS_RESOURCE;
+    }
+
+    int result = send_dump_request();
+    if (result != ERR_SUCCESS) {
+        return result;
+    }
+
+    network->source = RESTRACK_NET_SOURCE_NETLINK;
+    network->num_interfaces = 0;
+    network->dropped = 0;
+    g_num_new_speeds = 0;
+
+    for (;;) {
+        ssize_t n = recv(g_rtnl_fd, g_rtnl_buf, RTNL_RECV_BUF_SIZE, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_message(LOG_WARNING, "rtnetlink dump failed: %s", strerror(errno));
+            return ERR_FILE_READ;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr *nlh = (struct nlmsghdr*)g_rtnl_buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            // Leftovers of a dump that was abandoned earlier
+            if (nlh->nlmsg_seq != g_rtnl_seq) {
+                continue;
+            }
+
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                memcpy(g_speeds, g_new_speeds, g_num_new_speeds * sizeof(LinkSpeed));
+                g_num_speeds = g_num_new_speeds;
+                return ERR_SUCCESS;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                return ERR_SYS_RESOURCE;
+            }
+            if (nlh->nlmsg_type == RTM_NEWLINK) {
+                parse_link(nlh, network);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Close the netlink socket and release the receive buffer
+ */
+void rtnl_cleanup(void) {
+    if (g_rtnl_fd >= 0) {
+        close(g_rtnl_fd);
+        g_rtnl_fd = -1;
+    }
+    free(g_rtnl_buf);
+    g_rtnl_buf = NULL;
+    g_num_speeds = 0;
+    g_rtnl_unavailable = 0;
+}
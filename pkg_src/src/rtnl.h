@@ -0,0 +1,27 @@
+/**
+ * @file rtnl.h
+ * @brief Interface statistics over rtnetlink
+ */
+
+#ifndef RTNL_H
+#define RTNL_H
+
+#include "resources.h"
+
+/**
+ * @brief Dump every link with one RTM_GETLINK request
+ * @param network Network section to fill
+ * @return ERR_SUCCESS on success, error code if netlink is unusable
+ *
+ * Counters come from IFLA_STATS64 (IFLA_STATS on old kernels) in binary
+ * form, together with the MTU, flags and operstate of the link. Link
+ * speed is read from sysfs only when a link appears or changes state.
+ */
+int rtnl_collect_links(restrack_network_t *network);
+
+/**
+ * @brief Close the netlink socket and release the receive buffer
+ */
+void rtnl_cleanup(void);
+
+#endif /* RTNL_H */
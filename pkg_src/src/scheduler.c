@@ -0,0 +1,135 @@
+/**
+ * @file scheduler.c
+ * @brief Min-heap scheduler of independently timed collectors
+ */
+
+#include "scheduler.h"
+
+/**
+ * @brief Get the current CLOCK_MONOTONIC time
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+uint64_t scheduler_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Get the current CLOCK_MONOTONIC time
+ * @return Milliseconds since an arbitrary fixed point
+ */
+uint64_t scheduler_now_ms(void) {
+    return scheduler_now_ns() / 1000000;
+}
+
+/**
+ * @brief Move an entry towards the root until the heap is ordered
+ * @param scheduler Scheduler
+ * @param index Index of the entry
+ */
+static void sift_up(CollectorScheduler *scheduler, int index) {
+    SchedulerEntry entry = scheduler->heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (scheduler->heap[parent].due_ms <= entry.due_ms) {
+            break;
+        }
+        scheduler->heap[index] = scheduler->heap[parent];
+        index = parent;
+    }
+    scheduler->heap[index] = entry;
+}
+
+/**
+ * @brief Move an entry towards the leaves until the heap is ordered
+ * @param scheduler Scheduler
+ * @param index Index of the entry
+ */
+static void sift_down(CollectorScheduler *scheduler, int index) {
+    SchedulerEntry entry = scheduler->heap[index];
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= scheduler->count) {
+            break;
+        }
+        if (child + 1 < scheduler->count && scheduler->heap[child + 1].due_ms < scheduler->heap[child].due_ms) {
+            child++;
+        }
+        if (entry.due_ms <= scheduler->heap[child].due_ms) {
+            break;
+        }
+        scheduler->heap[index] = scheduler->heap[child];
+        index = child;
+    }
+    scheduler->heap[index] = entry;
+}
+
+/**
+ * @brief Empty the scheduler
+ * @param scheduler Scheduler to initialise
+ */
+void scheduler_init(CollectorScheduler *scheduler) {
+    if (scheduler != NULL) {
+        scheduler->count = 0;
+        scheduler->overruns = 0;
+    }
+}
+
+/**
+ * @brief Add a periodic job
+ * @param scheduler Scheduler
+ * @param id Job id reported when the job is due
+ * @param period_ms Time between runs, must be positive
+ * @param first_ms Time of the first run, in monotonic milliseconds
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int scheduler_add(CollectorScheduler *scheduler, int id, uint64_t period_ms, uint64_t first_ms) {
+    if (scheduler == NULL || period_ms == 0 || scheduler->count >= SCHEDULER_MAX_ENTRIES) {
+        return ERR_INVALID_PARAM;
+    }
+
+    SchedulerEntry *entry = &scheduler->heap[scheduler->count];
+    entry->due_ms = first_ms;
+    entry->period_ms = period_ms;
+    entry->id = id;
+    sift_up(scheduler, scheduler->count++);
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Get the time of the earliest run
+ * @param scheduler Scheduler
+ * @return Monotonic milliseconds of the next run, UINT64_MAX if empty
+ */
+uint64_t scheduler_next_due(const CollectorScheduler *scheduler) {
+    if (scheduler == NULL || scheduler->count == 0) {
+        return UINT64_MAX;
+    }
+    return scheduler->heap[0].due_ms;
+}
+
+/**
+ * @brief Take one job that is due and schedule its next run
+ * @param scheduler Scheduler
+ * @param now_ms Current monotonic time in milliseconds
+ * @param id Receives the id of the due job
+ * @return 1 if a job was due, 0 otherwise
+ */
+int scheduler_pop_due(CollectorScheduler *scheduler, uint64_t now_ms, int *id) {
+    if (scheduler == NULL || scheduler->count == 0 || scheduler->heap[0].due_ms > now_ms) {
+        return 0;
+    }
+
+    SchedulerEntry *entry = &scheduler->heap[0];
+    *id = entry->id;
+
+    // Next deadline on the original grid, skipping runs that were missed
+    uint64_t missed = (now_ms - entry->due_ms) / entry->period_ms;
+    entry->due_ms += (missed + 1) * entry->period_ms;
+    scheduler->overruns += missed;
+    sift_down(scheduler, 0);
+
+    return 1;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file scheduler.h
+ * @brief Min-heap scheduler of independently timed collectors
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "sysmon.h"
+#include <stdint.h>
+
+// Upper bound on scheduled entries
+#define SCHEDULER_MAX_ENTRIES 32
+
+/**
+ * @struct SchedulerEntry
+ * @brief One periodic job in the scheduler
+ */
+typedef struct {
+    uint64_t due_ms;             // Next run, in monotonic milliseconds
+    uint64_t period_ms;          // Time between runs
+    int id;                      // Caller-defined job id
+} SchedulerEntry;
+
+/**
+ * @struct CollectorScheduler
+ * @brief Binary min-heap of jobs ordered by their next run
+ *
+ * Finding the next deadline is O(1) and running a due job is O(log n),
+ * so one thread can drive any mix of fast and slow collectors.
+ * Deadlines advance by whole periods from the first one, so jobs do
+ * not drift, and runs missed while the thread was busy are skipped
+ * rather than replayed back to back.
+ */
+typedef struct {
+    SchedulerEntry heap[SCHEDULER_MAX_ENTRIES];
+    int count;
+    uint64_t overruns;           // Runs skipped because a job was reached a full period late
+} CollectorScheduler;
+
+/**
+ * @brief Get the current CLOCK_MONOTONIC time
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+uint64_t scheduler_now_ns(void);
+
+/**
+ * @brief Get the current CLOCK_MONOTONIC time
+ * @return Milliseconds since an arbitrary fixed point
+ */
+uint64_t scheduler_now_ms(void);
+
+/**
+ * @brief Empty the scheduler
+ * @param scheduler Scheduler to initialise
+ */
+void scheduler_init(CollectorScheduler *scheduler);
+
+/**
+ * @brief Add a periodic job
+ * @param scheduler Scheduler
+ * @param id Job id reported when the job is due
+ * @param period_ms Time between runs, must be positive
+ * @param first_ms Time of the first run, in monotonic milliseconds
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int scheduler_add(CollectorScheduler *scheduler, int id, uint64_t period_ms, uint64_t first_ms);
+
+/**
+ * @brief Get the time of the earliest run
+ * @param scheduler Scheduler
+ * @return Monotonic milliseconds of the next run, UINT64_MAX if empty
+ */
+uint64_t scheduler_next_due(const CollectorScheduler *scheduler);
+
+/**
+ * @brief Take one job that is due and schedule its next run
+ * @param scheduler Scheduler
+ * @param now_ms Current monotonic time in milliseconds
+ * @param id Receives the id of the due job
+ * @return 1 if a job was due, 0 otherwise
+ */
+int scheduler_pop_due(CollectorScheduler *scheduler, uint64_t now_ms, int *id);
+
+#endif /* SCHEDULER_H */
@@ -34,54 +34,7 @@ void on_message(struct mosquitto* mosq, void* userdata, const struct mosquitto_m
                         
                         cJSON* new_config_json = cJSON_GetObjectItemCaseSensitive(cmd_json, "new_config");
                         if (new_config_json && cJSON_IsObject(new_config_json)) {
-                            cJSON* output_path = cJSON_GetObjectItemCaseSensitive(new_config_json, "output_path");
-                            if (output_path && cJSON_IsString(output_path)) {
-                                strncpy(cmd.new_config.output_path, output_path->valuestring, sizeof(cmd.new_config.output_path) - 1);
-                            }
-                            cJSON* log_path = cJSON_GetObjectItemCaseSensitive(new_config_json, "log_path");
-                            if (log_path && cJSON_IsString(log_path)) {
-                                strncpy(cmd.new_config.log_path, log_path->valuestring, sizeof(cmd.new_config.log_path) - 1);
-                            }
-                            cJSON* interval = cJSON_GetObjectItemCaseSensitive(new_config_json, "collection_interval");
-                            if (interval && cJSON_IsNumber(interval)) {
-                                cmd.new_config.collection_interval = interval->valueint;
-                            }
-                            cJSON* verbose = cJSON_GetObjectItemCaseSensitive(new_config_json, "verbose");
-                            if (verbose && cJSON_IsBool(verbose)) {
-                                cmd.new_config.verbose = cJSON_IsTrue(verbose);
-                            }
-                            cJSON* collect_cpu = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_cpu");
-                            if (collect_cpu && cJSON_IsBool(collect_cpu)) {
-                                cmd.new_config.collect_cpu = cJSON_IsTrue(collect_cpu);
-                            }
-                            cJSON* collect_memory = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_memory");
-                            if (collect_memory && cJSON_IsBool(collect_memory)) {
-                                cmd.new_config.collect_memory = cJSON_IsTrue(collect_memory);
-                            }
-                            cJSON* collect_load = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_load");
-                            if (collect_load && cJSON_IsBool(collect_load)) {
-                                cmd.new_config.collect_load = cJSON_IsTrue(collect_load);
-                            }
-                            cJSON* collect_disk = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_disk");
-                            if (collect_disk && cJSON_IsBool(collect_disk)) {
-                                cmd.new_config.collect_disk = cJSON_IsTrue(collect_disk);
-                            }
-                            cJSON* collect_network = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_network");
-                            if (collect_network && cJSON_IsBool(collect_network)) {
-                                cmd.new_config.collect_network = cJSON_IsTrue(collect_network);
-                            }
-                            cJSON* collect_uptime = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_uptime");
-                            if (collect_uptime && cJSON_IsBool(collect_uptime)) {
-                                cmd.new_config.collect_uptime = cJSON_IsTrue(collect_uptime);
-                            }
-                            cJSON* collect_processes = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_processes");
-                            if (collect_processes && cJSON_IsBool(collect_processes)) {
-                                cmd.new_config.collect_processes = cJSON_IsTrue(collect_processes);
-                            }
-                            cJSON* collect_swap = cJSON_GetObjectItemCaseSensitive(new_config_json, "collect_swap");
-                            if (collect_swap && cJSON_IsBool(collect_swap)) {
-                                cmd.new_config.collect_swap = cJSON_IsTrue(collect_swap);
-                            }
+                            config_from_json(new_config_json, &cmd.new_config);
                         }
                         cJSON* action_json = cJSON_GetObjectItemCaseSensitive(cmd_json, "action");
                         if (action_json && cJSON_IsString(action_json)) {
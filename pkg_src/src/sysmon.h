@@ -25,6 +25,12 @@
 #define DEFAULT_OUTPUT_PATH "/var/log/sysmon_data.json"
 #define DEFAULT_LOG_PATH "/var/log/sysmon.log"
 #define DEFAULT_COLLECTION_INTERVAL 5 // seconds
+#define DEFAULT_HISTORY_SIZE 100 // samples kept in memory and in the journal
+#define DEFAULT_PROCESS_TOP_N 5 // processes ranked by CPU and by memory
+#define DEFAULT_IRQ_TOP_N 5 // busiest interrupt lines
+#define DEFAULT_STATVFS_TIMEOUT_MS 200 // wait for statvfs answers per disk collection
+#define DEFAULT_PSI_TRIGGER "some 150000 1000000" // 150 ms of stall within 1 s
+#define DEFAULT_CGROUP_PATH "services/*" // every procd service
 
 // Error codes
 #define ERR_SUCCESS 0
@@ -38,6 +44,56 @@
 #define ERR_CONFIG_MISSING -8
 #define ERR_INVALID_PARAM -9
 
+// Collectors that run on their own schedule; the order matches the
+// RESTRACK_HAS_* section bits
+typedef enum {
+    SYSMON_COLLECTOR_CPU,
+    SYSMON_COLLECTOR_MEMORY,
+    SYSMON_COLLECTOR_LOAD,
+    SYSMON_COLLECTOR_DISK,
+    SYSMON_COLLECTOR_NETWORK,
+    SYSMON_COLLECTOR_UPTIME,
+    SYSMON_COLLECTOR_PROCESSES,
+    SYSMON_COLLECTOR_SWAP,
+    SYSMON_COLLECTOR_PRESSURE,
+    SYSMON_COLLECTOR_CGROUPS,
+    SYSMON_COLLECTOR_INTERRUPTS,
+    SYSMON_COLLECTOR_CONNECTIONS,
+    SYSMON_COLLECTOR_PROTOCOLS,
+    SYSMON_COLLECTOR_THERMAL,
+    SYSMON_COLLECTOR_PAGING,
+    SYSMON_COLLECTOR_WATCHED,
+    SYSMON_COLLECTOR_COUNT
+} SysmonCollector;
+
+// Resources covered by Pressure Stall Information, one file each in /proc/pressure
+typedef enum {
+    SYSMON_PSI_CPU,
+    SYSMON_PSI_MEMORY,
+    SYSMON_PSI_IO,
+    SYSMON_PSI_COUNT
+} SysmonPsiResource;
+
+// Longest PSI trigger, e.g. "some 150000 1000000"
+#define SYSMON_PSI_TRIGGER_LEN 64
+
+// cgroup paths accepted in the configuration, and their longest length
+#define SYSMON_MAX_CGROUP_PATHS 16
+#define SYSMON_CGROUP_PATH_LEN 128
+
+// Process watch patterns accepted in the configuration, and their longest length
+#define SYSMON_MAX_WATCH_PATTERNS 16
+#define SYSMON_WATCH_PATTERN_LEN 64
+
+/**
+ * @struct CollectorSchedule
+ * @brief When one collector runs, relative to the monitor's start
+ */
+typedef struct {
+    int period_ms;               // Time between runs, 0 to use collection_interval
+    int phase_ms;                // Offset of the first run
+} CollectorSchedule;
+
 /**
  * @struct SysmonConfig
  * @brief Structure to hold configuration parameters for the system monitor
@@ -46,6 +102,8 @@ typedef struct {
     char output_path[256];       // Path to output JSON file
     char log_path[256];          // Path to log file
     int collection_interval;     // Collection interval in seconds
+    int collection_interval_ms;  // Collection interval in milliseconds, overrides collection_interval when > 0
+    int history_size;            // Number of samples kept in history
     int verbose;                 // Verbose output flag
     
     // Resource collection flags
@@ -57,6 +115,26 @@ typedef struct {
     int collect_uptime;          // Collect system uptime
     int collect_processes;       // Collect process information
     int collect_swap;            // Collect swap usage
+    int collect_pressure;        // Collect pressure stall information
+    int collect_cgroups;         // Collect per-cgroup resource usage
+    int collect_interrupts;      // Collect softirq, interrupt and packet backlog rates
+    int collect_connections;     // Collect conntrack and TCP socket table usage
+    int collect_protocols;       // Collect IP, TCP and UDP error rates
+    int collect_thermal;         // Collect temperatures, cooling states and CPU frequencies
+    int collect_paging;          // Collect swap, fault and OOM rates and zram compression
+    int collect_watched;         // Collect usage of the processes matching watch_patterns
+    int process_top_n;           // Processes ranked by CPU and by memory, 0 to disable
+    int irq_top_n;               // Interrupt lines ranked by rate, 0 to disable
+    int link_events;             // Push link and address changes as they happen
+    int statvfs_timeout_ms;      // Longest wait for statvfs answers per disk collection
+    char psi_triggers[SYSMON_PSI_COUNT][SYSMON_PSI_TRIGGER_LEN]; // Kernel PSI triggers by SysmonPsiResource, "" for none
+    int num_cgroup_paths;        // Entries used in cgroup_paths
+    char cgroup_paths[SYSMON_MAX_CGROUP_PATHS][SYSMON_CGROUP_PATH_LEN]; // cgroups below the cgroup2 mount, "dir/*" for every child
+    int num_watch_patterns;      // Entries used in watch_patterns
+    char watch_patterns[SYSMON_MAX_WATCH_PATTERNS][SYSMON_WATCH_PATTERN_LEN]; // Shell patterns for comm, argv[0] or the command line
+
+    // Per-collector schedules, indexed by SysmonCollector
+    CollectorSchedule schedules[SYSMON_COLLECTOR_COUNT];
 } SysmonConfig;
 
 // Function declarations
@@ -0,0 +1,461 @@
+/**
+ * @file thermal.c
+ * @brief Thermal zones, cooling devices and CPU frequencies from sysfs
+ */
+
+#include "thermal.h"
+#include "procfs.h"
+#include "util.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#define THERMAL_CLASS_DIR "/sys/class/thermal"
+#define CPU_SYSFS_DIR "/sys/devices/system/cpu"
+
+// Directory of one entry, sized for the longer prefix and any d_name
+#define THERMAL_DIR_LEN (sizeof(CPU_SYSFS_DIR "/") + NAME_MAX)
+
+// Attribute below such a directory, e.g. ".../cpu3/cpufreq/cpuinfo_max_freq"
+#define THERMAL_PATH_LEN (THERMAL_DIR_LEN + 32)
+
+/**
+ * @struct ZoneEntry
+ * @brief An open thermal_zone temp file
+ */
+typedef struct {
+    int zone;                    // N of thermal_zoneN
+    int fd;
+    char name[RESTRACK_NAME_LEN]; // Zone type, e.g. "cpu-thermal"
+} ZoneEntry;
+
+/**
+ * @struct CoolingEntry
+ * @brief An open cooling_device cur_state file
+ */
+typedef struct {
+    int device;                  // N of cooling_deviceN
+    int fd;
+    uint64_t max_state;          // Read once; it does not change
+    char name[RESTRACK_NAME_LEN]; // Device type, e.g. "cpufreq-cpu0" or "fan"
+} CoolingEntry;
+
+/**
+ * @struct FreqEntry
+ * @brief An open scaling_cur_freq file of one CPU
+ */
+typedef struct {
+    int cpu;
+    int fd;
+    uint64_t max_khz;            // cpuinfo_max_freq, 0 when unknown
+} FreqEntry;
+
+static ZoneEntry g_zones[RESTRACK_MAX_THERMAL_ZONES];
+static int g_num_zones = 0;
+static CoolingEntry g_cooling[RESTRACK_MAX_COOLING_DEVICES];
+static int g_num_cooling = 0;
+static FreqEntry g_freqs[RESTRACK_MAX_CPUS];
+static int g_num_freqs = 0;
+
+// Online CPU list at discovery; a different list means a CPU was plugged or unplugged
+static ProcfsFile g_cpu_online = PROCFS_FILE_INIT_CAP(CPU_SYSFS_DIR "/online", 64);
+static char *g_online_list = NULL;
+static size_t g_online_len = 0;
+static int g_discovered = 0;
+static int g_stale = 0;          // A tracked device was removed; discover again
+
+/**
+ * @brief Read a sysfs attribute from its start
+ * @param fd Open attribute
+ * @param buf Buffer receiving the contents, NUL terminated
+ * @param size Size of buf
+ * @return Bytes read, -1 on error
+ */
+static ssize_t read_at_start(int fd, char *buf, size_t size) {
+    ssize_t n;
+    do {
+        n = pread(fd, buf, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+/**
+ * @brief Read a signed number from an open attribute
+ * @param fd Open attribute
+ * @param value Receives the number
+ * @return 1 on success, 0 otherwise
+ */
+static int read_number(int fd, int64_t *value) {
+    char buf[32];
+    if (read_at_start(fd, buf, sizeof(buf)) <= 0) {
+        return 0;
+    }
+
+    char *end;
+    errno = 0;
+    long long parsed = strtoll(buf, &end, 10);
+    if (errno != 0 || end == buf) {
+        return 0;
+    }
+    *value = parsed;
+    return 1;
+}
+
+/**
+ * @brief Open a sysfs attribute below a directory
+ * @param dir Directory path
+ * @param name Attribute path relative to dir
+ * @return Descriptor, -1 on failure
+ */
+static int open_attr(const char *dir, const char *name) {
+    char path[THERMAL_PATH_LEN];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * @brief Read an attribute once, without keeping it open
+ * @param dir Directory path
+ * @param name Attribute path relative to dir
+ * @param buf Buffer receiving the contents without the trailing newline
+ * @param size Size of buf
+ * @return 1 on success, 0 otherwise
+ */
+static int read_attr_once(const char *dir, const char *name, char *buf, size_t size) {
+    int fd = open_attr(dir, name);
+    if (fd < 0) {
+        return 0;
+    }
+
+    ssize_t n = read_at_start(fd, buf, size);
+    close(fd);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Parse a directory name of the form <prefix><number>
+ * @param name Directory name
+ * @param prefix Expected prefix, e.g. "thermal_zone"
+ * @param number Receives the number
+ * @return 1 if the name matches, 0 otherwise
+ */
+static int parse_numbered(const char *name, const char *prefix, int *number) {
+    size_t len = strlen(prefix);
+    if (strncmp(name, prefix, len) != 0 || name[len] < '0' || name[len] > '9') {
+        return 0;
+    }
+
+    char *end;
+    long value = strtol(name + len, &end, 10);
+    if (*end != '\0' || value > INT_MAX) {
+        return 0;
+    }
+    *number = (int)value;
+    return 1;
+}
+
+/**
+ * @brief Close every file and empty the tables
+ */
+static void close_all(void) {
+    for (int i = 0; i < g_num_zones; i++) {
+        close(g_zones[i].fd);
+    }
+    for (int i = 0; i < g_num_cooling; i++) {
+        close(g_cooling[i].fd);
+    }
+    for (int i = 0; i < g_num_freqs; i++) {
+        close(g_freqs[i].fd);
+    }
+    g_num_zones = 0;
+    g_num_cooling = 0;
+    g_num_freqs = 0;
+}
+
+/**
+ * @brief Track a thermal zone, keeping the table ordered by number
+ * @param dir Zone directory
+ * @param zone Zone number
+ */
+static void add_zone(const char *dir, int zone) {
+    if (g_num_zones >= RESTRACK_MAX_THERMAL_ZONES) {
+        return;
+    }
+
+    int fd = open_attr(dir, "temp");
+    if (fd < 0) {
+        return;
+    }
+
+    int pos = g_num_zones;
+    while (pos > 0 && g_zones[pos - 1].zone > zone) {
+        g_zones[pos] = g_zones[pos - 1];
+        pos--;
+    }
+
+    ZoneEntry *entry = &g_zones[pos];
+    entry->zone = zone;
+    entry->fd = fd;
+    if (!read_attr_once(dir, "type", entry->name, sizeof(entry->name))) {
+        snprintf(entry->name, sizeof(entry->name), "thermal_zone%d", zone);
+    }
+    g_num_zones++;
+}
+
+/**
+ * @brief Track a cooling device, keeping the table ordered by number
+ * @param dir Device directory
+ * @param device Device number
+ */
+static void add_cooling(const char *dir, int device) {
+    if (g_num_cooling >= RESTRACK_MAX_COOLING_DEVICES) {
+        return;
+    }
+
+    char max_state[32];
+    if (!read_attr_once(dir, "max_state", max_state, sizeof(max_state))) {
+        return;
+    }
+    int fd = open_attr(dir, "cur_state");
+    if (fd < 0) {
+        return;
+    }
+
+    int pos = g_num_cooling;
+    while (pos > 0 && g_cooling[pos - 1].device > device) {
+        g_cooling[pos] = g_cooling[pos - 1];
+        pos--;
+    }
+
+    CoolingEntry *entry = &g_cooling[pos];
+    entry->device = device;
+    entry->fd = fd;
+    entry->max_state = strtoull(max_state, NULL, 10);
+    if (!read_attr_once(dir, "type", entry->name, sizeof(entry->name))) {
+        snprintf(entry->name, sizeof(entry->name), "cooling_device%d", device);
+    }
+    g_num_cooling++;
+}
+
+/**
+ * @brief Track the current frequency of a CPU, keeping the table ordered by number
+ * @param dir CPU directory
+ * @param cpu CPU number
+ */
+static void add_freq(const char *dir, int cpu) {
+    if (g_num_freqs >= RESTRACK_MAX_CPUS) {
+        return;
+    }
+
+    // CPUs without a cpufreq driver, or offline ones, have no such file
+    int fd = open_attr(dir, "cpufreq/scaling_cur_freq");
+    if (fd < 0) {
+        return;
+    }
+
+    int pos = g_num_freqs;
+    while (pos > 0 && g_freqs[pos - 1].cpu > cpu) {
+        g_freqs[pos] = g_freqs[pos - 1];
+        pos--;
+    }
+
+    FreqEntry *entry = &g_freqs[pos];
+    entry->cpu = cpu;
+    entry->fd = fd;
+
+    char max_khz[32];
+    entry->max_khz = read_attr_once(dir, "cpufreq/cpuinfo_max_freq", max_khz, sizeof(max_khz)) ?
+                     strtoull(max_khz, NULL, 10) : 0;
+    g_num_freqs++;
+}
+
+/**
+ * @brief Open the files of every thermal zone, cooling device and CPU
+ */
+static void discover(void) {
+    close_all();
+
+    char dir[THERMAL_DIR_LEN];
+    DIR *thermal = opendir(THERMAL_CLASS_DIR);
+    if (thermal != NULL) {
+        struct dirent *ent;
+        while ((ent = readdir(thermal)) != NULL) {
+            int number;
+            if (parse_numbered(ent->d_name, "thermal_zone", &number)) {
+                snprintf(dir, sizeof(dir), THERMAL_CLASS_DIR "/%s", ent->d_name);
+                add_zone(dir, number);
+            } else if (parse_numbered(ent->d_name, "cooling_device", &number)) {
+                snprintf(dir, sizeof(dir), THERMAL_CLASS_DIR "/%s", ent->d_name);
+                add_cooling(dir, number);
+            }
+        }
+        closedir(thermal);
+    }
+
+    DIR *cpus = opendir(CPU_SYSFS_DIR);
+    if (cpus != NULL) {
+        struct dirent *ent;
+        while ((ent = readdir(cpus)) != NULL) {
+            int number;
+            if (parse_numbered(ent->d_name, "cpu", &number)) {
+                snprintf(dir, sizeof(dir), CPU_SYSFS_DIR "/%s", ent->d_name);
+                add_freq(dir, number);
+            }
+        }
+        closedir(cpus);
+    }
+
+    g_discovered = 1;
+    g_stale = 0;
+}
+
+/**
+ * @brief Check the online CPU list against the one seen at discovery
+ * @return 1 if CPUs were plugged or unplugged since, 0 otherwise
+ */
+static int cpus_changed(void) {
+    if (procfs_try_read(&g_cpu_online) != ERR_SUCCESS) {
+        return 0;
+    }
+
+    // Lists of sparse CPUs on large hosts do not fit a fixed buffer
+    size_t len = g_cpu_online.len;
+    if (g_online_list != NULL && len == g_online_len && memcmp(g_cpu_online.buf, g_online_list, len) == 0) {
+        return 0;
+    }
+
+    char *list = (char*)realloc(g_online_list, len + 1);
+    if (list == NULL) {
+        return 1;
+    }
+    memcpy(list, g_cpu_online.buf, len + 1);
+    g_online_list = list;
+    g_online_len = len;
+    return 1;
+}
+
+/**
+ * @brief Read temperatures, cooling states and CPU frequencies
+ * @param cpu CPU section of the same sample for frequency-scaled usage, or NULL
+ * @param thermal Thermal section to fill
+ * @return ERR_SUCCESS if any of the files was read or the host has none,
+ *         error code otherwise
+ */
+int thermal_collect(const restrack_cpu_t *cpu, restrack_thermal_t *thermal) {
+    if (thermal == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    // The online list is read every call so the first change is never missed
+    if (cpus_changed() || !g_discovered || g_stale) {
+        discover();
+    }
+
+    thermal->num_zones = 0;
+    thermal->has_max_temp = 0;
+    thermal->max_temp_c = 0.0;
+    for (int i = 0; i < g_num_zones; i++) {
+        int64_t millidegrees;
+        if (!read_number(g_zones[i].fd, &millidegrees)) {
+            // Some sensors fail while asleep; only a removed zone means discovery is due
+            if (errno == ENODEV) {
+                g_stale = 1;
+            }
+            continue;
+        }
+
+        restrack_thermal_zone_t *zone = &thermal->zones[thermal->num_zones++];
+        snprintf(zone->name, sizeof(zone->name), "%s", g_zones[i].name);
+        zone->zone = g_zones[i].zone;
+        zone->temp_c = millidegrees / 1000.0;
+        if (!thermal->has_max_temp || zone->temp_c > thermal->max_temp_c) {
+            thermal->has_max_temp = 1;
+            thermal->max_temp_c = zone->temp_c;
+        }
+    }
+
+    thermal->num_cooling = 0;
+    thermal->throttled = 0;
+    for (int i = 0; i < g_num_cooling; i++) {
+        int64_t state;
+        if (!read_number(g_cooling[i].fd, &state) || state < 0) {
+            if (errno == ENODEV) {
+                g_stale = 1;
+            }
+            continue;
+        }
+
+        restrack_cooling_device_t *device = &thermal->cooling[thermal->num_cooling++];
+        snprintf(device->name, sizeof(device->name), "%s", g_cooling[i].name);
+        device->device = g_cooling[i].device;
+        device->cur_state = (uint64_t)state;
+        device->max_state = g_cooling[i].max_state;
+        if (state > 0) {
+            thermal->throttled = 1;
+        }
+    }
+
+    // Both tables are ordered by CPU number, so one merge pass pairs them
+    int usage_pos = 0;
+    thermal->num_cpus = 0;
+    for (int i = 0; i < g_num_freqs; i++) {
+        int64_t khz;
+        if (!read_number(g_freqs[i].fd, &khz) || khz < 0) {
+            if (errno == ENODEV) {
+                g_stale = 1;
+            }
+            continue;
+        }
+
+        restrack_cpu_freq_t *freq = &thermal->cpus[thermal->num_cpus++];
+        freq->cpu = g_freqs[i].cpu;
+        freq->cur_khz = (uint64_t)khz;
+        freq->max_khz = g_freqs[i].max_khz;
+        freq->freq_percent = freq->max_khz > 0 ? 100.0 * freq->cur_khz / freq->max_khz : 0.0;
+
+        // Busy time at half the top clock is half the work the CPU could do
+        freq->has_usage = 0;
+        freq->scaled_usage_percent = 0.0;
+        if (cpu != NULL && freq->max_khz > 0) {
+            while (usage_pos < cpu->num_cpus && cpu->cpus[usage_pos].id < freq->cpu) {
+                usage_pos++;
+            }
+            if (usage_pos < cpu->num_cpus && cpu->cpus[usage_pos].id == freq->cpu &&
+                cpu->cpus[usage_pos].has_percent) {
+                freq->has_usage = 1;
+                freq->scaled_usage_percent = cpu->cpus[usage_pos].usage_percent * freq->freq_percent / 100.0;
+            }
+        }
+    }
+
+    // Hosts without zones, cooling devices or cpufreq report an empty section
+    thermal->supported = g_num_zones > 0 || g_num_cooling > 0 || g_num_freqs > 0;
+    if (!thermal->supported) {
+        return ERR_SUCCESS;
+    }
+    return thermal->num_zones > 0 || thermal->num_cooling > 0 || thermal->num_cpus > 0 ?
+           ERR_SUCCESS : ERR_FILE_READ;
+}
+
+/**
+ * @brief Close the files and forget what was discovered
+ */
+void thermal_cleanup(void) {
+    close_all();
+    procfs_close(&g_cpu_online);
+    free(g_online_list);
+    g_online_list = NULL;
+    g_online_len = 0;
+    g_discovered = 0;
+    g_stale = 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file thermal.h
+ * @brief Thermal zones, cooling devices and CPU frequencies from sysfs
+ */
+
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include "resources.h"
+
+/**
+ * @brief Read temperatures, cooling states and CPU frequencies
+ * @param cpu CPU section of the same sample for frequency-scaled usage, or NULL
+ * @param thermal Thermal section to fill
+ * @return ERR_SUCCESS if any of the files was read, error code otherwise
+ *
+ * The thermal zones, cooling devices and cpufreq files are discovered on
+ * the first call and kept open, so each later call costs one pread() per
+ * file. Discovery runs again only when the set of online CPUs changes or
+ * one of the files stops reading, as happens on hotplug.
+ */
+int thermal_collect(const restrack_cpu_t *cpu, restrack_thermal_t *thermal);
+
+/**
+ * @brief Close the files and forget what was discovered
+ */
+void thermal_cleanup(void);
+
+#endif /* THERMAL_H */
@@ -0,0 +1,183 @@
+/**
+ * @file ticker.c
+ * @brief Sleeping until absolute CLOCK_MONOTONIC deadlines
+ */
+
+#include "ticker.h"
+#include "util.h"
+#include <poll.h>
+#include <sys/timerfd.h>
+
+/**
+ * @brief Convert nanoseconds to a timespec
+ * @param ns Nanoseconds
+ * @return Equivalent timespec
+ */
+static struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    return ts;
+}
+
+/**
+ * @brief Prepare a ticker
+ * @param ticker Ticker to initialise
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int ticker_open(SysmonTicker *ticker) {
+    if (ticker == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    ticker->num_watches = 0;
+    ticker->interrupted = 0;
+    ticker->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (ticker->fd < 0) {
+        log_message(LOG_WARNING, "timerfd unavailable (%s), using clock_nanosleep", strerror(errno));
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Service a descriptor while waiting
+ * @param ticker Open ticker
+ * @param fd Descriptor to poll
+ * @param events poll() events of interest
+ * @param handler Called from ticker_wait_until() when the descriptor is ready
+ * @param ctx Passed to the handler
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int ticker_watch(SysmonTicker *ticker, int fd, short events, TickerHandler handler, void *ctx) {
+    if (ticker == NULL || fd < 0 || handler == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+    if (ticker->num_watches >= TICKER_MAX_WATCHES) {
+        return ERR_SYS_RESOURCE;
+    }
+
+    TickerWatch *watch = &ticker->watches[ticker->num_watches++];
+    watch->fd = fd;
+    watch->events = events;
+    watch->handler = handler;
+    watch->ctx = ctx;
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Milliseconds left until a deadline, rounded up
+ * @param deadline_ns CLOCK_MONOTONIC deadline in nanoseconds
+ * @return Milliseconds to wait, 0 once the deadline has passed
+ */
+static int ms_until(uint64_t deadline_ns) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    if (now_ns >= deadline_ns) {
+        return 0;
+    }
+
+    uint64_t ms = (deadline_ns - now_ns + 999999ULL) / 1000000ULL;
+    return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
+
+/**
+ * @brief Sleep until an absolute deadline
+ * @param ticker Open ticker
+ * @param deadline_ns CLOCK_MONOTONIC deadline in nanoseconds
+ * @return ERR_SUCCESS once the deadline has passed or a handler called
+ *         ticker_interrupt(), error code if the wait was interrupted early
+ */
+int ticker_wait_until(SysmonTicker *ticker, uint64_t deadline_ns) {
+    if (ticker == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    struct timespec deadline = ns_to_timespec(deadline_ns);
+
+    if (ticker->fd < 0 && ticker->num_watches == 0) {
+        int rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        return rc == 0 ? ERR_SUCCESS : ERR_SYS_RESOURCE;
+    }
+
+    if (ticker->fd >= 0) {
+        // A zero it_value would disarm the timer, so deadlines at 0 fire at once
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value = deadline;
+        if (deadline_ns == 0) {
+            spec.it_value.tv_nsec = 1;
+        }
+        if (timerfd_settime(ticker->fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+            return ERR_SYS_RESOURCE;
+        }
+    }
+
+    // Slot 0 is the timerfd; poll() ignores it when negative
+    struct pollfd pfds[TICKER_MAX_WATCHES + 1];
+    pfds[0].fd = ticker->fd;
+    pfds[0].events = POLLIN;
+    for (int i = 0; i < ticker->num_watches; i++) {
+        pfds[i + 1].fd = ticker->watches[i].fd;
+        pfds[i + 1].events = ticker->watches[i].events;
+    }
+    nfds_t nfds = (nfds_t)ticker->num_watches + 1;
+
+    for (;;) {
+        int timeout = -1;
+        if (ticker->fd < 0) {
+            timeout = ms_until(deadline_ns);
+            if (timeout == 0) {
+                return ERR_SUCCESS;
+            }
+        }
+
+        int ready = poll(pfds, nfds, timeout);
+        if (ready < 0) {
+            return ERR_SYS_RESOURCE;
+        }
+
+        for (nfds_t i = 1; i < nfds; i++) {
+            if (pfds[i].revents != 0) {
+                TickerWatch *watch = &ticker->watches[i - 1];
+                watch->handler(watch->fd, pfds[i].revents, watch->ctx);
+            }
+        }
+
+        // The timerfd stays armed; the next wait sets a new deadline
+        if (ticker->interrupted) {
+            ticker->interrupted = 0;
+            return ERR_SUCCESS;
+        }
+
+        if (ticker->fd >= 0 && (pfds[0].revents & POLLIN)) {
+            uint64_t expirations;
+            if (read(ticker->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                return ERR_SYS_RESOURCE;
+            }
+            return ERR_SUCCESS;
+        }
+    }
+}
+
+/**
+ * @brief End the current wait once the running handlers return
+ * @param ticker Ticker whose handler is running
+ */
+void ticker_interrupt(SysmonTicker *ticker) {
+    if (ticker != NULL) {
+        ticker->interrupted = 1;
+    }
+}
+
+/**
+ * @brief Release the ticker
+ * @param ticker Ticker to close
+ */
+void ticker_close(SysmonTicker *ticker) {
+    if (ticker != NULL && ticker->fd >= 0) {
+        close(ticker->fd);
+        ticker->fd = -1;
+    }
+}
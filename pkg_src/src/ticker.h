@@ -0,0 +1,95 @@
+/**
+ * @file ticker.h
+ * @brief Sleeping until absolute CLOCK_MONOTONIC deadlines
+ */
+
+#ifndef TICKER_H
+#define TICKER_H
+
+#include "sysmon.h"
+#include <stdint.h>
+
+// Upper bound on descriptors watched while waiting
+#define TICKER_MAX_WATCHES 8
+
+/**
+ * @brief Called when a watched descriptor becomes ready
+ * @param fd Ready descriptor
+ * @param revents poll() events that fired
+ * @param ctx Context given to ticker_watch()
+ */
+typedef void (*TickerHandler)(int fd, short revents, void *ctx);
+
+/**
+ * @struct TickerWatch
+ * @brief A descriptor serviced while the ticker waits
+ */
+typedef struct {
+    int fd;
+    short events;                // poll() events of interest
+    TickerHandler handler;
+    void *ctx;
+} TickerWatch;
+
+/**
+ * @struct SysmonTicker
+ * @brief Wakes the runner at absolute deadlines
+ *
+ * Deadlines are absolute CLOCK_MONOTONIC times, so the time spent
+ * collecting and writing does not push the next tick back, and wall
+ * clock changes do not move it. A timerfd is used when the kernel has
+ * one; otherwise clock_nanosleep(TIMER_ABSTIME) does the same job.
+ *
+ * Event sources such as netlink sockets can be watched; their handlers
+ * run as soon as they are ready, without waiting for the next tick, and
+ * can end the wait early with ticker_interrupt().
+ */
+typedef struct {
+    int fd;                      // timerfd, -1 when clock_nanosleep is used
+    int interrupted;             // Set by ticker_interrupt() during a wait
+    int num_watches;
+    TickerWatch watches[TICKER_MAX_WATCHES];
+} SysmonTicker;
+
+/**
+ * @brief Prepare a ticker
+ * @param ticker Ticker to initialise
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int ticker_open(SysmonTicker *ticker);
+
+/**
+ * @brief Service a descriptor while waiting
+ * @param ticker Open ticker
+ * @param fd Descriptor to poll
+ * @param events poll() events of interest
+ * @param handler Called from ticker_wait_until() when the descriptor is ready
+ * @param ctx Passed to the handler
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int ticker_watch(SysmonTicker *ticker, int fd, short events, TickerHandler handler, void *ctx);
+
+/**
+ * @brief Sleep until an absolute deadline
+ * @param ticker Open ticker
+ * @param deadline_ns CLOCK_MONOTONIC deadline in nanoseconds
+ * @return ERR_SUCCESS once the deadline has passed or a handler called
+ *         ticker_interrupt(), error code if the wait was interrupted early
+ *
+ * Handlers of watched descriptors run inside the wait as they become ready.
+ */
+int ticker_wait_until(SysmonTicker *ticker, uint64_t deadline_ns);
+
+/**
+ * @brief End the current wait once the running handlers return
+ * @param ticker Ticker whose handler is running
+ */
+void ticker_interrupt(SysmonTicker *ticker);
+
+/**
+ * @brief Release the ticker
+ * @param ticker Ticker to close
+ */
+void ticker_close(SysmonTicker *ticker);
+
+#endif /* TICKER_H */
@@ -161,6 +161,55 @@ int write_file(const char *file_path, const char *content) {
     return ERR_SUCCESS;
 }
 
+/**
+ * @brief Replace a file atomically by writing a sibling and renaming it
+ * @param file_path Path to the file to replace
+ * @param content Data to write to the file
+ * @param len Length of the data in bytes
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int write_file_atomic(const char *file_path, const char *content, size_t len) {
+    if (file_path == NULL || content == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", file_path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        log_message(LOG_ERROR, "Failed to open file %s for writing: %s", tmp_path, strerror(errno));
+        return ERR_FILE_OPEN;
+    }
+
+    const char *p = content;
+    size_t remaining = len;
+    while (remaining > 0) {
+        ssize_t n = write(fd, p, remaining);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_message(LOG_ERROR, "Failed to write entire content to %s: %s", tmp_path, strerror(errno));
+            close(fd);
+            unlink(tmp_path);
+            return ERR_FILE_WRITE;
+        }
+        p += n;
+        remaining -= n;
+    }
+    close(fd);
+
+    // Readers only ever see the old or the new file, never a partial one
+    if (rename(tmp_path, file_path) != 0) {
+        log_message(LOG_ERROR, "Failed to rename %s to %s: %s", tmp_path, file_path, strerror(errno));
+        unlink(tmp_path);
+        return ERR_FILE_WRITE;
+    }
+
+    return ERR_SUCCESS;
+}
+
 /**
  * @brief Add current timestamp to a JSON object
  * @param json_obj JSON object to add timestamp to
@@ -40,6 +40,15 @@ char* read_file(const char *file_path);
  */
 int write_file(const char *file_path, const char *content);
 
+/**
+ * @brief Replace a file atomically by writing a sibling and renaming it
+ * @param file_path Path to the file to replace
+ * @param content Data to write to the file
+ * @param len Length of the data in bytes
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int write_file_atomic(const char *file_path, const char *content, size_t len);
+
 /**
  * @brief Add current timestamp to a JSON object
  * @param json_obj JSON object to add timestamp to
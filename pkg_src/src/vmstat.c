@@ -0,0 +1,324 @@
+/**
+ * @file vmstat.c
+ * @brief Paging, fault and OOM rates from /proc/vmstat, zram compression from sysfs
+ */
+
+#include "vmstat.h"
+#include "procfs.h"
+#include <dirent.h>
+#include <fcntl.h>
+
+// Lines of /proc/vmstat covered by the index; current kernels have about 180
+#define VMSTAT_MAX_LINES 320
+
+// Calls between looks for zram devices while none is found
+#define ZRAM_RESCAN_CALLS 30
+
+// Counters read from /proc/vmstat
+enum {
+    VMSTAT_PSWPIN,
+    VMSTAT_PSWPOUT,
+    VMSTAT_PGMAJFAULT,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_OOM_KILL,
+    VMSTAT_COUNTERS
+};
+
+/**
+ * @struct VmstatKey
+ * @brief A key of /proc/vmstat and the counter it adds to
+ */
+typedef struct {
+    const char *name;
+    int counter;                 // VMSTAT_* counter
+} VmstatKey;
+
+// Direct reclaim stalls are split per zone since Linux 4.8 and summed here
+static const VmstatKey g_keys[] = {
+    { "pswpin", VMSTAT_PSWPIN },
+    { "pswpout", VMSTAT_PSWPOUT },
+    { "pgmajfault", VMSTAT_PGMAJFAULT },
+    { "allocstall", VMSTAT_ALLOCSTALL },
+    { "allocstall_dma", VMSTAT_ALLOCSTALL },
+    { "allocstall_dma32", VMSTAT_ALLOCSTALL },
+    { "allocstall_normal", VMSTAT_ALLOCSTALL },
+    { "allocstall_movable", VMSTAT_ALLOCSTALL },
+    { "allocstall_device", VMSTAT_ALLOCSTALL },
+    { "oom_kill", VMSTAT_OOM_KILL }
+};
+
+#define VMSTAT_KEYS ((int)(sizeof(g_keys) / sizeof(g_keys[0])))
+
+/**
+ * @struct ZramDevice
+ * @brief An open zram mm_stat file
+ */
+typedef struct {
+    char name[16];               // e.g. "zram0"
+    int fd;
+} ZramDevice;
+
+static ProcfsFile g_proc_vmstat = PROCFS_FILE_INIT_CAP("/proc/vmstat", 8192);
+
+// Key fed by each line of the file, -1 for lines that are not needed
+static signed char g_line_key[VMSTAT_MAX_LINES];
+static int g_num_lines = 0;
+
+static ZramDevice g_zram[RESTRACK_MAX_ZRAM];
+static int g_num_zram = 0;
+static unsigned int g_calls = 0;
+
+// Previous reading, for the rates
+static int g_has_prev = 0;
+static unsigned int g_prev_found = 0;
+static uint64_t g_prev_ns = 0;
+static uint64_t g_prev[VMSTAT_COUNTERS];
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Map a key of /proc/vmstat to its entry in g_keys
+ * @param key Start of the key
+ * @param len Length of the key
+ * @return Index in g_keys, -1 if the key is not needed
+ */
+static int key_index(const char *key, size_t len) {
+    for (int i = 0; i < VMSTAT_KEYS; i++) {
+        if (procfs_token_equals(key, len, g_keys[i].name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse the buffer of the last read, through the line index
+ * @param values Receives the counters
+ * @param found Receives a bitmask of the counters seen
+ * @return 1 on success, 0 if the index no longer matches the file
+ */
+static int parse_indexed(uint64_t *values, unsigned int *found) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_vmstat);
+
+    *found = 0;
+    for (int i = 0; procfs_next_line(&file, &line); i++) {
+        // Lines past a full index are ignored, new lines of a short one mean a different file
+        if (i >= g_num_lines) {
+            return g_num_lines == VMSTAT_MAX_LINES;
+        }
+
+        int key = g_line_key[i];
+        if (key < 0) {
+            continue;
+        }
+
+        const char *name;
+        size_t name_len;
+        uint64_t value;
+        if (!procfs_next_token(&line, 0, &name, &name_len) || !procfs_token_equals(name, name_len, g_keys[key].name) ||
+            !procfs_next_u64(&line, &value)) {
+            return 0;
+        }
+        values[g_keys[key].counter] += value;
+        *found |= 1u << g_keys[key].counter;
+    }
+    return 1;
+}
+
+/**
+ * @brief Record which line of the last read feeds which key
+ */
+static void build_index(void) {
+    ProcfsScanner file, line;
+    procfs_scan_file(&file, &g_proc_vmstat);
+
+    g_num_lines = 0;
+    while (g_num_lines < VMSTAT_MAX_LINES && procfs_next_line(&file, &line)) {
+        const char *name;
+        size_t name_len;
+        g_line_key[g_num_lines++] =
+            procfs_next_token(&line, 0, &name, &name_len) ? (signed char)key_index(name, name_len) : -1;
+    }
+}
+
+/**
+ * @brief Close the mm_stat files of every zram device
+ */
+static void close_zram(void) {
+    for (int i = 0; i < g_num_zram; i++) {
+        close(g_zram[i].fd);
+    }
+    g_num_zram = 0;
+}
+
+/**
+ * @brief Open the mm_stat file of every zram device, ordered by name
+ */
+static void discover_zram(void) {
+    close_zram();
+
+    DIR *dir = opendir("/sys/block");
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL && g_num_zram < RESTRACK_MAX_ZRAM) {
+        char name[sizeof(g_zram[0].name)];
+        if (strncmp(ent->d_name, "zram", 4) != 0 ||
+            snprintf(name, sizeof(name), "%s", ent->d_name) >= (int)sizeof(name)) {
+            continue;
+        }
+
+        char path[sizeof("/sys/block//mm_stat") + sizeof(name)];
+        snprintf(path, sizeof(path), "/sys/block/%s/mm_stat", name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        int pos = g_num_zram;
+        while (pos > 0 && strcmp(g_zram[pos - 1].name, name) > 0) {
+            g_zram[pos] = g_zram[pos - 1];
+            pos--;
+        }
+        memcpy(g_zram[pos].name, name, sizeof(name));
+        g_zram[pos].fd = fd;
+        g_num_zram++;
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Read the mm_stat files into the paging section
+ * @param paging Paging section to fill
+ * @return 1 if a device disappeared, 0 otherwise
+ *
+ * mm_stat starts with orig_data_size, compr_data_size and mem_used_total,
+ * all in bytes. Devices that hold no data yet are skipped.
+ */
+static int read_zram(restrack_paging_t *paging) {
+    uint64_t orig_total = 0, compr_total = 0;
+    int gone = 0;
+
+    paging->num_zram = 0;
+    for (int i = 0; i < g_num_zram; i++) {
+        char buf[256];
+        ssize_t n;
+        do {
+            n = pread(g_zram[i].fd, buf, sizeof(buf) - 1, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            gone = 1;
+            continue;
+        }
+
+        ProcfsScanner scanner = { buf, buf + n };
+        uint64_t stat[3];
+        if (procfs_next_u64s(&scanner, stat, 3) < 3 || stat[0] == 0) {
+            continue;
+        }
+
+        restrack_zram_t *zram = &paging->zram[paging->num_zram++];
+        procfs_copy_token(zram->name, sizeof(zram->name), g_zram[i].name, strlen(g_zram[i].name));
+        zram->orig_data_bytes = stat[0];
+        zram->compr_data_bytes = stat[1];
+        zram->mem_used_bytes = stat[2];
+        zram->compression_ratio = stat[1] > 0 ? (double)stat[0] / stat[1] : 0.0;
+        orig_total += stat[0];
+        compr_total += stat[1];
+    }
+
+    paging->zram_compression_ratio = compr_total > 0 ? (double)orig_total / compr_total : 0.0;
+    return gone;
+}
+
+/**
+ * @brief Read /proc/vmstat and the zram mm_stat files into the paging section
+ * @param paging Paging section to fill
+ * @return ERR_SUCCESS on success, error code if /proc/vmstat could not be read
+ */
+int vmstat_collect(restrack_paging_t *paging) {
+    if (paging == NULL) {
+        return ERR_INVALID_PARAM;
+    }
+
+    uint64_t now_ns = monotonic_ns();
+    int result = procfs_read(&g_proc_vmstat);
+    if (result != ERR_SUCCESS) {
+        g_has_prev = 0;
+        return result;
+    }
+
+    uint64_t values[VMSTAT_COUNTERS] = { 0 };
+    unsigned int found = 0;
+    if (!parse_indexed(values, &found)) {
+        build_index();
+        memset(values, 0, sizeof(values));
+        if (!parse_indexed(values, &found)) {
+            g_has_prev = 0;
+            return ERR_FILE_READ;
+        }
+    }
+
+    memset(paging, 0, sizeof(*paging));
+    paging->pswpin = values[VMSTAT_PSWPIN];
+    paging->pswpout = values[VMSTAT_PSWPOUT];
+    paging->pgmajfault = values[VMSTAT_PGMAJFAULT];
+    paging->allocstall = values[VMSTAT_ALLOCSTALL];
+    paging->has_oom_kill = (found & (1u << VMSTAT_OOM_KILL)) != 0;
+    paging->oom_kill = values[VMSTAT_OOM_KILL];
+
+    // Rates need the same counters on both readings; they only go back on a different file
+    if (g_has_prev && now_ns > g_prev_ns && found == g_prev_found) {
+        double elapsed_sec = (now_ns - g_prev_ns) / 1e9;
+        double rates[VMSTAT_COUNTERS];
+        for (int i = 0; i < VMSTAT_COUNTERS; i++) {
+            rates[i] = values[i] >= g_prev[i] ? (values[i] - g_prev[i]) / elapsed_sec : 0.0;
+        }
+
+        paging->has_rates = 1;
+        paging->interval_ms = elapsed_sec * 1000.0;
+        paging->pswpin_per_sec = rates[VMSTAT_PSWPIN];
+        paging->pswpout_per_sec = rates[VMSTAT_PSWPOUT];
+        paging->pgmajfault_per_sec = rates[VMSTAT_PGMAJFAULT];
+        paging->allocstall_per_sec = rates[VMSTAT_ALLOCSTALL];
+        paging->oom_kill_per_sec = rates[VMSTAT_OOM_KILL];
+    }
+
+    g_has_prev = 1;
+    g_prev_found = found;
+    g_prev_ns = now_ns;
+    memcpy(g_prev, values, sizeof(values));
+
+    // zram-swap is often set up by an init script that runs after the monitor
+    if (g_num_zram == 0 && g_calls++ % ZRAM_RESCAN_CALLS == 0) {
+        discover_zram();
+    }
+    if (read_zram(paging)) {
+        discover_zram();
+        read_zram(paging);
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Close the files and forget the line index
+ */
+void vmstat_cleanup(void) {
+    procfs_close(&g_proc_vmstat);
+    g_num_lines = 0;
+    close_zram();
+    g_calls = 0;
+    g_has_prev = 0;
+}
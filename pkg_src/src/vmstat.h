@@ -0,0 +1,28 @@
+/**
+ * @file vmstat.h
+ * @brief Paging, fault and OOM rates from /proc/vmstat, zram compression from sysfs
+ */
+
+#ifndef VMSTAT_H
+#define VMSTAT_H
+
+#include "resources.h"
+
+/**
+ * @brief Read /proc/vmstat and the zram mm_stat files into the paging section
+ * @param paging Paging section to fill
+ * @return ERR_SUCCESS on success, error code if /proc/vmstat could not be read
+ *
+ * As with /proc/meminfo, the first read records which line of
+ * /proc/vmstat feeds which counter, so later reads only parse the numbers
+ * of the lines that are needed. The index is rebuilt when a line no
+ * longer carries the expected key.
+ */
+int vmstat_collect(restrack_paging_t *paging);
+
+/**
+ * @brief Close the files and forget the line index
+ */
+void vmstat_cleanup(void);
+
+#endif /* VMSTAT_H */
@@ -0,0 +1,516 @@
+/**
+ * @file watch.c
+ * @brief Per-process usage of configured daemons through cached /proc/<pid> directories
+ */
+
+#include "watch.h"
+#include "procfs.h"
+#include "util.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <signal.h>
+
+// Calls between scans while a pattern has no process, e.g. a daemon not started yet
+#define WATCH_RESCAN_CALLS 30
+
+// Bytes of /proc/<pid>/cmdline matched against the patterns
+#define WATCH_CMDLINE_LEN 256
+
+/**
+ * @struct WatchEntry
+ * @brief A watched process and the state its rates are derived from
+ */
+typedef struct {
+    int pid;
+    int pattern;                 // Index of the first matching pattern
+    int dirfd;                   // /proc/<pid>, open for the lifetime of the process
+    uint64_t start_time;         // Clock ticks after boot, at the scan that found it
+    uint64_t cpu_ticks;          // utime + stime at the last read
+    uint64_t read_ns;            // CLOCK_MONOTONIC time of the last read
+    int primed;                  // Whether cpu_ticks and the io counters are a valid baseline
+    int io_denied;               // /proc/<pid>/io is not readable by us
+    unsigned int read_call;      // g_calls at the last read
+    restrack_proc_t info;        // Values of the last read
+    uint64_t vm_kb;
+    uint64_t shared_kb;
+} WatchEntry;
+
+static WatchEntry g_entries[RESTRACK_MAX_WATCHED];
+static int g_num_entries = 0;
+static int g_dropped = 0;
+
+// Patterns the entries were matched against
+static char g_patterns[SYSMON_MAX_WATCH_PATTERNS][SYSMON_WATCH_PATTERN_LEN];
+static int g_num_patterns = -1;
+
+static volatile sig_atomic_t g_rescan_requested = 0;
+static unsigned int g_calls = 0;
+static uint64_t g_scans = 0;
+static long g_clock_ticks = 0;
+static long g_page_kb = 4;
+
+/**
+ * @brief Read the monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Read a file below a process directory
+ * @param dirfd Open /proc/<pid> directory
+ * @param name File name, e.g. "stat"
+ * @param buf Buffer receiving the contents, NUL terminated
+ * @param size Size of buf
+ * @return Bytes read, -1 on error with errno set
+ */
+static ssize_t read_proc_file(int dirfd, const char *name, char *buf, size_t size) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        n = pread(fd, buf, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+/**
+ * @brief Parse /proc/<pid>/stat
+ * @param buf Contents of the file
+ * @param len Length of the contents
+ * @param info Receives name, state and threads
+ * @param cpu_ticks Receives utime + stime
+ * @param start_time Receives the start time in clock ticks after boot
+ * @return 1 on success, 0 if the contents are malformed
+ */
+static int parse_stat(const char *buf, size_t len, restrack_proc_t *info, uint64_t *cpu_ticks, uint64_t *start_time) {
+    // "pid (comm) state ..." where comm may itself contain spaces and ')'
+    const char *end = buf + len;
+    const char *open_paren = (const char*)memchr(buf, '(', len);
+    const char *close_paren = end;
+    while (close_paren > buf && *--close_paren != ')') {
+    }
+    if (open_paren == NULL || close_paren <= open_paren) {
+        return 0;
+    }
+    procfs_copy_token(info->name, sizeof(info->name), open_paren + 1, close_paren - open_paren - 1);
+
+    // Fields after comm, numbered as in proc(5); some of them may be negative
+    uint64_t utime = 0, stime = 0, threads = 0;
+    ProcfsScanner line = { close_paren + 1, end };
+    const char *token;
+    size_t token_len;
+    int field = 3;
+    for (; field <= 22 && procfs_next_token(&line, 0, &token, &token_len); field++) {
+        ProcfsScanner number = { token, token + token_len };
+        switch (field) {
+            case 3:  info->state = token[0]; break;
+            case 14: procfs_next_u64(&number, &utime); break;
+            case 15: procfs_next_u64(&number, &stime); break;
+            case 20: procfs_next_u64(&number, &threads); break;
+            case 22: procfs_next_u64(&number, start_time); break;
+            default: break;
+        }
+    }
+
+    info->threads = threads;
+    *cpu_ticks = utime + stime;
+    return field > 22;
+}
+
+/**
+ * @brief Check a process against the patterns
+ * @param dirfd Open /proc/<pid> directory
+ * @return Index of the first matching pattern, -1 if none matches
+ */
+static int match_process(int dirfd) {
+    char comm[32];
+    ssize_t comm_len = read_proc_file(dirfd, "comm", comm, sizeof(comm));
+    if (comm_len <= 0) {
+        return -1;
+    }
+    comm[strcspn(comm, "\n")] = '\0';
+
+    // Kernel threads have an empty command line and are matched by comm only
+    char cmdline[WATCH_CMDLINE_LEN];
+    ssize_t cmd_len = read_proc_file(dirfd, "cmdline", cmdline, sizeof(cmdline));
+    if (cmd_len < 0) {
+        cmd_len = 0;
+        cmdline[0] = '\0';
+    }
+
+    // argv[0] ends at the first NUL; the arguments are joined with spaces after it
+    const char *slash = strrchr(cmdline, '/');
+    char argv0[WATCH_CMDLINE_LEN];
+    snprintf(argv0, sizeof(argv0), "%s", slash != NULL ? slash + 1 : cmdline);
+    for (ssize_t i = 0; i < cmd_len; i++) {
+        if (cmdline[i] == '\0') {
+            cmdline[i] = ' ';
+        }
+    }
+    while (cmd_len > 0 && cmdline[cmd_len - 1] == ' ') {
+        cmdline[--cmd_len] = '\0';
+    }
+
+    for (int i = 0; i < g_num_patterns; i++) {
+        if (fnmatch(g_patterns[i], comm, 0) == 0 ||
+            (argv0[0] != '\0' && fnmatch(g_patterns[i], argv0, 0) == 0) ||
+            (cmdline[0] != '\0' && fnmatch(g_patterns[i], cmdline, 0) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Close the directories of every entry
+ */
+static void close_all(void) {
+    for (int i = 0; i < g_num_entries; i++) {
+        close(g_entries[i].dirfd);
+    }
+    g_num_entries = 0;
+    g_dropped = 0;
+}
+
+/**
+ * @brief Match every process in /proc against the patterns
+ *
+ * Processes that were already watched keep their directory and their
+ * baseline; the others are opened fresh.
+ */
+static void scan_processes(void) {
+    WatchEntry previous[RESTRACK_MAX_WATCHED];
+    int num_previous = g_num_entries;
+    memcpy(previous, g_entries, num_previous * sizeof(previous[0]));
+    g_num_entries = 0;
+    g_dropped = 0;
+    g_scans++;
+
+    int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = proc_fd >= 0 ? fdopendir(proc_fd) : NULL;
+    if (dir == NULL) {
+        if (proc_fd >= 0) {
+            close(proc_fd);
+        }
+        log_message(LOG_ERROR, "Failed to open /proc directory: %s", strerror(errno));
+    }
+
+    struct dirent *ent;
+    while (dir != NULL && (ent = readdir(dir)) != NULL) {
+        char *endptr;
+        long pid = strtol(ent->d_name, &endptr, 10);
+        if (*endptr != '\0' || pid <= 0) {
+            continue;
+        }
+
+        // Known processes are not read again; their start time is checked on every collection
+        int known = -1;
+        for (int i = 0; i < num_previous; i++) {
+            if (previous[i].pid == pid && previous[i].dirfd >= 0) {
+                known = i;
+                break;
+            }
+        }
+
+        int dirfd = known >= 0 ? previous[known].dirfd : openat(proc_fd, ent->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0) {
+            continue;
+        }
+        int pattern = match_process(dirfd);
+        if (pattern < 0) {
+            if (known < 0) {
+                close(dirfd);
+            }
+            continue;
+        }
+        if (g_num_entries >= RESTRACK_MAX_WATCHED) {
+            g_dropped++;
+            if (known < 0) {
+                close(dirfd);
+            }
+            continue;
+        }
+
+        WatchEntry *entry = &g_entries[g_num_entries];
+        if (known >= 0) {
+            *entry = previous[known];
+            previous[known].dirfd = -1;
+            entry->pattern = pattern;
+            g_num_entries++;
+            continue;
+        }
+
+        // The start time read here tells this process apart from a later one with the same PID
+        char buf[512];
+        ssize_t n = read_proc_file(dirfd, "stat", buf, sizeof(buf));
+        memset(entry, 0, sizeof(*entry));
+        if (n <= 0 || !parse_stat(buf, n, &entry->info, &entry->cpu_ticks, &entry->start_time)) {
+            close(dirfd);
+            continue;
+        }
+        entry->pid = (int)pid;
+        entry->pattern = pattern;
+        entry->dirfd = dirfd;
+        g_num_entries++;
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+
+    // Watched processes that no longer match or have gone
+    for (int i = 0; i < num_previous; i++) {
+        if (previous[i].dirfd >= 0) {
+            close(previous[i].dirfd);
+        }
+    }
+
+    if (g_dropped > 0) {
+        log_message(LOG_WARNING, "Watch patterns match more than %d processes, %d dropped",
+                    RESTRACK_MAX_WATCHED, g_dropped);
+    }
+}
+
+/**
+ * @brief Parse /proc/<pid>/io for the storage byte counters
+ * @param buf Contents of the file
+ * @param len Length of the contents
+ * @param read_bytes Receives read_bytes
+ * @param write_bytes Receives write_bytes
+ */
+static void parse_io(const char *buf, size_t len, uint64_t *read_bytes, uint64_t *write_bytes) {
+    ProcfsScanner file = { buf, buf + len };
+    ProcfsScanner line;
+    while (procfs_next_line(&file, &line)) {
+        const char *key;
+        size_t key_len;
+        if (!procfs_next_token(&line, ':', &key, &key_len) || line.pos >= line.end) {
+            continue;
+        }
+        line.pos++;
+
+        if (procfs_token_equals(key, key_len, "read_bytes")) {
+            procfs_next_u64(&line, read_bytes);
+        } else if (procfs_token_equals(key, key_len, "write_bytes")) {
+            procfs_next_u64(&line, write_bytes);
+        }
+    }
+}
+
+/**
+ * @brief Re-read a watched process and derive its interval figures
+ * @param entry Process to update
+ * @return 1 on success, 0 if the process exited or its PID was reused
+ */
+static int read_entry(WatchEntry *entry) {
+    uint64_t now_ns = monotonic_ns();
+    char buf[512];
+    ssize_t n = read_proc_file(entry->dirfd, "stat", buf, sizeof(buf));
+    if (n <= 0) {
+        return 0;
+    }
+
+    restrack_proc_t *info = &entry->info;
+    uint64_t cpu_ticks = 0, start_time = 0;
+    if (!parse_stat(buf, n, info, &cpu_ticks, &start_time) || start_time != entry->start_time ||
+        info->state == 'Z' || info->state == 'X') {
+        return 0;
+    }
+    info->pid = entry->pid;
+
+    // statm counts pages: size resident shared text lib data dt
+    uint64_t statm[3] = { 0 };
+    n = read_proc_file(entry->dirfd, "statm", buf, sizeof(buf));
+    if (n > 0) {
+        ProcfsScanner scanner = { buf, buf + n };
+        procfs_next_u64s(&scanner, statm, 3);
+    }
+    info->rss_kb = statm[1] * g_page_kb;
+
+    double elapsed_sec = entry->primed && now_ns > entry->read_ns ? (now_ns - entry->read_ns) / 1e9 : 0.0;
+    info->cpu_percent = elapsed_sec > 0 && cpu_ticks >= entry->cpu_ticks
+        ? 100.0 * (double)(cpu_ticks - entry->cpu_ticks) / g_clock_ticks / elapsed_sec : 0.0;
+
+    // Storage IO; only readable for our own processes unless running as root
+    int had_io = entry->primed && info->has_io;
+    uint64_t prev_read = info->read_bytes;
+    uint64_t prev_write = info->write_bytes;
+    info->has_io = 0;
+    info->read_bytes_per_sec = 0.0;
+    info->write_bytes_per_sec = 0.0;
+    if (!entry->io_denied) {
+        n = read_proc_file(entry->dirfd, "io", buf, sizeof(buf));
+        if (n > 0) {
+            parse_io(buf, n, &info->read_bytes, &info->write_bytes);
+            info->has_io = 1;
+            if (had_io && elapsed_sec > 0) {
+                if (info->read_bytes >= prev_read) {
+                    info->read_bytes_per_sec = (info->read_bytes - prev_read) / elapsed_sec;
+                }
+                if (info->write_bytes >= prev_write) {
+                    info->write_bytes_per_sec = (info->write_bytes - prev_write) / elapsed_sec;
+                }
+            }
+        } else if (errno == EACCES || errno == EPERM) {
+            entry->io_denied = 1;
+        }
+    }
+
+    entry->cpu_ticks = cpu_ticks;
+    entry->read_ns = now_ns;
+    entry->primed = 1;
+    entry->read_call = g_calls;
+    entry->vm_kb = statm[0] * g_page_kb;
+    entry->shared_kb = statm[2] * g_page_kb;
+    return 1;
+}
+
+/**
+ * @brief Report a watched process as of its last read
+ * @param entry Process that was read
+ * @param out Watched process to fill
+ */
+static void fill_watched(const WatchEntry *entry, restrack_watched_proc_t *out) {
+    snprintf(out->pattern, sizeof(out->pattern), "%s", g_patterns[entry->pattern]);
+    out->proc = entry->info;
+    out->vm_kb = entry->vm_kb;
+    out->shared_kb = entry->shared_kb;
+    out->start_time = entry->start_time;
+}
+
+/**
+ * @brief Take over the configured patterns
+ * @param patterns Configured patterns
+ * @param num_patterns Entries used in patterns
+ * @return 1 if they differ from the ones in use, 0 otherwise
+ */
+static int set_patterns(const char patterns[][SYSMON_WATCH_PATTERN_LEN], int num_patterns) {
+    if (num_patterns > SYSMON_MAX_WATCH_PATTERNS) {
+        num_patterns = SYSMON_MAX_WATCH_PATTERNS;
+    }
+
+    int changed = num_patterns != g_num_patterns;
+    for (int i = 0; !changed && i < num_patterns; i++) {
+        changed = strcmp(patterns[i], g_patterns[i]) != 0;
+    }
+    if (!changed) {
+        return 0;
+    }
+
+    for (int i = 0; i < num_patterns; i++) {
+        snprintf(g_patterns[i], sizeof(g_patterns[i]), "%s", patterns[i]);
+    }
+    g_num_patterns = num_patterns;
+    return 1;
+}
+
+/**
+ * @brief Read the processes matching the watch patterns
+ * @param patterns Shell-style patterns, matched against comm, the base name of argv[0] and the command line
+ * @param num_patterns Entries used in patterns
+ * @param watched Watched process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ */
+int watch_collect(const char patterns[][SYSMON_WATCH_PATTERN_LEN], int num_patterns, restrack_watched_t *watched) {
+    if (patterns == NULL || watched == NULL || num_patterns < 0) {
+        return ERR_INVALID_PARAM;
+    }
+
+    if (g_clock_ticks <= 0) {
+        g_clock_ticks = sysconf(_SC_CLK_TCK);
+        g_page_kb = sysconf(_SC_PAGESIZE) / 1024;
+        if (g_clock_ticks <= 0) {
+            g_clock_ticks = 100;
+        }
+    }
+
+    int scan = set_patterns(patterns, num_patterns);
+    if (g_rescan_requested) {
+        g_rescan_requested = 0;
+        scan = 1;
+    }
+
+    // Patterns without a process are retried now and then, in case the daemon starts later
+    unsigned int matched = 0;
+    for (int i = 0; i < g_num_entries; i++) {
+        matched |= 1u << g_entries[i].pattern;
+    }
+    g_calls++;
+    if (matched != (1u << g_num_patterns) - 1 && g_calls % WATCH_RESCAN_CALLS == 0) {
+        scan = 1;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (scan) {
+            scan_processes();
+            scan = 0;
+        }
+
+        watched->num_procs = 0;
+        int kept = 0;
+        for (int i = 0; i < g_num_entries; i++) {
+            // After a rescan only new processes are read; reading the others
+            // again this soon would give rates over a few microseconds
+            if (g_entries[i].read_call != g_calls && !read_entry(&g_entries[i])) {
+                // Exited or replaced by a new process; the scan picks up any successor
+                close(g_entries[i].dirfd);
+                scan = 1;
+                continue;
+            }
+            fill_watched(&g_entries[i], &watched->procs[watched->num_procs++]);
+            g_entries[kept++] = g_entries[i];
+        }
+        g_num_entries = kept;
+        if (!scan) {
+            break;
+        }
+    }
+    watched->dropped = g_dropped;
+    watched->scans = g_scans;
+
+    watched->num_missing = 0;
+    for (int i = 0; i < g_num_patterns; i++) {
+        int found = 0;
+        for (int j = 0; j < watched->num_procs && !found; j++) {
+            found = strcmp(watched->procs[j].pattern, g_patterns[i]) == 0;
+        }
+        if (!found) {
+            snprintf(watched->missing[watched->num_missing], sizeof(watched->missing[0]), "%s", g_patterns[i]);
+            watched->num_missing++;
+        }
+    }
+
+    return ERR_SUCCESS;
+}
+
+/**
+ * @brief Ask for a scan of /proc on the next call
+ */
+void watch_request_rescan(void) {
+    g_rescan_requested = 1;
+}
+
+/**
+ * @brief Close the process directories and forget the matches
+ */
+void watch_cleanup(void) {
+    close_all();
+    g_num_patterns = -1;
+    g_calls = 0;
+    g_scans = 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file watch.h
+ * @brief Per-process usage of configured daemons through cached /proc/<pid> directories
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "resources.h"
+
+/**
+ * @brief Read the processes matching the watch patterns
+ * @param patterns Shell-style patterns, matched against comm, the base name of argv[0] and the command line
+ * @param num_patterns Entries used in patterns
+ * @param watched Watched process section to fill
+ * @return ERR_SUCCESS on success, error code on failure
+ *
+ * The /proc/<pid> directory of each match stays open, so a call costs an
+ * openat() and a pread() of stat, statm and io per process. /proc is only
+ * scanned again when the patterns change, a rescan was requested, a
+ * watched process exits, or, every 30 calls, while a pattern has no match.
+ * A start time that differs from the one at the scan means the PID was
+ * reused and counts as an exit.
+ */
+int watch_collect(const char patterns[][SYSMON_WATCH_PATTERN_LEN], int num_patterns, restrack_watched_t *watched);
+
+/**
+ * @brief Ask for a scan of /proc on the next call
+ *
+ * Only sets a flag, so it may be called from a signal handler.
+ */
+void watch_request_rescan(void);
+
+/**
+ * @brief Close the process directories and forget the matches
+ */
+void watch_cleanup(void);
+
+#endif /* WATCH_H */